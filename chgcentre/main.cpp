@@ -1,4 +1,5 @@
 #include "progressbar.h"
+#include "visibilityrotation.h"
 
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 
@@ -17,13 +18,20 @@
 #include <casacore/measures/Measures/MeasConvert.h>
 #include <casacore/measures/Measures/MeasTable.h>
 
+#include <casacore/casa/Arrays/Slicer.h>
+
 #include <casacore/tables/Tables/TableRecord.h>
 
 #include <aocommon/banddata.h>
 #include <aocommon/imagecoordinates.h>
 #include <aocommon/multibanddata.h>
+#include <aocommon/parallelfor.h>
 #include <aocommon/radeccoord.h>
+#include <aocommon/system.h>
 
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
 
@@ -103,21 +111,6 @@ Muvw calculateUVW(const MPosition& antennaPos, const MPosition& refPos,
   return Muvw(uvw, Muvw::J2000);
 }
 
-void rotateVisibilities(const aocommon::BandData& bandData, double shiftFactor,
-                        unsigned polarizationCount,
-                        casacore::Array<casacore::Complex>::contiter dataIter) {
-  for (unsigned ch = 0; ch != bandData.ChannelCount(); ++ch) {
-    const double wShiftRad = shiftFactor / bandData.ChannelWavelength(ch);
-    double rotSin = std::sin(wShiftRad), rotCos = std::cos(wShiftRad);
-    for (unsigned p = 0; p != polarizationCount; ++p) {
-      casacore::Complex v = *dataIter;
-      *dataIter = casacore::Complex(v.real() * rotCos - v.imag() * rotSin,
-                                    v.real() * rotSin + v.imag() * rotCos);
-      ++dataIter;
-    }
-  }
-}
-
 casacore::MPosition ArrayCentroid(casacore::MeasurementSet& set) {
   casacore::MSAntenna aTable = set.antenna();
   if (aTable.nrow() == 0) throw std::runtime_error("No antennae in set");
@@ -220,10 +213,27 @@ void getShift(MSField& fieldTable, double& dl, double& dm) {
     dm = 0.0;
 }
 
+/**
+ * Consecutive rows that are read and written with a single
+ * getColumnRange()/putColumnRange() call per column. The last axis of each
+ * array is the row.
+ */
+struct RowBlock {
+  casacore::Vector<double> time;
+  casacore::Vector<int> antenna1, antenna2, fieldId, dataDescId;
+  casacore::Array<double> uvw;
+  /** Holds one data column at a time. */
+  casacore::Array<casacore::Complex> data;
+};
+
+/** Approximate number of bytes of uvws and visibilities per RowBlock. */
+constexpr size_t kBlockSize = 256 * 1024 * 1024;
+
 void processField(casacore::MeasurementSet& set, const std::string& dataColumn,
                   int fieldIndex, MSField& fieldTable,
                   const MDirection& newDirection, bool onlyUVW, bool shiftback,
-                  double newDl, double newDm, bool flipUVWSign, bool force) {
+                  double newDl, double newDm, bool flipUVWSign, bool force,
+                  size_t threadCount) {
   aocommon::MultiBandData bandData(set.spectralWindow(), set.dataDescription());
   ScalarColumn<casacore::String> nameCol(
       fieldTable, fieldTable.columnName(MSFieldEnums::NAME));
@@ -235,6 +245,7 @@ void processField(casacore::MeasurementSet& set, const std::string& dataColumn,
       antenna2Col(set, set.columnName(MSMainEnums::ANTENNA2)),
       fieldIdCol(set, set.columnName(MSMainEnums::FIELD_ID)),
       dataDescIdCol(set, set.columnName(MSMainEnums::DATA_DESC_ID));
+  ScalarColumn<double> rawTimeCol(set, set.columnName(MSMainEnums::TIME));
   Muvw::ScalarColumn uvwCol(set, set.columnName(MSMainEnums::UVW));
   ArrayColumn<double> uvwOutCol(set, set.columnName(MSMainEnums::UVW));
 
@@ -296,82 +307,120 @@ void processField(casacore::MeasurementSet& set, const std::string& dataColumn,
 
     MDirection refDirection =
         MDirection::Convert(newDirection, MDirection::Ref(MDirection::J2000))();
+    const size_t rowCount = set.nrow();
     casacore::IPosition dataShape;
     unsigned polarizationCount = 0;
-    std::unique_ptr<casacore::Array<casacore::Complex>> dataArray;
-    if (!onlyUVW) {
+    size_t bytesPerRow = 3 * sizeof(double);
+    if (!onlyUVW && rowCount != 0) {
       dataShape = dataCol->shape(0);
       polarizationCount = dataShape[0];
-      dataArray.reset(new casacore::Array<casacore::Complex>(dataShape));
+      bytesPerRow += dataShape.product() * sizeof(casacore::Complex);
     }
+    const size_t maxBlockRows = std::max<size_t>(1, kBlockSize / bytesPerRow);
+    std::vector<bool> isRegular(bandData.DataDescCount());
+    for (size_t d = 0; d != bandData.DataDescCount(); ++d)
+      isRegular[d] = hasRegularChannels(bandData[d]);
 
+    aocommon::ParallelFor<size_t> loop(threadCount);
     std::unique_ptr<ProgressBar> progressBar;
 
-    std::vector<Muvw> uvws(antennas.size());
-    MEpoch time(MVEpoch(-1.0));
-    for (unsigned row = 0; row != set.nrow(); ++row) {
-      if (fieldIdCol(row) == fieldIndex) {
-        // Read values from set
-        const int antenna1 = antenna1Col(row), antenna2 = antenna2Col(row),
-                  dataDescId = dataDescIdCol(row);
-        const Muvw oldUVW = uvwCol(row);
-
-        MEpoch rowTime = timeCol(row);
-        if (rowTime.getValue() != time.getValue()) {
-          time = rowTime;
-          for (size_t a = 0; a != antennas.size(); ++a)
-            uvws[a] = calculateUVW(antennas[a], arrayPos, time, refDirection);
+    // The antenna UVWs of the current timestep. They are calculated once per
+    // timestep, also when the timestep spans two blocks.
+    std::vector<std::array<double, 3>> uvws(antennas.size());
+    double currentTime = 0.0;
+    bool hasTime = false;
+    RowBlock block;
+    std::vector<double> shiftFactors;
+    for (size_t startRow = 0; startRow < rowCount; startRow += maxBlockRows) {
+      const size_t nRows = std::min(maxBlockRows, rowCount - startRow);
+      const casacore::Slicer rows(casacore::IPosition(1, startRow),
+                                  casacore::IPosition(1, nRows));
+      fieldIdCol.getColumnRange(rows, block.fieldId, true);
+      if (std::find(block.fieldId.begin(), block.fieldId.end(), fieldIndex) ==
+          block.fieldId.end())
+        continue;
+      rawTimeCol.getColumnRange(rows, block.time, true);
+      antenna1Col.getColumnRange(rows, block.antenna1, true);
+      antenna2Col.getColumnRange(rows, block.antenna2, true);
+      dataDescIdCol.getColumnRange(rows, block.dataDescId, true);
+      uvwOutCol.getColumnRange(rows, block.uvw, true);
+
+      // Calculate the new UVWs and phase shifts. This is cheap compared to
+      // the rotation of the visibilities, and is done on this thread because
+      // the casacore measures are not thread safe.
+      shiftFactors.resize(nRows);
+      double* uvw = block.uvw.data();
+      for (size_t i = 0; i != nRows; ++i) {
+        if (block.fieldId[i] != fieldIndex) continue;
+        const size_t row = startRow + i;
+        if (!hasTime || block.time[i] != currentTime) {
+          hasTime = true;
+          currentTime = block.time[i];
+          const MEpoch time = timeCol(row);
+          for (size_t a = 0; a != antennas.size(); ++a) {
+            const casacore::Vector<double> antennaUVW =
+                calculateUVW(antennas[a], arrayPos, time, refDirection)
+                    .getValue()
+                    .getVector();
+            uvws[a] = {antennaUVW[0], antennaUVW[1], antennaUVW[2]};
+          }
         }
 
-        // Calculate the new UVW
-        MVuvw newUVW = uvws[antenna1].getValue() - uvws[antenna2].getValue();
-        if (flipUVWSign) newUVW = -newUVW;
+        const std::array<double, 3>& uvw1 = uvws[block.antenna1[i]];
+        const std::array<double, 3>& uvw2 = uvws[block.antenna2[i]];
+        const double sign = flipUVWSign ? -1.0 : 1.0;
+        const double newU = sign * (uvw1[0] - uvw2[0]);
+        const double newV = sign * (uvw1[1] - uvw2[1]);
+        const double newW = sign * (uvw1[2] - uvw2[2]);
+        double* rowUVW = &uvw[i * 3];
 
         // If one of the first results, output values for analyzing them.
         if (row < 5) {
+          const Muvw oldUVW = uvwCol(row);
+          const MVuvw newUVW(newU, newV, newW);
           std::cout << "Old " << oldUVW << " (" << length(oldUVW) << ")\n";
-          std::cout << "New " << newUVW << " (" << length(newUVW) << ")\n\n";
-        } else {
-          if (progressBar == nullptr)
-            progressBar.reset(new ProgressBar("Changing phase centre"));
-          progressBar->SetProgress(row, set.nrow());
+          std::cout << "New " << newUVW << " (" << length(newUVW.getVector())
+                    << ")\n\n";
         }
 
-        if (!onlyUVW) {
-          // Read the visibilities and phase-rotate them
-          double shiftFactor =
-              -2.0 * M_PI *
-              (newUVW.getVector()[2] - oldUVW.getValue().getVector()[2]);
-
-          double dnu = newUVW.getVector()[0], dnv = newUVW.getVector()[1];
-          shiftFactor += -2.0 * M_PI * (dnu * newDl + dnv * newDm);
-          double dou = oldUVW.getValue().getVector()[0],
-                 dov = oldUVW.getValue().getVector()[1];
-          shiftFactor -= -2.0 * M_PI * (dou * oldDl + dov * oldDm);
-
-          const aocommon::BandData& thisBand = bandData[dataDescId];
-          dataCol->get(row, *dataArray);
-          rotateVisibilities(thisBand, shiftFactor, polarizationCount,
-                             dataArray->cbegin());
-          dataCol->put(row, *dataArray);
-
-          if (hasCorrData) {
-            correctedDataCol->get(row, *dataArray);
-            rotateVisibilities(thisBand, shiftFactor, polarizationCount,
-                               dataArray->cbegin());
-            correctedDataCol->put(row, *dataArray);
-          }
+        double shiftFactor = -2.0 * M_PI * (newW - rowUVW[2]);
+        shiftFactor += -2.0 * M_PI * (newU * newDl + newV * newDm);
+        shiftFactor -= -2.0 * M_PI * (rowUVW[0] * oldDl + rowUVW[1] * oldDm);
+        shiftFactors[i] = shiftFactor;
 
-          if (hasModelData) {
-            modelDataCol->get(row, *dataArray);
-            rotateVisibilities(thisBand, shiftFactor, polarizationCount,
-                               dataArray->cbegin());
-            modelDataCol->put(row, *dataArray);
-          }
-        }
+        rowUVW[0] = newU;
+        rowUVW[1] = newV;
+        rowUVW[2] = newW;
+      }
 
-        // Store uvws
-        uvwOutCol.put(row, newUVW.getVector());
+      if (!onlyUVW) {
+        // Read the visibilities and phase-rotate them
+        const size_t rowSize = dataShape.product();
+        auto rotateColumn = [&](ArrayColumn<casacore::Complex>& column) {
+          column.getColumnRange(rows, block.data, true);
+          casacore::Complex* data = block.data.data();
+          loop.Run(0, nRows, [&](size_t i, size_t) {
+            if (block.fieldId[i] == fieldIndex) {
+              const int dataDescId = block.dataDescId[i];
+              rotateVisibilities(bandData[dataDescId], isRegular[dataDescId],
+                                 shiftFactors[i], polarizationCount,
+                                 &data[i * rowSize]);
+            }
+          });
+          column.putColumnRange(rows, block.data);
+        };
+        rotateColumn(*dataCol);
+        if (hasCorrData) rotateColumn(*correctedDataCol);
+        if (hasModelData) rotateColumn(*modelDataCol);
+      }
+
+      // Store uvws
+      uvwOutCol.putColumnRange(rows, block.uvw);
+
+      if (startRow + nRows > 5) {
+        if (progressBar == nullptr)
+          progressBar.reset(new ProgressBar("Changing phase centre"));
+        progressBar->SetProgress(startRow + nRows, rowCount);
       }
     }
     progressBar.reset();
@@ -502,6 +551,9 @@ void rotateToGeoZenith(casacore::MeasurementSet& set, int fieldIndex,
     polarizationCount = dataShape[0];
     dataArray.reset(new casacore::Array<casacore::Complex>(dataShape));
   }
+  std::vector<bool> isRegular(bandData.DataDescCount());
+  for (size_t d = 0; d != bandData.DataDescCount(); ++d)
+    isRegular[d] = hasRegularChannels(bandData[d]);
 
   std::unique_ptr<ProgressBar> progressBar;
 
@@ -560,21 +612,21 @@ void rotateToGeoZenith(casacore::MeasurementSet& set, int fieldIndex,
       if (!onlyUVW) {
         const aocommon::BandData& thisBand = bandData[dataDescId];
         dataCol->get(row, *dataArray);
-        rotateVisibilities(thisBand, shiftFactor, polarizationCount,
-                           dataArray->cbegin());
+        rotateVisibilities(thisBand, isRegular[dataDescId], shiftFactor,
+                           polarizationCount, dataArray->data());
         dataCol->put(row, *dataArray);
 
         if (hasCorrData) {
           correctedDataCol->get(row, *dataArray);
-          rotateVisibilities(thisBand, shiftFactor, polarizationCount,
-                             dataArray->cbegin());
+          rotateVisibilities(thisBand, isRegular[dataDescId], shiftFactor,
+                             polarizationCount, dataArray->data());
           correctedDataCol->put(row, *dataArray);
         }
 
         if (hasModelData) {
           modelDataCol->get(row, *dataArray);
-          rotateVisibilities(thisBand, shiftFactor, polarizationCount,
-                             dataArray->cbegin());
+          rotateVisibilities(thisBand, isRegular[dataDescId], shiftFactor,
+                             polarizationCount, dataArray->data());
           modelDataCol->put(row, *dataArray);
         }
       }
@@ -721,6 +773,9 @@ int main(int argc, char** argv) {
            "-from-ms <ms>\n"
            "\tRotate the measurement set to the same direction as specified\n"
            "\tin the provided measurement set.\n"
+           "-j <threads>\n"
+           "\tNumber of threads used for phase-rotating the visibilities. "
+           "Default: all cores.\n"
            "\n";
   } else {
     int argi = 1;
@@ -728,6 +783,7 @@ int main(int argc, char** argv) {
          toGeozenith = false, flipUVWSign = false, force = false, show = false,
          same = false;
     double newDl = 0.0, newDm = 0.0;
+    size_t threadCount = aocommon::system::ProcessorCount();
     std::string templateMS;
     std::string dataColumn;
     while (argv[argi][0] == '-') {
@@ -756,6 +812,9 @@ int main(int argc, char** argv) {
       } else if (param == "from-ms") {
         ++argi;
         templateMS = argv[argi];
+      } else if (param == "j") {
+        ++argi;
+        threadCount = std::max(1, std::atoi(argv[argi]));
       } else
         throw std::runtime_error("Invalid parameter");
       ++argi;
@@ -808,7 +867,8 @@ int main(int argc, char** argv) {
           rotateToGeoZenith(set, fieldIndex, fieldTable, onlyUVW, flipUVWSign);
         else
           processField(set, dataColumn, fieldIndex, fieldTable, newDirection,
-                       onlyUVW, shiftback, newDl, newDm, flipUVWSign, force);
+                       onlyUVW, shiftback, newDl, newDm, flipUVWSign, force,
+                       threadCount);
       }
     }
   }
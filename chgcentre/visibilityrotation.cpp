@@ -0,0 +1,51 @@
+#include "visibilityrotation.h"
+
+#include <cmath>
+#include <limits>
+
+bool hasRegularChannels(const aocommon::BandData& bandData) {
+  const unsigned channelCount = bandData.ChannelCount();
+  if (channelCount < 3) return true;
+  // A relative deviation d of a channel from the straight line gives a phase
+  // error of d times the phase of that channel, which can be 1e5 radians or
+  // more for long baselines. Hence, the tolerance should be close to the
+  // precision of a double.
+  const double tolerance = 64.0 * std::numeric_limits<double>::epsilon();
+  const double first = 1.0 / bandData.ChannelWavelength(0);
+  const double step =
+      (1.0 / bandData.ChannelWavelength(channelCount - 1) - first) /
+      (channelCount - 1);
+  for (unsigned ch = 1; ch != channelCount - 1; ++ch) {
+    const double value = 1.0 / bandData.ChannelWavelength(ch);
+    if (std::fabs(value - (first + ch * step)) > tolerance * std::fabs(value))
+      return false;
+  }
+  return true;
+}
+
+void rotateVisibilities(const aocommon::BandData& bandData, bool isRegular,
+                        double shiftFactor, unsigned polarizationCount,
+                        std::complex<float>* data) {
+  const unsigned channelCount = bandData.ChannelCount();
+  std::complex<double> step(1.0, 0.0);
+  if (isRegular && channelCount > 1) {
+    const double stepPhase =
+        shiftFactor *
+        (1.0 / bandData.ChannelWavelength(channelCount - 1) -
+         1.0 / bandData.ChannelWavelength(0)) /
+        (channelCount - 1);
+    step = std::polar(1.0, stepPhase);
+  }
+  std::complex<double> phasor;
+  for (unsigned ch = 0; ch != channelCount; ++ch) {
+    if (!isRegular || ch % kPhasorReseedInterval == 0)
+      phasor = std::polar(1.0, shiftFactor / bandData.ChannelWavelength(ch));
+    else
+      phasor *= step;
+    const std::complex<float> rotation(phasor.real(), phasor.imag());
+    for (unsigned p = 0; p != polarizationCount; ++p) {
+      *data *= rotation;
+      ++data;
+    }
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef CHGCENTRE_VISIBILITY_ROTATION_H
+#define CHGCENTRE_VISIBILITY_ROTATION_H
+
+#include <aocommon/banddata.h>
+
+#include <complex>
+
+/**
+ * Returns true when the channel frequencies lie on a straight line to within
+ * a few times the double precision, in which case rotateVisibilities() can
+ * calculate the phasors with a recurrence.
+ */
+bool hasRegularChannels(const aocommon::BandData& bandData);
+
+/**
+ * Multiplies the visibilities of a single row with
+ * exp(i * shiftFactor / wavelength). For regularly spaced channels, the
+ * phasor of the next channel is obtained by multiplying the current phasor
+ * with the phasor of one channel step. The recurrence accumulates a rounding
+ * error in every step, so the phasor is recalculated directly every
+ * kPhasorReseedInterval channels.
+ */
+void rotateVisibilities(const aocommon::BandData& bandData, bool isRegular,
+                        double shiftFactor, unsigned polarizationCount,
+                        std::complex<float>* data);
+
+constexpr unsigned kPhasorReseedInterval = 32;
+
+#endif
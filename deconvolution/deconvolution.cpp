@@ -129,9 +129,12 @@ void Deconvolution::Perform(bool& reachedMajorThreshold,
                  _settings.deconvolutionThreshold));
   integrated.Reset();
 
-  Logger::Debug << "Loading PSFs...\n";
-  const std::vector<aocommon::Image> psfImages =
-      residualSet.LoadAndAveragePSFs();
+  // The PSFs do not change during the major iterations, so they are only
+  // loaded once for every deconvolution table.
+  if (_psfImages.empty()) {
+    Logger::Debug << "Loading PSFs...\n";
+    _psfImages = residualSet.LoadAndAveragePSFs();
+  }
 
   if (_settings.useMultiscale) {
     if (_settings.autoMask) {
@@ -155,8 +158,8 @@ void Deconvolution::Perform(bool& reachedMajorThreshold,
     }
   }
 
-  _parallelDeconvolution.ExecuteMajorIteration(residualSet, modelSet, psfImages,
-                                               reachedMajorThreshold);
+  _parallelDeconvolution.ExecuteMajorIteration(
+      residualSet, modelSet, _psfImages, reachedMajorThreshold);
 
   if (!reachedMajorThreshold && _settings.autoMask && !_autoMaskIsFinished) {
     Logger::Info << "Auto-masking threshold reached; continuing next major "
@@ -267,6 +270,7 @@ void Deconvolution::InitializeDeconvolutionAlgorithm(
 void Deconvolution::FreeDeconvolutionAlgorithms() {
   _parallelDeconvolution.FreeDeconvolutionAlgorithms();
   _table.reset();
+  _psfImages.clear();
 }
 
 size_t Deconvolution::IterationNumber() const {
@@ -4,10 +4,12 @@
 #include "deconvolutionsettings.h"
 #include "paralleldeconvolution.h"
 
+#include <aocommon/image.h>
 #include <aocommon/polarization.h>
 #include <aocommon/uvector.h>
 
 #include <cstring>
+#include <vector>
 
 class DeconvolutionTable;
 struct DeconvolutionTableEntry;
@@ -54,6 +56,9 @@ class Deconvolution {
 
   aocommon::UVector<bool> _cleanMask;
 
+  /// Averaged PSFs of the current table, loaded in the first major iteration.
+  std::vector<aocommon::Image> _psfImages;
+
   bool _autoMaskIsFinished;
   aocommon::UVector<double> _channelFrequencies;
   aocommon::UVector<float> _channelWeights;
@@ -38,7 +38,6 @@ float GenericClean::ExecuteMajorIteration(
 
   aocommon::Image integrated(width, height);
   aocommon::Image scratchA(_convolutionWidth, _convolutionHeight);
-  aocommon::Image scratchB(_convolutionWidth, _convolutionHeight);
   dirtySet.GetLinearIntegrated(integrated);
   size_t componentX = 0;
   size_t componentY = 0;
@@ -93,12 +92,26 @@ float GenericClean::ExecuteMajorIteration(
         << (_iterationNumber - startIteration)
         << " in this major iteration with sub-minor optimization.\n";
 
+    // The PSFs are the same in every major iteration, so their kernels are
+    // only recalculated when the (sub-)image size changes.
+    if (_psfKernels.empty() || _psfKernels.size() != psfs.size() ||
+        _psfKernels.front().Width() != _convolutionWidth ||
+        _psfKernels.front().Height() != _convolutionHeight) {
+      _psfKernels.clear();
+      for (const aocommon::Image& psf : psfs) {
+        _psfKernels.emplace_back(_convolutionWidth, _convolutionHeight);
+        subMinorLoop.PrepareKernel(_psfKernels.back().Data(), scratchA.Data(),
+                                   psf.Data());
+      }
+    }
+
     for (size_t imageIndex = 0; imageIndex != dirtySet.size(); ++imageIndex) {
       // TODO this can be multi-threaded if each thread has its own temporaries
-      const aocommon::Image& psf = psfs[dirtySet.PSFIndex(imageIndex)];
-      subMinorLoop.CorrectResidualDirty(scratchA.Data(), scratchB.Data(),
-                                        integrated.Data(), imageIndex,
-                                        dirtySet.Data(imageIndex), psf.Data());
+      const aocommon::Image& kernel =
+          _psfKernels[dirtySet.PSFIndex(imageIndex)];
+      subMinorLoop.CorrectResidualDirtyWithKernel(
+          scratchA.Data(), integrated.Data(), imageIndex,
+          dirtySet.Data(imageIndex), kernel.Data());
 
       subMinorLoop.GetFullIndividualModel(imageIndex, scratchA.Data());
       float* model = modelSet.Data(imageIndex);
@@ -32,6 +32,9 @@ class GenericClean : public DeconvolutionAlgorithm {
   size_t _convolutionHeight;
   const float _convolutionPadding;
   bool _useSubMinorOptimization;
+  /// Convolution kernels of the PSFs, as calculated by
+  /// SubMinorLoop::PrepareKernel().
+  std::vector<aocommon::Image> _psfKernels;
 
   // Scratch buffer should at least accomodate space for image.Size() floats
   // and is only used to avoid unnecessary memory allocations.
@@ -179,18 +179,31 @@ void SubMinorLoop::CorrectResidualDirty(float* scratchA, float* scratchB,
                                         float* residual,
                                         const float* singleConvolvedPsf) const {
   // Get padded kernel in scratchB
-  Image::Untrim(scratchA, _paddedWidth, _paddedHeight, singleConvolvedPsf,
+  PrepareKernel(scratchB, scratchA, singleConvolvedPsf);
+  CorrectResidualDirtyWithKernel(scratchA, scratchC, imageIndex, residual,
+                                 scratchB);
+}
+
+void SubMinorLoop::PrepareKernel(float* kernel, float* scratch,
+                                 const float* singleConvolvedPsf) const {
+  Image::Untrim(scratch, _paddedWidth, _paddedHeight, singleConvolvedPsf,
                 _width, _height);
-  schaapcommon::fft::PrepareConvolutionKernel(scratchB, scratchA, _paddedWidth,
+  schaapcommon::fft::PrepareConvolutionKernel(kernel, scratch, _paddedWidth,
                                               _paddedHeight, _threadCount);
+}
 
+void SubMinorLoop::CorrectResidualDirtyWithKernel(float* scratchA,
+                                                  float* scratchC,
+                                                  size_t imageIndex,
+                                                  float* residual,
+                                                  const float* kernel) const {
   // Get padded model image in scratchA
   GetFullIndividualModel(imageIndex, scratchC);
   Image::Untrim(scratchA, _paddedWidth, _paddedHeight, scratchC, _width,
                 _height);
 
   // Convolve and store in scratchA
-  schaapcommon::fft::Convolve(scratchA, scratchB, _paddedWidth, _paddedHeight,
+  schaapcommon::fft::Convolve(scratchA, kernel, _paddedWidth, _paddedHeight,
                               _threadCount);
 
   // Trim the result into scratchC
@@ -177,6 +177,22 @@ class SubMinorLoop {
                             size_t imageIndex, float* residual,
                             const float* singleConvolvedPsf) const;
 
+  /**
+   * Calculates the padded convolution kernel of @p singleConvolvedPsf that
+   * CorrectResidualDirty() uses. @p kernel and @p scratch need to be able to
+   * store the full padded image.
+   */
+  void PrepareKernel(float* kernel, float* scratch,
+                     const float* singleConvolvedPsf) const;
+
+  /**
+   * Like CorrectResidualDirty(), but with a kernel that was calculated by
+   * PrepareKernel(), such that the kernel can be reused over calls.
+   */
+  void CorrectResidualDirtyWithKernel(float* scratchA, float* scratchC,
+                                      size_t imageIndex, float* residual,
+                                      const float* kernel) const;
+
   void GetFullIndividualModel(size_t imageIndex,
                               float* individualModelImg) const;
 
@@ -893,17 +893,12 @@ template void MSGridderBase::writeVisibilities<4, DDGainMatrix::kFull>(
 
 #ifdef HAVE_EVERYBEAM
 template <size_t PolarizationCount, DDGainMatrix GainEntry>
-void MSGridderBase::ApplyConjugatedFacetBeam(MSReader& msReader,
-                                             InversionRow& rowData,
-                                             const aocommon::BandData& curBand,
-                                             const float* weightBuffer) {
-  MSProvider::MetaData metaData;
-  msReader.ReadMeta(metaData);
-
+void MSGridderBase::ApplyConjugatedFacetBeam(
+    const MSProvider::MetaData& metaData, std::complex<float>* data,
+    const aocommon::BandData& curBand, const float* weightBuffer) {
   CacheBeamResponse(metaData.time, metaData.fieldId, curBand);
 
-  // rowData.data contains the visibilities
-  std::complex<float>* iter = rowData.data;
+  std::complex<float>* iter = data;
   const float* weightIter = weightBuffer;
   for (size_t ch = 0; ch < curBand.ChannelCount(); ++ch) {
     const size_t offset = ch * _pointResponse->GetAllStationsBufferSize();
@@ -926,12 +921,9 @@ void MSGridderBase::ApplyConjugatedFacetBeam(MSReader& msReader,
 
 template <size_t PolarizationCount, DDGainMatrix GainEntry>
 void MSGridderBase::ApplyConjugatedFacetDdEffects(
-    MSReader& msReader, const std::vector<std::string>& antennaNames,
-    InversionRow& rowData, const aocommon::BandData& curBand,
-    const float* weightBuffer) {
-  MSProvider::MetaData metaData;
-  msReader.ReadMeta(metaData);
-
+    const MSProvider::MetaData& metaData,
+    const std::vector<std::string>& antennaNames, std::complex<float>* data,
+    const aocommon::BandData& curBand, const float* weightBuffer) {
   CacheBeamResponse(metaData.time, metaData.fieldId, curBand);
   CacheParmResponse(metaData.time, antennaNames, curBand);
 
@@ -942,7 +934,7 @@ void MSGridderBase::ApplyConjugatedFacetDdEffects(
 
   // Conditional could be templated once C++ supports partial function
   // specialization
-  std::complex<float>* iter = rowData.data;
+  std::complex<float>* iter = data;
   const float* weightIter = weightBuffer;
   if (nparms == 2) {
     for (size_t ch = 0; ch < nchannels; ++ch) {
@@ -1036,12 +1028,9 @@ void MSGridderBase::ApplyConjugatedFacetDdEffects(
 
 template <size_t PolarizationCount, DDGainMatrix GainEntry>
 void MSGridderBase::ApplyConjugatedH5Parm(
-    MSReader& msReader, const std::vector<std::string>& antennaNames,
-    InversionRow& rowData, const aocommon::BandData& curBand,
-    const float* weightBuffer) {
-  MSProvider::MetaData metaData;
-  msReader.ReadMeta(metaData);
-
+    const MSProvider::MetaData& metaData,
+    const std::vector<std::string>& antennaNames, std::complex<float>* data,
+    const aocommon::BandData& curBand, const float* weightBuffer) {
   CacheParmResponse(metaData.time, antennaNames, curBand);
 
   const size_t nparms =
@@ -1051,7 +1040,7 @@ void MSGridderBase::ApplyConjugatedH5Parm(
 
   // Conditional could be templated once C++ supports partial function
   // specialization
-  std::complex<float>* iter = rowData.data;
+  std::complex<float>* iter = data;
   const float* weightIter = weightBuffer;
   if (nparms == 2) {
     for (size_t ch = 0; ch < nchannels; ++ch) {
@@ -1099,91 +1088,75 @@ void MSGridderBase::ApplyConjugatedH5Parm(
 }
 
 template <size_t PolarizationCount, DDGainMatrix GainEntry>
-void MSGridderBase::readAndWeightVisibilities(
-    MSReader& msReader, const std::vector<std::string>& antennaNames,
-    InversionRow& rowData, const aocommon::BandData& curBand,
-    float* weightBuffer, std::complex<float>* modelBuffer,
-    const bool* isSelected) {
-  const std::size_t dataSize = curBand.ChannelCount() * PolarizationCount;
-  if (DoImagePSF()) {
-    std::fill_n(rowData.data, dataSize, 1.0);
-    if (HasDenormalPhaseCentre() && _settings.facetRegionFilename.empty()) {
-      const double lmsqrt = std::sqrt(1.0 - PhaseCentreDL() * PhaseCentreDL() -
-                                      PhaseCentreDM() * PhaseCentreDM());
-      const double shiftFactor = 2.0 * M_PI *
-                                 ((rowData.uvw[0] * PhaseCentreDL() +
-                                   rowData.uvw[1] * PhaseCentreDM()) +
-                                  rowData.uvw[2] * (lmsqrt - 1.0));
-      rotateVisibilities<PolarizationCount>(curBand, shiftFactor, rowData.data);
-    }
-  } else {
-    msReader.ReadData(rowData.data);
-  }
-  rowData.rowId = msReader.RowId();
-
-  if (DoSubtractModel()) {
-    msReader.ReadModel(modelBuffer);
-    std::complex<float>* modelIter = modelBuffer;
-    for (std::complex<float>* iter = rowData.data;
-         iter != rowData.data + dataSize; ++iter) {
-      *iter -= *modelIter;
-      modelIter++;
-    }
+void MSGridderBase::applyConjugatedDdEffects(
+    const MSProvider::MetaData& metaData,
+    const std::vector<std::string>& antennaNames, std::complex<float>* data,
+    const aocommon::BandData& curBand, const float* weightBuffer) {
+  if (_settings.applyFacetBeam && !_h5parms.empty()) {
+#ifdef HAVE_EVERYBEAM
+    ApplyConjugatedFacetDdEffects<PolarizationCount, GainEntry>(
+        metaData, antennaNames, data, curBand, weightBuffer);
+  } else if (_settings.applyFacetBeam) {
+    ApplyConjugatedFacetBeam<PolarizationCount, GainEntry>(
+        metaData, data, curBand, weightBuffer);
+#endif  // HAVE_EVERYBEAM
+  } else if (!_h5parms.empty()) {
+    ApplyConjugatedH5Parm<PolarizationCount, GainEntry>(
+        metaData, antennaNames, data, curBand, weightBuffer);
   }
+}
 
-  msReader.ReadWeights(weightBuffer);
-
-  // Any visibilities that are not gridded in this pass
-  // should not contribute to the weight sum, so set these
-  // to have zero weight.
-  for (size_t i = 0; i != dataSize; ++i) {
-    if (!isSelected[i]) weightBuffer[i] = 0.0;
+template <size_t PolarizationCount>
+void MSGridderBase::setPSFVisibilities(const double* uvw,
+                                       const aocommon::BandData& curBand,
+                                       std::complex<float>* data) {
+  std::fill_n(data, curBand.ChannelCount() * PolarizationCount, 1.0);
+  if (HasDenormalPhaseCentre() && _settings.facetRegionFilename.empty()) {
+    const double lmsqrt = std::sqrt(1.0 - PhaseCentreDL() * PhaseCentreDL() -
+                                    PhaseCentreDM() * PhaseCentreDM());
+    const double shiftFactor =
+        2.0 * M_PI *
+        ((uvw[0] * PhaseCentreDL() + uvw[1] * PhaseCentreDM()) +
+         uvw[2] * (lmsqrt - 1.0));
+    rotateVisibilities<PolarizationCount>(curBand, shiftFactor, data);
   }
+}
 
+void MSGridderBase::applyVisibilityWeightingMode(float* weights,
+                                                 size_t n) const {
   switch (GetVisibilityWeightingMode()) {
     case VisibilityWeightingMode::NormalVisibilityWeighting:
       // The weight buffer already contains the visibility weights: do nothing
       break;
     case VisibilityWeightingMode::SquaredVisibilityWeighting:
       // Square the visibility weights
-      for (size_t i = 0; i != dataSize; ++i) weightBuffer[i] *= weightBuffer[i];
+      for (size_t i = 0; i != n; ++i) weights[i] *= weights[i];
       break;
     case VisibilityWeightingMode::UnitVisibilityWeighting:
       // Set the visibility weights to one
-      for (size_t i = 0; i != dataSize; ++i) {
-        if (weightBuffer[i] != 0.0) weightBuffer[i] = 1.0f;
+      for (size_t i = 0; i != n; ++i) {
+        if (weights[i] != 0.0) weights[i] = 1.0f;
       }
       break;
   }
+}
 
-  // Precompute imaging weights
+void MSGridderBase::computeImagingWeights(const double* uvw,
+                                          const aocommon::BandData& curBand) {
   _scratchImageWeights.resize(curBand.ChannelCount());
   for (size_t ch = 0; ch != curBand.ChannelCount(); ++ch) {
-    const double u = rowData.uvw[0] / curBand.ChannelWavelength(ch);
-    const double v = rowData.uvw[1] / curBand.ChannelWavelength(ch);
+    const double u = uvw[0] / curBand.ChannelWavelength(ch);
+    const double v = uvw[1] / curBand.ChannelWavelength(ch);
     _scratchImageWeights[ch] = GetImageWeights()->GetWeight(u, v);
   }
-  if (StoreImagingWeights())
-    msReader.WriteImagingWeights(_scratchImageWeights.data());
-
-  if (!DoImagePSF()) {
-    if (_settings.applyFacetBeam && !_h5parms.empty()) {
-#ifdef HAVE_EVERYBEAM
-      ApplyConjugatedFacetDdEffects<PolarizationCount, GainEntry>(
-          msReader, antennaNames, rowData, curBand, weightBuffer);
-    } else if (_settings.applyFacetBeam) {
-      ApplyConjugatedFacetBeam<PolarizationCount, GainEntry>(
-          msReader, rowData, curBand, weightBuffer);
-#endif  // HAVE_EVERYBEAM
-    } else if (!_h5parms.empty()) {
-      ApplyConjugatedH5Parm<PolarizationCount, GainEntry>(
-          msReader, antennaNames, rowData, curBand, weightBuffer);
-    }
-  }
+}
 
-  // Calculate imaging weights
-  std::complex<float>* dataIter = rowData.data;
-  float* weightIter = weightBuffer;
+template <size_t PolarizationCount>
+void MSGridderBase::applyImagingWeights(const aocommon::BandData& curBand,
+                                        std::complex<float>* data,
+                                        float* weights) {
+  std::complex<float>* dataIter = data;
+  float* weightIter = weights;
   for (size_t ch = 0; ch != curBand.ChannelCount(); ++ch) {
     for (size_t p = 0; p != PolarizationCount; ++p) {
       const double cumWeight = *weightIter * _scratchImageWeights[ch];
@@ -1203,6 +1176,57 @@ void MSGridderBase::readAndWeightVisibilities(
   }
 }
 
+template <size_t PolarizationCount, DDGainMatrix GainEntry>
+void MSGridderBase::readAndWeightVisibilities(
+    MSReader& msReader, const std::vector<std::string>& antennaNames,
+    InversionRow& rowData, const aocommon::BandData& curBand,
+    float* weightBuffer, std::complex<float>* modelBuffer,
+    const bool* isSelected) {
+  const std::size_t dataSize = curBand.ChannelCount() * PolarizationCount;
+  if (DoImagePSF()) {
+    setPSFVisibilities<PolarizationCount>(rowData.uvw, curBand, rowData.data);
+  } else {
+    msReader.ReadData(rowData.data);
+  }
+  rowData.rowId = msReader.RowId();
+
+  if (DoSubtractModel()) {
+    msReader.ReadModel(modelBuffer);
+    std::complex<float>* modelIter = modelBuffer;
+    for (std::complex<float>* iter = rowData.data;
+         iter != rowData.data + dataSize; ++iter) {
+      *iter -= *modelIter;
+      modelIter++;
+    }
+  }
+
+  msReader.ReadWeights(weightBuffer);
+
+  // Any visibilities that are not gridded in this pass
+  // should not contribute to the weight sum, so set these
+  // to have zero weight.
+  for (size_t i = 0; i != dataSize; ++i) {
+    if (!isSelected[i]) weightBuffer[i] = 0.0;
+  }
+
+  applyVisibilityWeightingMode(weightBuffer, dataSize);
+
+  // Precompute imaging weights
+  computeImagingWeights(rowData.uvw, curBand);
+  if (StoreImagingWeights())
+    msReader.WriteImagingWeights(_scratchImageWeights.data());
+
+  if (hasDdEffects()) {
+    MSProvider::MetaData metaData;
+    msReader.ReadMeta(metaData);
+    applyConjugatedDdEffects<PolarizationCount, GainEntry>(
+        metaData, antennaNames, rowData.data, curBand, weightBuffer);
+  }
+
+  // Calculate imaging weights
+  applyImagingWeights<PolarizationCount>(curBand, rowData.data, weightBuffer);
+}
+
 template void MSGridderBase::readAndWeightVisibilities<1, DDGainMatrix::kXX>(
     MSReader& msReader, const std::vector<std::string>& antennaNames,
     InversionRow& newItem, const aocommon::BandData& curBand,
@@ -1233,6 +1257,70 @@ template void MSGridderBase::readAndWeightVisibilities<4, DDGainMatrix::kFull>(
     float* weightBuffer, std::complex<float>* modelBuffer,
     const bool* isSelected);
 
+template <size_t PolarizationCount, DDGainMatrix GainEntry>
+void MSGridderBase::weightVisibilityBlock(
+    const MSReader::RowBlock& block, std::complex<float>* data, float* weights,
+    const std::complex<float>* model,
+    const std::vector<std::string>& antennaNames,
+    const aocommon::BandData& curBand) {
+  const std::size_t dataSize = curBand.ChannelCount() * PolarizationCount;
+  const bool applyDdEffects = hasDdEffects();
+  MSProvider::MetaData metaData;
+  for (size_t row = 0; row != block.nRows; ++row) {
+    const double* rowUvw = &block.uvw[row * 3];
+    std::complex<float>* rowData = &data[row * dataSize];
+    float* rowWeights = &weights[row * dataSize];
+    if (DoImagePSF())
+      setPSFVisibilities<PolarizationCount>(rowUvw, curBand, rowData);
+    if (DoSubtractModel()) {
+      const std::complex<float>* rowModel = &model[row * dataSize];
+      for (size_t i = 0; i != dataSize; ++i) rowData[i] -= rowModel[i];
+    }
+    applyVisibilityWeightingMode(rowWeights, dataSize);
+    computeImagingWeights(rowUvw, curBand);
+    if (applyDdEffects) {
+      metaData.time = block.time[row];
+      metaData.antenna1 = block.antenna1[row];
+      metaData.antenna2 = block.antenna2[row];
+      metaData.fieldId = block.fieldId[row];
+      applyConjugatedDdEffects<PolarizationCount, GainEntry>(
+          metaData, antennaNames, rowData, curBand, rowWeights);
+    }
+    applyImagingWeights<PolarizationCount>(curBand, rowData, rowWeights);
+  }
+}
+
+template void MSGridderBase::weightVisibilityBlock<1, DDGainMatrix::kXX>(
+    const MSReader::RowBlock& block, std::complex<float>* data, float* weights,
+    const std::complex<float>* model,
+    const std::vector<std::string>& antennaNames,
+    const aocommon::BandData& curBand);
+
+template void MSGridderBase::weightVisibilityBlock<1, DDGainMatrix::kYY>(
+    const MSReader::RowBlock& block, std::complex<float>* data, float* weights,
+    const std::complex<float>* model,
+    const std::vector<std::string>& antennaNames,
+    const aocommon::BandData& curBand);
+
+template void MSGridderBase::weightVisibilityBlock<1, DDGainMatrix::kTrace>(
+    const MSReader::RowBlock& block, std::complex<float>* data, float* weights,
+    const std::complex<float>* model,
+    const std::vector<std::string>& antennaNames,
+    const aocommon::BandData& curBand);
+
+void MSGridderBase::psfVisibilityBlock(const MSReader::RowBlock& block,
+                                       const float* weights,
+                                       const aocommon::BandData& curBand,
+                                       std::complex<float>* psfData) {
+  const std::size_t dataSize = curBand.ChannelCount();
+  for (size_t row = 0; row != block.nRows; ++row) {
+    std::complex<float>* rowData = &psfData[row * dataSize];
+    const float* rowWeights = &weights[row * dataSize];
+    setPSFVisibilities<1>(&block.uvw[row * 3], curBand, rowData);
+    for (size_t i = 0; i != dataSize; ++i) rowData[i] *= rowWeights[i];
+  }
+}
+
 template <size_t PolarizationCount>
 void MSGridderBase::rotateVisibilities(const aocommon::BandData& bandData,
                                        double shiftFactor,
@@ -16,6 +16,8 @@
 
 #include "../main/settings.h"
 
+#include "../msproviders/msreaders/msreader.h"
+
 #include "../scheduling/metadatacache.h"
 #include "../scheduling/griddingtaskmanager.h"
 
@@ -31,8 +33,8 @@
 
 #include <mutex>
 #include <memory>
+#include <stdexcept>
 
-class MSReader;
 namespace schaapcommon {
 namespace h5parm {
 class H5Parm;
@@ -142,8 +144,39 @@ class MSGridderBase {
 
   virtual void Predict(std::vector<aocommon::Image>&& images) = 0;
 
+  /**
+   * Predicts the visibilities of the model images and images the residual
+   * (data minus predicted model) in the same pass over the data. The
+   * predicted visibilities are not written to the measurement set. It is
+   * only supported by some gridders, and requires DoSubtractModel() to be
+   * set.
+   */
+  virtual void PredictAndInvert(std::vector<aocommon::Image>&& images) {
+    throw std::runtime_error(
+        "This gridder does not support fused prediction and inversion");
+  }
+
+  /**
+   * Images the PSF and the data in the same pass over the data. The PSF is
+   * gridded from unit visibilities with the same weights as the data.
+   * Afterwards, ResultImages() returns the image of the data and
+   * ResultPSFImages() returns the PSF. It is only supported by some
+   * gridders, and requires DoImagePSF() to be unset.
+   */
+  virtual void InvertWithPSF() {
+    throw std::runtime_error(
+        "This gridder does not support imaging the PSF and the data in a "
+        "single pass");
+  }
+
   virtual std::vector<aocommon::Image> ResultImages() = 0;
 
+  /**
+   * The PSF images that were made by InvertWithPSF(). Empty when the PSF was
+   * not imaged along with the data.
+   */
+  virtual std::vector<aocommon::Image> ResultPSFImages() { return {}; }
+
   void SetPhaseCentreRA(const double phaseCentreRA) {
     _phaseCentreRA = phaseCentreRA;
   }
@@ -316,6 +349,67 @@ class MSGridderBase {
                                  std::complex<float>* modelBuffer,
                                  const bool* isSelected);
 
+  /**
+   * Whether weightVisibilityBlock() can be used instead of
+   * readAndWeightVisibilities(). This is not the case when imaging weights
+   * are stored, because that requires the per-row reader state.
+   */
+  bool canWeightVisibilityBlocks() const { return !StoreImagingWeights(); }
+
+  /**
+   * Whether the conjugated direction-dependent effects of the facet (the
+   * facet beam and/or the h5parm solutions) are applied while weighting.
+   */
+  bool hasDdEffects() const {
+    return !DoImagePSF() &&
+           (_settings.applyFacetBeam || !_settings.facetSolutionFiles.empty());
+  }
+
+  /**
+   * The cached h5parm solutions are looked up by searching forward in time.
+   * This restarts the search at the first time of the current measurement
+   * set, which is required before its rows are weighted again from the start.
+   */
+  void rewindDdEffectTimes() {
+    if (!_timeOffset.empty()) _timeOffset[_msIndex] = 0;
+  }
+
+  /**
+   * Block version of readAndWeightVisibilities(), for visibilities that were
+   * read with MSReader::ReadBlock(). It applies the same weighting to the
+   * rows of @p block, and may only be used when canWeightVisibilityBlocks()
+   * returns true. All visibilities are gridded.
+   *
+   * The visibilities and weights are given separately from the block, such
+   * that several gridders (e.g. one per facet) can weight their own copy of a
+   * block that was read once. The direction-dependent effects are calculated
+   * from the meta data of the block.
+   * @param data Visibilities, ChannelCount() * PolarizationCount values per
+   * row. On return, these hold the weighted visibilities.
+   * @param weights Visibility weights in the same layout as @p data. On
+   * return, these hold the full applied weights.
+   * @param model Model visibilities, only used when the model is subtracted.
+   */
+  template <size_t PolarizationCount, DDGainMatrix GainEntry>
+  void weightVisibilityBlock(const MSReader::RowBlock& block,
+                             std::complex<float>* data, float* weights,
+                             const std::complex<float>* model,
+                             const std::vector<std::string>& antennaNames,
+                             const aocommon::BandData& curBand);
+
+  /**
+   * Calculates the PSF visibilities of a single-polarization block that was
+   * weighted with weightVisibilityBlock(): the unit visibilities that
+   * DoImagePSF() would have gridded, multiplied with the applied weights.
+   * Because the weights are not changed by the direction-dependent effects,
+   * this gives the same PSF as a separate PSF inversion.
+   * @param weights The weights as returned by weightVisibilityBlock().
+   * @param psfData Output, ChannelCount() values per row.
+   */
+  void psfVisibilityBlock(const MSReader::RowBlock& block, const float* weights,
+                          const aocommon::BandData& curBand,
+                          std::complex<float>* psfData);
+
   /**
    * @brief Write (modelled) visibilities to MS, provides an interface to
    * MSProvider::WriteModel(). Method can be templated on the number of
@@ -416,15 +510,16 @@ class MSGridderBase {
   void initializePredictReader(MSProvider& msProvider);
 
   template <size_t PolarizationCount, DDGainMatrix GainEntry>
-  void ApplyConjugatedH5Parm(MSReader& msReader,
+  void ApplyConjugatedH5Parm(const MSProvider::MetaData& metaData,
                              const std::vector<std::string>& antennaNames,
-                             InversionRow& rowData,
+                             std::complex<float>* data,
                              const aocommon::BandData& curBand,
                              const float* weightBuffer);
 
 #ifdef HAVE_EVERYBEAM
   template <size_t PolarizationCount, DDGainMatrix GainEntry>
-  void ApplyConjugatedFacetBeam(MSReader& msReader, InversionRow& rowData,
+  void ApplyConjugatedFacetBeam(const MSProvider::MetaData& metaData,
+                                std::complex<float>* data,
                                 const aocommon::BandData& curBand,
                                 const float* weightBuffer);
 
@@ -435,11 +530,22 @@ class MSGridderBase {
    */
   template <size_t PolarizationCount, DDGainMatrix GainEntry>
   void ApplyConjugatedFacetDdEffects(
-      MSReader& msReader, const std::vector<std::string>& antennaNames,
-      InversionRow& rowData, const aocommon::BandData& curBand,
-      const float* weightBuffer);
+      const MSProvider::MetaData& metaData,
+      const std::vector<std::string>& antennaNames, std::complex<float>* data,
+      const aocommon::BandData& curBand, const float* weightBuffer);
 #endif  // HAVE_EVERYBEAM
 
+  /**
+   * Applies the effects of hasDdEffects() to the visibilities of a single
+   * row with the given meta data.
+   */
+  template <size_t PolarizationCount, DDGainMatrix GainEntry>
+  void applyConjugatedDdEffects(const MSProvider::MetaData& metaData,
+                                const std::vector<std::string>& antennaNames,
+                                std::complex<float>* data,
+                                const aocommon::BandData& curBand,
+                                const float* weightBuffer);
+
   double _phaseCentreRA, _phaseCentreDec, _phaseCentreDL, _phaseCentreDM;
   double _facetDirectionRA, _facetDirectionDec;
   size_t _facetIndex;
@@ -483,6 +589,25 @@ class MSGridderBase {
 
   aocommon::UVector<float> _scratchImageWeights;
 
+  /**
+   * Helper functions shared by readAndWeightVisibilities() and
+   * weightVisibilityBlock() that process a single row.
+   * @{
+   */
+  template <size_t PolarizationCount>
+  void setPSFVisibilities(const double* uvw, const aocommon::BandData& curBand,
+                          std::complex<float>* data);
+
+  void applyVisibilityWeightingMode(float* weights, size_t n) const;
+
+  void computeImagingWeights(const double* uvw,
+                             const aocommon::BandData& curBand);
+
+  template <size_t PolarizationCount>
+  void applyImagingWeights(const aocommon::BandData& curBand,
+                           std::complex<float>* data, float* weights);
+  /** @} */
+
   std::unique_ptr<MSReader> _predictReader;
   WriterLockManager* _writerLockManager;
 
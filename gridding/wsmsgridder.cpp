@@ -13,17 +13,27 @@
 
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
 #include <fftw3.h>
 
 #include <cassert>
-#include <queue>
+#include <cstdio>
 #include <stdexcept>
 
 using aocommon::Image;
 using aocommon::Logger;
 
+namespace {
+// Number of samples that are buffered in memory before they are written to
+// or after they are read from a pass spill file.
+constexpr size_t kSpillBufferSize = 16384;
+}  // namespace
+
 WSMSGridder::WSMSGridder(const Settings& settings)
     : MSGridderBase(settings),
+      _isSpillingPasses(false),
       _nwWidth(settings.widthForNWCalculation),
       _nwHeight(settings.heightForNWCalculation),
       _nwFactor(settings.nWLayersFactor),
@@ -41,6 +51,7 @@ WSMSGridder::WSMSGridder(const Settings& settings)
 
 WSMSGridder::~WSMSGridder() noexcept {
   for (std::thread& t : _threadGroup) t.join();
+  removePassSpillFiles();
 }
 
 void WSMSGridder::countSamplesPerLayer(MSData& msData) {
@@ -135,11 +146,10 @@ void WSMSGridder::gridMeasurementSet(MSData& msData) {
   aocommon::UVector<bool> isSelected(selectedBand.ChannelCount());
 
   // Samples of the same w-layer are collected in a buffer
-  // before they are written into the lane. This is done because writing
-  // to a lane is reasonably slow; it requires holding a mutex. Without
-  // these buffers, writing the lane was a bottleneck and multithreading
-  // did not help. I think.
-  std::vector<lane_write_buffer<InversionWorkSample>> bufferedLanes(_cpuCount);
+  // before they are written into the lane, such that the lane's write
+  // position is published once per block instead of once per sample.
+  std::vector<lane_write_buffer<InversionWorkSample, InversionLane>>
+      bufferedLanes(_cpuCount);
   size_t bufferSize =
       std::max<size_t>(8u, _inversionCPULanes[0].capacity() / 8);
   bufferSize = std::min<size_t>(
@@ -162,7 +172,8 @@ void WSMSGridder::gridMeasurementSet(MSData& msData) {
       const aocommon::BandData& curBand(selectedBand);
       const double w1 = wInMeters / curBand.LongestWavelength(),
                    w2 = wInMeters / curBand.SmallestWavelength();
-      if (_gridder->IsInLayerRange(w1, w2)) {
+      // When spilling, all rows are read in the first pass
+      if (_isSpillingPasses || _gridder->IsInLayerRange(w1, w2)) {
         newItem.uvw[0] = uInMeters;
         newItem.uvw[1] = vInMeters;
         newItem.uvw[2] = wInMeters;
@@ -171,7 +182,10 @@ void WSMSGridder::gridMeasurementSet(MSData& msData) {
         // should not contribute to the weight sum
         for (size_t ch = 0; ch != curBand.ChannelCount(); ++ch) {
           double w = newItem.uvw[2] / curBand.ChannelWavelength(ch);
-          isSelected[ch] = _gridder->IsInLayerRange(w);
+          if (_isSpillingPasses)
+            isSelected[ch] = _gridder->WToLayer(w) < _gridder->NWLayers();
+          else
+            isSelected[ch] = _gridder->IsInLayerRange(w);
         }
 
         readAndWeightVisibilities<1, GainEntry>(
@@ -192,8 +206,16 @@ void WSMSGridder::gridMeasurementSet(MSData& msData) {
           sampleData.uInLambda = newItem.uvw[0] / wavelength;
           sampleData.vInLambda = newItem.uvw[1] / wavelength;
           sampleData.wInLambda = newItem.uvw[2] / wavelength;
-          size_t cpu = _gridder->WToLayer(sampleData.wInLambda) % _cpuCount;
-          bufferedLanes[cpu].write(sampleData);
+          const size_t layer = _gridder->WToLayer(sampleData.wInLambda);
+          if (_isSpillingPasses) {
+            if (!isSelected[ch]) continue;
+            const size_t pass = _gridder->LayerToPass(layer);
+            if (pass != 0) {
+              spillSample(pass, sampleData);
+              continue;
+            }
+          }
+          bufferedLanes[layer % _cpuCount].write(sampleData);
         }
 
         ++rowsRead;
@@ -202,7 +224,8 @@ void WSMSGridder::gridMeasurementSet(MSData& msData) {
       msReader->NextInputRow();
     }
 
-    for (lane_write_buffer<InversionWorkSample>& buflane : bufferedLanes)
+    for (lane_write_buffer<InversionWorkSample, InversionLane>& buflane :
+         bufferedLanes)
       buflane.write_end();
 
     if (IsFirstIteration())
@@ -210,7 +233,8 @@ void WSMSGridder::gridMeasurementSet(MSData& msData) {
                    << msData.matchingRows << '\n';
     msData.totalRowsProcessed += rowsRead;
   } catch (...) {
-    for (lane_write_buffer<InversionWorkSample>& buflane : bufferedLanes)
+    for (lane_write_buffer<InversionWorkSample, InversionLane>& buflane :
+         bufferedLanes)
       buflane.write_end();
     throw;
   }
@@ -224,13 +248,10 @@ template void WSMSGridder::gridMeasurementSet<DDGainMatrix::kTrace>(
     MSData& msData);
 
 void WSMSGridder::startInversionWorkThreads(size_t maxChannelCount) {
-  _inversionCPULanes.resize(_cpuCount);
+  _inversionCPULanes = std::vector<InversionLane>(_cpuCount);
   _threadGroup.clear();
   for (size_t i = 0; i != _cpuCount; ++i) {
     _inversionCPULanes[i].resize(maxChannelCount * _laneBufferSize);
-    set_lane_debug_name(
-        _inversionCPULanes[i],
-        "Work lane (buffered) containing individual visibility samples");
     _threadGroup.emplace_back(&WSMSGridder::workThreadPerSample, this,
                               &_inversionCPULanes[i]);
   }
@@ -242,19 +263,113 @@ void WSMSGridder::finishInversionWorkThreads() {
   _inversionCPULanes.clear();
 }
 
-void WSMSGridder::workThreadPerSample(
-    aocommon::Lane<InversionWorkSample>* workLane) {
+void WSMSGridder::workThreadPerSample(InversionLane* workLane) {
   size_t bufferSize = std::max<size_t>(8u, workLane->capacity() / 8);
   bufferSize =
       std::min<size_t>(128, std::min(bufferSize, workLane->capacity()));
-  lane_read_buffer<InversionWorkSample> buffer(workLane, bufferSize);
-  InversionWorkSample sampleData;
-  while (buffer.read(sampleData)) {
-    _gridder->AddDataSample(sampleData.sample, sampleData.uInLambda,
-                            sampleData.vInLambda, sampleData.wInLambda);
+  // Samples are read and gridded in blocks, such that the gridder can
+  // resolve the layer and kernel setup once per block.
+  std::vector<InversionWorkSample> buffer(bufferSize);
+  size_t nRead;
+  while ((nRead = workLane->read(buffer.data(), bufferSize)) != 0) {
+    _gridder->AddDataSamples(buffer.data(), nRead);
   }
 }
 
+void WSMSGridder::openPassSpillFiles() {
+  const boost::filesystem::path directory(_settings.temporaryDirectory);
+  _passSpillFiles.resize(_gridder->NPasses());
+  for (size_t pass = 1; pass != _passSpillFiles.size(); ++pass) {
+    PassSpillFile& file = _passSpillFiles[pass];
+    file.filename =
+        (directory / boost::filesystem::unique_path(
+                         "wsclean-wpass-%%%%-%%%%-%%%%-%%%%.tmp"))
+            .string();
+    file.stream.open(file.filename, std::ios::binary | std::ios::trunc);
+    if (!file.stream.good())
+      throw std::runtime_error("Error opening temporary file '" +
+                               file.filename + "' for writing");
+    file.buffer.reserve(kSpillBufferSize);
+  }
+}
+
+void WSMSGridder::spillSample(size_t pass, const InversionWorkSample& sample) {
+  PassSpillFile& file = _passSpillFiles[pass];
+  file.buffer.push_back(sample);
+  if (file.buffer.size() == kSpillBufferSize) {
+    file.stream.write(reinterpret_cast<const char*>(file.buffer.data()),
+                      file.buffer.size() * sizeof(InversionWorkSample));
+    file.buffer.clear();
+  }
+}
+
+void WSMSGridder::closePassSpillFiles() {
+  for (size_t pass = 1; pass != _passSpillFiles.size(); ++pass) {
+    PassSpillFile& file = _passSpillFiles[pass];
+    file.stream.write(reinterpret_cast<const char*>(file.buffer.data()),
+                      file.buffer.size() * sizeof(InversionWorkSample));
+    file.stream.close();
+    if (file.stream.fail())
+      throw std::runtime_error(
+          "Error writing temporary file '" + file.filename +
+          "': is there enough space in the temporary directory?");
+    file.buffer = std::vector<InversionWorkSample>();
+  }
+}
+
+void WSMSGridder::gridSpilledPass(size_t pass) {
+  PassSpillFile& file = _passSpillFiles[pass];
+  std::ifstream stream(file.filename, std::ios::binary);
+  if (!stream.good())
+    throw std::runtime_error("Error opening temporary file '" + file.filename +
+                             "' for reading");
+
+  std::vector<lane_write_buffer<InversionWorkSample, InversionLane>>
+      bufferedLanes(_cpuCount);
+  size_t bufferSize =
+      std::max<size_t>(8u, _inversionCPULanes[0].capacity() / 8);
+  bufferSize = std::min<size_t>(
+      128, std::min(bufferSize, _inversionCPULanes[0].capacity()));
+  for (size_t i = 0; i != _cpuCount; ++i) {
+    bufferedLanes[i].reset(&_inversionCPULanes[i], bufferSize);
+  }
+
+  std::vector<InversionWorkSample> block(kSpillBufferSize);
+  try {
+    while (stream.read(reinterpret_cast<char*>(block.data()),
+                       block.size() * sizeof(InversionWorkSample)) ||
+           stream.gcount() != 0) {
+      const size_t n = stream.gcount() / sizeof(InversionWorkSample);
+      for (size_t i = 0; i != n; ++i) {
+        const size_t cpu = _gridder->WToLayer(block[i].wInLambda) % _cpuCount;
+        bufferedLanes[cpu].write(block[i]);
+      }
+    }
+    for (lane_write_buffer<InversionWorkSample, InversionLane>& buflane :
+         bufferedLanes)
+      buflane.write_end();
+  } catch (...) {
+    for (lane_write_buffer<InversionWorkSample, InversionLane>& buflane :
+         bufferedLanes)
+      buflane.write_end();
+    throw;
+  }
+  stream.close();
+  std::remove(file.filename.c_str());
+  file.filename.clear();
+}
+
+void WSMSGridder::removePassSpillFiles() noexcept {
+  for (PassSpillFile& file : _passSpillFiles) {
+    if (!file.filename.empty()) {
+      file.stream.close();
+      std::remove(file.filename.c_str());
+    }
+  }
+  _passSpillFiles.clear();
+  _isSpillingPasses = false;
+}
+
 template <DDGainMatrix GainEntry>
 void WSMSGridder::predictMeasurementSet(MSData& msData) {
   msData.msProvider->ReopenRW();
@@ -266,21 +381,22 @@ void WSMSGridder::predictMeasurementSet(MSData& msData) {
 
   size_t rowsProcessed = 0;
 
-  aocommon::Lane<PredictionWorkItem> calcLane(_laneBufferSize + _cpuCount),
-      writeLane(_laneBufferSize);
-  set_lane_debug_name(
-      calcLane,
-      "Prediction calculation lane (buffered) containing full row data");
-  set_lane_debug_name(writeLane,
-                      "Prediction write lane containing full row data");
-  lane_write_buffer<PredictionWorkItem> bufferedCalcLane(&calcLane,
-                                                         _laneBufferSize);
+  // Rows are distributed round-robin over the calculation threads, each
+  // with its own input and output lane. Because every thread processes its
+  // rows in order, the write thread can restore the row order by reading
+  // the output lanes round-robin as well.
+  const size_t laneSize = std::max<size_t>(_laneBufferSize / _cpuCount, 64);
+  std::vector<PredictionLane> calcLanes(_cpuCount), writeLanes(_cpuCount);
+  for (size_t i = 0; i != _cpuCount; ++i) {
+    calcLanes[i].resize(laneSize);
+    writeLanes[i].resize(laneSize);
+  }
   std::thread writeThread(&WSMSGridder::predictWriteThread<GainEntry>, this,
-                          &writeLane, &msData, &selectedBandData);
+                          &writeLanes, &msData, &selectedBandData);
   std::vector<std::thread> calcThreads;
   for (size_t i = 0; i != _cpuCount; ++i)
-    calcThreads.emplace_back(&WSMSGridder::predictCalcThread, this, &calcLane,
-                             &writeLane, &selectedBandData);
+    calcThreads.emplace_back(&WSMSGridder::predictCalcThread, this,
+                             &calcLanes[i], &writeLanes[i], &selectedBandData);
 
   /* Start by reading the u,v,ws in, so we don't need IO access
    * from this thread during further processing */
@@ -304,16 +420,15 @@ void WSMSGridder::predictMeasurementSet(MSData& msData) {
         new std::complex<float>[selectedBandData.ChannelCount()]);
     newItem.rowId = rowIds[i];
 
-    bufferedCalcLane.write(std::move(newItem));
+    calcLanes[i % _cpuCount].write(std::move(newItem));
   }
   if (IsFirstIteration())
     Logger::Info << "Rows that were required: " << rowsProcessed << '/'
                  << msData.matchingRows << '\n';
   msData.totalRowsProcessed += rowsProcessed;
 
-  bufferedCalcLane.write_end();
+  for (PredictionLane& lane : calcLanes) lane.write_end();
   for (std::thread& thr : calcThreads) thr.join();
-  writeLane.write_end();
   writeThread.join();
 }
 
@@ -324,13 +439,9 @@ template void WSMSGridder::predictMeasurementSet<DDGainMatrix::kYY>(
 template void WSMSGridder::predictMeasurementSet<DDGainMatrix::kTrace>(
     MSData& msData);
 
-void WSMSGridder::predictCalcThread(
-    aocommon::Lane<PredictionWorkItem>* inputLane,
-    aocommon::Lane<PredictionWorkItem>* outputLane,
-    const aocommon::BandData* bandData) {
-  lane_write_buffer<PredictionWorkItem> writeBuffer(outputLane,
-                                                    _laneBufferSize);
-
+void WSMSGridder::predictCalcThread(PredictionLane* inputLane,
+                                    PredictionLane* outputLane,
+                                    const aocommon::BandData* bandData) {
   PredictionWorkItem item;
   while (inputLane->read(item)) {
     _gridder->SampleData(item.data.get(), item.uvw[0], item.uvw[1],
@@ -342,50 +453,38 @@ void WSMSGridder::predictCalcThread(
       rotateVisibilities<1>(*bandData, shiftFactor, item.data.get());
     }
 
-    writeBuffer.write(std::move(item));
+    outputLane->write(std::move(item));
   }
+  outputLane->write_end();
 }
 
 template <DDGainMatrix GainEntry>
 void WSMSGridder::predictWriteThread(
-    aocommon::Lane<PredictionWorkItem>* predictionWorkLane,
-    const MSData* msData, const aocommon::BandData* bandData) {
-  lane_read_buffer<PredictionWorkItem> buffer(
-      predictionWorkLane,
-      std::min(_laneBufferSize, predictionWorkLane->capacity()));
+    std::vector<PredictionLane>* predictionLanes, const MSData* msData,
+    const aocommon::BandData* bandData) {
   PredictionWorkItem workItem;
-  auto comparison = [](const PredictionWorkItem& lhs,
-                       const PredictionWorkItem& rhs) -> bool {
-    return lhs.rowId > rhs.rowId;
-  };
-  std::priority_queue<PredictionWorkItem, std::vector<PredictionWorkItem>,
-                      decltype(comparison)>
-      queue(comparison);
+  size_t laneIndex = 0;
   size_t nextRowId = 0;
-  while (buffer.read(workItem)) {
-    queue.emplace(std::move(workItem));
-    while (queue.top().rowId == nextRowId) {
-      writeVisibilities<1, GainEntry>(*msData->msProvider, msData->antennaNames,
-                                      *bandData, queue.top().data.get());
-
-      queue.pop();
-      ++nextRowId;
-    }
+  while ((*predictionLanes)[laneIndex].read(workItem)) {
+    assert(workItem.rowId == nextRowId);
+    writeVisibilities<1, GainEntry>(*msData->msProvider, msData->antennaNames,
+                                    *bandData, workItem.data.get());
+    ++nextRowId;
+    laneIndex = (laneIndex + 1) % predictionLanes->size();
   }
-  assert(queue.empty());
 }
 
 template void WSMSGridder::predictWriteThread<DDGainMatrix::kXX>(
-    aocommon::Lane<PredictionWorkItem>* predictionWorkLane,
-    const MSData* msData, const aocommon::BandData* bandData);
+    std::vector<PredictionLane>* predictionLanes, const MSData* msData,
+    const aocommon::BandData* bandData);
 
 template void WSMSGridder::predictWriteThread<DDGainMatrix::kYY>(
-    aocommon::Lane<PredictionWorkItem>* predictionWorkLane,
-    const MSData* msData, const aocommon::BandData* bandData);
+    std::vector<PredictionLane>* predictionLanes, const MSData* msData,
+    const aocommon::BandData* bandData);
 
 template void WSMSGridder::predictWriteThread<DDGainMatrix::kTrace>(
-    aocommon::Lane<PredictionWorkItem>* predictionWorkLane,
-    const MSData* msData, const aocommon::BandData* bandData);
+    std::vector<PredictionLane>* predictionLanes, const MSData* msData,
+    const aocommon::BandData* bandData);
 
 void WSMSGridder::Invert() {
   std::vector<MSData> msDataVector;
@@ -414,6 +513,15 @@ void WSMSGridder::Invert() {
       countSamplesPerLayer(msDataVector[i]);
   }
 
+  // In spilling mode, the first pass reads all data and stores the samples of
+  // later passes in temporary files, so that the data is read only once.
+  const bool spillPasses = _settings.spillWPasses && _gridder->NPasses() > 1;
+  if (spillPasses) {
+    Logger::Info << "Visibilities for passes 1-" << (_gridder->NPasses() - 1)
+                 << " will be stored in temporary files.\n";
+    openPassSpillFiles();
+  }
+
   resetVisibilityCounters();
   for (size_t pass = 0; pass != _gridder->NPasses(); ++pass) {
     Logger::Info << "Gridding pass " << pass << "... ";
@@ -424,26 +532,42 @@ void WSMSGridder::Invert() {
 
     _gridder->StartInversionPass(pass);
 
-    for (size_t i = 0; i != MeasurementSetCount(); ++i) {
-      MSData& msData = msDataVector[i];
+    if (spillPasses && pass != 0) {
+      size_t maxChannelCount = 1;
+      for (const MSData& msData : msDataVector)
+        maxChannelCount =
+            std::max(maxChannelCount, msData.SelectedBand().ChannelCount());
+      startInversionWorkThreads(maxChannelCount);
+      gridSpilledPass(pass);
+      finishInversionWorkThreads();
+    } else {
+      _isSpillingPasses = spillPasses;
+      for (size_t i = 0; i != MeasurementSetCount(); ++i) {
+        MSData& msData = msDataVector[i];
 
-      const aocommon::BandData selectedBand(msData.SelectedBand());
+        const aocommon::BandData selectedBand(msData.SelectedBand());
 
-      startInversionWorkThreads(selectedBand.ChannelCount());
+        startInversionWorkThreads(selectedBand.ChannelCount());
 
-      if (Polarization() == aocommon::Polarization::XX) {
-        gridMeasurementSet<DDGainMatrix::kXX>(msData);
-      } else if (Polarization() == aocommon::Polarization::YY) {
-        gridMeasurementSet<DDGainMatrix::kYY>(msData);
-      } else {
-        gridMeasurementSet<DDGainMatrix::kTrace>(msData);
+        if (Polarization() == aocommon::Polarization::XX) {
+          gridMeasurementSet<DDGainMatrix::kXX>(msData);
+        } else if (Polarization() == aocommon::Polarization::YY) {
+          gridMeasurementSet<DDGainMatrix::kYY>(msData);
+        } else {
+          gridMeasurementSet<DDGainMatrix::kTrace>(msData);
+        }
+        finishInversionWorkThreads();
+      }
+      if (spillPasses) {
+        _isSpillingPasses = false;
+        closePassSpillFiles();
       }
-      finishInversionWorkThreads();
     }
 
     Logger::Info << "Fourier transforms...\n";
     _gridder->FinishInversionPass();
   }
+  removePassSpillFiles();
 
   if (IsFirstIteration()) {
     size_t totalRowsRead = 0, totalMatchingRows = 0;
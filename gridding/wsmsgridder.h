@@ -4,15 +4,18 @@
 #include "msgridderbase.h"
 #include "wstackinggridder.h"
 
+#include "../system/spsc_ring.h"
+
 #include <casacore/casa/Arrays/Array.h>
 #include <casacore/tables/Tables/ArrayColumn.h>
 
 #include <aocommon/image.h>
-#include <aocommon/lane.h>
 #include <aocommon/multibanddata.h>
 
 #include <complex>
+#include <fstream>
 #include <memory>
+#include <string>
 #include <thread>
 
 class WSMSGridder final : public MSGridderBase {
@@ -43,15 +46,26 @@ class WSMSGridder final : public MSGridderBase {
   double NWFactor() const { return _nwFactor; }
 
  private:
-  struct InversionWorkSample {
-    double uInLambda, vInLambda, wInLambda;
-    std::complex<float> sample;
+  typedef GridderType::DataSample InversionWorkSample;
+  /**
+   * Temporary file that holds the (weighted) samples of a single pass, used
+   * when the w-layers of all passes are gridded from a single read of the
+   * data (see Settings::spillWPasses).
+   */
+  struct PassSpillFile {
+    std::string filename;
+    std::ofstream stream;
+    std::vector<InversionWorkSample> buffer;
   };
   struct PredictionWorkItem {
     std::array<double, 3> uvw;
     std::unique_ptr<std::complex<float>[]> data;
     size_t rowId;
   };
+  // Each lane has a single producer and a single consumer, hence lock-free
+  // rings can be used.
+  typedef spsc_ring<InversionWorkSample> InversionLane;
+  typedef spsc_ring<PredictionWorkItem> PredictionLane;
 
   template <DDGainMatrix GainEntry>
   void gridMeasurementSet(MSData& msData);
@@ -73,19 +87,27 @@ class WSMSGridder final : public MSGridderBase {
 
   void startInversionWorkThreads(size_t maxChannelCount);
   void finishInversionWorkThreads();
-  void workThreadPerSample(aocommon::Lane<InversionWorkSample>* workLane);
+  void workThreadPerSample(InversionLane* workLane);
+
+  void openPassSpillFiles();
+  void spillSample(size_t pass, const InversionWorkSample& sample);
+  void closePassSpillFiles();
+  void gridSpilledPass(size_t pass);
+  void removePassSpillFiles() noexcept;
 
-  void predictCalcThread(aocommon::Lane<PredictionWorkItem>* inputLane,
-                         aocommon::Lane<PredictionWorkItem>* outputLane,
+  void predictCalcThread(PredictionLane* inputLane, PredictionLane* outputLane,
                          const aocommon::BandData* bandData);
 
   template <DDGainMatrix GainEntry>
-  void predictWriteThread(aocommon::Lane<PredictionWorkItem>* samplingWorkLane,
+  void predictWriteThread(std::vector<PredictionLane>* predictionLanes,
                           const MSData* msData,
                           const aocommon::BandData* bandData);
 
   std::unique_ptr<GridderType> _gridder;
-  std::vector<aocommon::Lane<InversionWorkSample>> _inversionCPULanes;
+  std::vector<InversionLane> _inversionCPULanes;
+  /// Indexed by pass; the entry for pass 0 is not used.
+  std::vector<PassSpillFile> _passSpillFiles;
+  bool _isSpillingPasses;
   std::vector<std::thread> _threadGroup;
   size_t _nwWidth, _nwHeight;
   size_t _currentDataDescId;
@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <limits>
 
 using aocommon::ComplexImageBase;
 using aocommon::Image;
@@ -564,17 +565,8 @@ void WStackingGridder<T>::AddDataSample(std::complex<float> sample,
         // Are we on the edge?
         if (x < mid || x + mid + 1 >= int(_width) || y < mid ||
             y + mid + 1 >= int(_height)) {
-          for (size_t j = 0; j != _kernelSize; ++j) {
-            const num_t yKernelValue = yKernel[j];
-            size_t cy = ((y + j + _height - mid) % _height) * _width;
-            for (size_t i = 0; i != _kernelSize; ++i) {
-              size_t cx = (x + i + _width - mid) % _width;
-              std::complex<num_t> *uvRowPtr = &uvData[cx + cy];
-              const num_t kernelValue = yKernelValue * xKernel[i];
-              *uvRowPtr += std::complex<num_t>(sample.real() * kernelValue,
-                                               sample.imag() * kernelValue);
-            }
-          }
+          addSampleWrapped(uvData, sample, x, y, xKernel.data(),
+                           yKernel.data());
         } else {
           x -= mid;
           y -= mid;
@@ -595,6 +587,110 @@ void WStackingGridder<T>::AddDataSample(std::complex<float> sample,
   }
 }
 
+template <typename T>
+void WStackingGridder<T>::AddDataSamples(const DataSample *samples, size_t n) {
+  const size_t layerOffset = layerRangeStart(_curLayerRangeIndex),
+               layerRangeEnd = layerRangeStart(_curLayerRangeIndex + 1);
+  const bool isNearestNeighbour =
+      _gridMode == GridMode::NearestNeighbourGridding;
+  const int mid = _kernelSize / 2;
+  const int halfWidth = int(_width) / 2, halfHeight = int(_height) / 2;
+  const double uFactor = _pixelSizeX * _width,
+               vFactor = _pixelSizeY * _height;
+  // The horizontal kernel multiplied with the sample, stored as interleaved
+  // real and imaginary values such that a full kernel row can be added to
+  // the (interleaved) uv grid with a single vectorizable loop.
+  std::vector<num_t> kernelRow(_kernelSize * 2);
+
+  size_t currentLayer = std::numeric_limits<size_t>::max();
+  std::complex<num_t> *uvData = nullptr;
+  for (const DataSample *iter = samples; iter != samples + n; ++iter) {
+    double uInLambda = iter->uInLambda, vInLambda = iter->vInLambda,
+           wInLambda = iter->wInLambda;
+    std::complex<float> sample = iter->sample;
+    if (_imageConjugatePart) {
+      uInLambda = -uInLambda;
+      vInLambda = -vInLambda;
+      sample = std::conj(sample);
+    }
+    if (wInLambda < 0.0 && !_isComplex) {
+      uInLambda = -uInLambda;
+      vInLambda = -vInLambda;
+      wInLambda = -wInLambda;
+      sample = std::conj(sample);
+    }
+    const size_t wLayer = WToLayer(wInLambda);
+    if (wLayer < layerOffset || wLayer >= layerRangeEnd) continue;
+    if (wLayer != currentLayer) {
+      currentLayer = wLayer;
+      uvData = _layeredUVData[wLayer - layerOffset].Data();
+    }
+
+    const double xExact = uInLambda * uFactor, yExact = vInLambda * vFactor;
+    int x = std::round(xExact), y = std::round(yExact);
+    if (x <= -halfWidth || y <= -halfHeight || x > halfWidth ||
+        y > halfHeight)
+      continue;
+
+    if (isNearestNeighbour) {
+      if (x < 0) x += _width;
+      if (y < 0) y += _height;
+      uvData[x + y * _width] += sample;
+      continue;
+    }
+
+    int xKernelIndex = std::round((xExact - double(x)) * _overSamplingFactor),
+        yKernelIndex = std::round((yExact - double(y)) * _overSamplingFactor);
+    xKernelIndex =
+        (xKernelIndex + (_overSamplingFactor * 3) / 2) % _overSamplingFactor;
+    yKernelIndex =
+        (yKernelIndex + (_overSamplingFactor * 3) / 2) % _overSamplingFactor;
+    const num_t *xKernel = _griddingKernels[xKernelIndex].data();
+    const num_t *yKernel = _griddingKernels[yKernelIndex].data();
+    if (x < 0) x += _width;
+    if (y < 0) y += _height;
+    if (x < mid || x + mid + 1 >= int(_width) || y < mid ||
+        y + mid + 1 >= int(_height)) {
+      addSampleWrapped(uvData, sample, x, y, xKernel, yKernel);
+    } else {
+      const num_t sampleReal = sample.real(), sampleImag = sample.imag();
+      for (size_t i = 0; i != _kernelSize; ++i) {
+        kernelRow[i * 2] = sampleReal * xKernel[i];
+        kernelRow[i * 2 + 1] = sampleImag * xKernel[i];
+      }
+      const size_t rowLength = _kernelSize * 2;
+      const num_t *kernelRowPtr = kernelRow.data();
+      num_t *uvRowPtr =
+          reinterpret_cast<num_t *>(&uvData[(x - mid) + (y - mid) * _width]);
+      for (size_t j = 0; j != _kernelSize; ++j) {
+        const num_t yKernelValue = yKernel[j];
+        for (size_t i = 0; i != rowLength; ++i)
+          uvRowPtr[i] += yKernelValue * kernelRowPtr[i];
+        uvRowPtr += _width * 2;
+      }
+    }
+  }
+}
+
+template <typename T>
+void WStackingGridder<T>::addSampleWrapped(std::complex<num_t> *uvData,
+                                           std::complex<float> sample, int x,
+                                           int y, const num_t *xKernel,
+                                           const num_t *yKernel) const {
+  const int mid = _kernelSize / 2;
+  for (size_t j = 0; j != _kernelSize; ++j) {
+    const num_t yKernelValue = yKernel[j];
+    size_t cy = ((y + j + _height - mid) % _height) * _width;
+    for (size_t i = 0; i != _kernelSize; ++i) {
+      size_t cx = (x + i + _width - mid) % _width;
+      std::complex<num_t> *uvRowPtr = &uvData[cx + cy];
+      const num_t kernelValue = yKernelValue * xKernel[i];
+      *uvRowPtr += std::complex<num_t>(sample.real() * kernelValue,
+                                       sample.imag() * kernelValue);
+    }
+  }
+}
+
 template <typename T>
 void WStackingGridder<T>::SampleDataSample(std::complex<float> &value,
                                            double uInLambda, double vInLambda,
@@ -54,7 +54,7 @@
  * - Call @ref PrepareWLayers();
  * - For each pass if multiple passes are necessary (or once otherwise) :
  *   - Call @ref StartInversionPass();
- *   - Add all samples with @ref AddDataSample();
+ *   - Add all samples with @ref AddDataSample() or @ref AddDataSamples();
  *   - Call @ref FinishInversionPass();
  * - Finally, call @ref FinalizeImage();
  * - Now, @ref RealImage() and optionally @ref ImaginaryImage() will return the
@@ -266,6 +266,19 @@ class WStackingGridder {
    */
   size_t NPasses() const { return _nPasses; }
 
+  /**
+   * Determine in which pass the given w-layer is processed. Valid once
+   * @ref PrepareWLayers() has been called.
+   * @param layer W-layer index, 0 <= @p layer < @ref NWLayers().
+   * @returns Zero-indexed pass index.
+   */
+  size_t LayerToPass(size_t layer) const {
+    size_t pass = layer * _nPasses / _nWLayers;
+    while (layerRangeStart(pass + 1) <= layer) ++pass;
+    while (layerRangeStart(pass) > layer) --pass;
+    return pass;
+  }
+
 #ifndef AVOID_CASACORE
   /**
    * Grid an array of data values for inversion. The data values should have the
@@ -300,6 +313,30 @@ class WStackingGridder {
   void AddDataSample(std::complex<float> sample, double uInLambda,
                      double vInLambda, double wInLambda);
 
+  /**
+   * A single visibility sample together with its uvw-coordinate, as accepted
+   * by @ref AddDataSamples().
+   */
+  struct DataSample {
+    double uInLambda, vInLambda, wInLambda;
+    std::complex<float> sample;
+  };
+
+  /**
+   * Grid a contiguous block of visibility samples for inversion. The result is
+   * the same as calling @ref AddDataSample() for each sample, but the layer
+   * range and grid mode are resolved once per block, and the kernel is
+   * applied separably: each sample is first multiplied with its horizontal
+   * kernel, after which every kernel row is a contiguous multiply-add that
+   * the compiler vectorizes. It is most efficient when consecutive samples
+   * are on the same w-layer, as is the case when the caller bins samples by
+   * layer. This method may be called concurrently from multiple threads, as
+   * long as the threads grid on different w-layers.
+   * @param samples Array of @p n samples.
+   * @param n Number of samples in the block.
+   */
+  void AddDataSamples(const DataSample *samples, size_t n);
+
   /**
    * Initialize a new inversion gridding pass. @ref PrepareWLayers() should have
    * been called beforehand. Each call to @ref StartInversionPass() should be
@@ -572,6 +609,14 @@ class WStackingGridder {
                                 size_t threadIndex);
   template <bool IsComplexImpl>
   void copyImageToLayerAndInverseCorrect(std::complex<num_t> *dest, double w);
+  /**
+   * Grid a sample that is partly outside the uv grid, in which case its
+   * kernel wraps around the grid edges. @p x and @p y are the (non-negative)
+   * grid indices of the kernel centre.
+   */
+  void addSampleWrapped(std::complex<num_t> *uvData,
+                        std::complex<float> sample, int x, int y,
+                        const num_t *xKernel, const num_t *yKernel) const;
   void initializeSqrtLMLookupTable();
   void initializeSqrtLMLookupTableForSampling();
   void initializeLayeredUVData(size_t n);
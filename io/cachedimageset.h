@@ -9,14 +9,51 @@
 #include <schaapcommon/facets/facet.h>
 
 #include <string.h>
-#include <set>
+#include <algorithm>
 #include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
 
 class CachedImageSet {
  public:
+  /**
+   * An amount of memory that one or more CachedImageSets may use to keep
+   * images in memory instead of writing them to disk. Images that no longer
+   * fit are stored as temporary FITS files as usual.
+   */
+  class MemoryBudget {
+   public:
+    explicit MemoryBudget(size_t bytes) : _available(bytes) {}
+
+    /**
+     * Reserves @p bytes of memory.
+     * @returns false if not enough memory is left, in which case nothing is
+     * reserved.
+     */
+    bool Claim(size_t bytes) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (bytes > _available) return false;
+      _available -= bytes;
+      return true;
+    }
+
+    void Release(size_t bytes) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _available += bytes;
+    }
+
+   private:
+    std::mutex _mutex;
+    size_t _available;
+  };
+
   CachedImageSet() : _polCount(0), _freqCount(0), _facetCount(0), _image() {}
 
   ~CachedImageSet() {
+    releaseMemoryImages();
     for (const std::string& filename : _storedNames)
       std::remove(filename.c_str());
   }
@@ -35,6 +72,15 @@ class CachedImageSet {
     _image.Reset();
   }
 
+  /**
+   * Keep images in memory as long as they fit in @p budget. The budget may be
+   * shared with other CachedImageSets.
+   */
+  void SetMemoryBudget(std::shared_ptr<MemoryBudget> budget) {
+    releaseMemoryImages();
+    _memoryBudget = std::move(budget);
+  }
+
   void SetFitsWriter(const aocommon::FitsWriter& writer) { _writer = writer; }
 
   aocommon::FitsWriter& Writer() { return _writer; }
@@ -55,8 +101,11 @@ class CachedImageSet {
         std::copy(_image.Data(),
                   _image.Data() + _writer.Width() * _writer.Height(), image);
     } else {
-      aocommon::FitsReader reader(name(polarization, freqIndex, isImaginary));
-      reader.Read(image);
+      const std::string filename = name(polarization, freqIndex, isImaginary);
+      if (!loadFromMemory(filename, image)) {
+        aocommon::FitsReader reader(filename);
+        reader.Read(image);
+      }
     }
   }
 
@@ -73,8 +122,10 @@ class CachedImageSet {
       std::string filename =
           nameFacet(polarization, freqIndex, facetIndex, isImaginary);
       aocommon::Logger::Debug << "Loading " << filename << '\n';
-      aocommon::FitsReader reader(filename);
-      reader.Read(image);
+      if (!loadFromMemory(filename, image)) {
+        aocommon::FitsReader reader(filename);
+        reader.Read(image);
+      }
     }
   }
 
@@ -94,8 +145,12 @@ class CachedImageSet {
                 _image.Data());
     } else {
       std::string filename = name(polarization, freqIndex, isImaginary);
-      _writer.Write(filename, image);
-      _storedNames.insert(filename);
+      if (!storeInMemory(filename, image,
+                         _writer.Width() * _writer.Height())) {
+        _writer.Write(filename, image);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _storedNames.insert(filename);
+      }
     }
   }
 
@@ -112,6 +167,9 @@ class CachedImageSet {
       std::string filename =
           nameFacet(polarization, freqIndex, facetIndex, isImaginary);
       aocommon::Logger::Debug << "Storing " << filename << '\n';
+      const size_t facetSize = facet->GetTrimmedBoundingBox().Width() *
+                               facet->GetTrimmedBoundingBox().Height();
+      if (storeInMemory(filename, image, facetSize)) return;
 
       // Initialize FacetWriter, use the trimmed facet width and
       // height as dimensions. The image argument that is fed into
@@ -120,6 +178,7 @@ class CachedImageSet {
       facetWriter.SetImageDimensions(facet->GetTrimmedBoundingBox().Width(),
                                      facet->GetTrimmedBoundingBox().Height());
       facetWriter.Write(filename, image);
+      std::lock_guard<std::mutex> lock(_mutex);
       _storedNames.insert(filename);
     }
   }
@@ -127,7 +186,9 @@ class CachedImageSet {
   /**
    * A CachedImageSet is empty as long as Store() has not been called.
    */
-  bool Empty() const { return _storedNames.empty() && _image.Empty(); }
+  bool Empty() const {
+    return _storedNames.empty() && _image.Empty() && _memoryImages.empty();
+  }
 
   /**
    * @return The filenames of the temporarily stored files, for testing only.
@@ -135,6 +196,46 @@ class CachedImageSet {
   const std::set<std::string>& GetStoredNames() const { return _storedNames; };
 
  private:
+  /**
+   * Keeps the image in memory if an image with the same name is already in
+   * memory, or if it fits in the memory budget.
+   * @returns false if the image should be stored on disk instead.
+   */
+  template <typename NumT>
+  bool storeInMemory(const std::string& filename, const NumT* image,
+                     size_t size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto iter = _memoryImages.find(filename);
+    if (iter == _memoryImages.end() || iter->second.size() != size) {
+      if (iter != _memoryImages.end()) {
+        _memoryBudget->Release(iter->second.size() * sizeof(float));
+        _memoryImages.erase(iter);
+      }
+      if (!_memoryBudget || !_memoryBudget->Claim(size * sizeof(float)))
+        return false;
+      iter = _memoryImages.emplace(filename, std::vector<float>(size)).first;
+    }
+    std::copy_n(image, size, iter->second.data());
+    return true;
+  }
+
+  template <typename NumT>
+  bool loadFromMemory(const std::string& filename, NumT* image) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto iter = _memoryImages.find(filename);
+    if (iter == _memoryImages.end()) return false;
+    std::copy(iter->second.begin(), iter->second.end(), image);
+    return true;
+  }
+
+  void releaseMemoryImages() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const std::pair<const std::string, std::vector<float>>& memoryImage :
+         _memoryImages)
+      _memoryBudget->Release(memoryImage.second.size() * sizeof(float));
+    _memoryImages.clear();
+  }
+
   std::string name(aocommon::PolarizationEnum polarization, size_t freqIndex,
                    bool isImaginary) const {
     return nameTrunk(polarization, freqIndex, isImaginary) + "-tmp.fits";
@@ -179,6 +280,10 @@ class CachedImageSet {
 
   aocommon::Image _image;
   std::set<std::string> _storedNames;
+  /// Images that are kept in memory, indexed by the name of their file.
+  std::map<std::string, std::vector<float>> _memoryImages;
+  std::shared_ptr<MemoryBudget> _memoryBudget;
+  mutable std::mutex _mutex;
 };
 
 #endif
@@ -0,0 +1,123 @@
+#include "imageweightcache.h"
+
+#include <aocommon/io/serialistream.h>
+#include <aocommon/io/serialostream.h>
+#include <aocommon/uvector.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+ImageWeightCache::~ImageWeightCache() {
+  for (const Entry& entry : _entries) {
+    if (!entry.spillFilename.empty())
+      std::remove(entry.spillFilename.c_str());
+  }
+}
+
+std::shared_ptr<ImageWeights> ImageWeightCache::Get(
+    const std::vector<std::unique_ptr<MSDataDescription>>& msList,
+    size_t outChannelIndex, size_t outIntervalIndex) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  std::list<Entry>::iterator entry =
+      findEntry(outChannelIndex, outIntervalIndex);
+  while (entry != _entries.end() && entry->isPending) {
+    _entryCondition.wait(lock);
+    entry = findEntry(outChannelIndex, outIntervalIndex);
+  }
+  if (entry == _entries.end()) {
+    _entries.emplace_front();
+    entry = _entries.begin();
+    entry->outChannelIndex = outChannelIndex;
+    entry->outIntervalIndex = outIntervalIndex;
+  } else {
+    _entries.splice(_entries.begin(), _entries, entry);
+    if (entry->weights) return entry->weights;
+  }
+
+  // A pending entry is never evicted, so the iterator stays valid while the
+  // weights are calculated or loaded without holding the lock.
+  entry->isPending = true;
+  const std::string spillFilename = entry->spillFilename;
+  lock.unlock();
+  std::shared_ptr<ImageWeights> weights;
+  try {
+    if (spillFilename.empty())
+      weights = recalculateWeights(msList);
+    else
+      weights = loadWeights(spillFilename);
+  } catch (...) {
+    lock.lock();
+    if (!entry->spillFilename.empty())
+      std::remove(entry->spillFilename.c_str());
+    _entries.erase(entry);
+    _entryCondition.notify_all();
+    throw;
+  }
+  lock.lock();
+  entry->weights = weights;
+  entry->isPending = false;
+  _entryCondition.notify_all();
+  evict();
+  return weights;
+}
+
+std::list<ImageWeightCache::Entry>::iterator ImageWeightCache::findEntry(
+    size_t outChannelIndex, size_t outIntervalIndex) {
+  return std::find_if(_entries.begin(), _entries.end(), [&](const Entry& e) {
+    return e.outChannelIndex == outChannelIndex &&
+           e.outIntervalIndex == outIntervalIndex;
+  });
+}
+
+void ImageWeightCache::evict() {
+  size_t inMemoryCount = 0;
+  for (Entry& entry : _entries) {
+    if (entry.weights) ++inMemoryCount;
+  }
+  std::list<Entry>::iterator entry = _entries.end();
+  while (inMemoryCount > _maxCachedEntries) {
+    --entry;
+    if (entry->weights) {
+      if (!_spillPrefix.empty() && entry->spillFilename.empty()) {
+        const std::string filename =
+            _spillPrefix + "-" + std::to_string(entry->outChannelIndex) + "-" +
+            std::to_string(entry->outIntervalIndex) + ".tmp";
+        storeWeights(*entry->weights, filename);
+        entry->spillFilename = filename;
+      }
+      entry->weights.reset();
+      --inMemoryCount;
+      // Entries that are neither in memory nor on disk are removed
+      if (entry->spillFilename.empty()) entry = _entries.erase(entry);
+    }
+  }
+}
+
+std::shared_ptr<ImageWeights> ImageWeightCache::loadWeights(
+    const std::string& filename) const {
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file)
+    throw std::runtime_error("Could not open weight cache file " + filename);
+  aocommon::UVector<unsigned char> buffer(file.tellg());
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+  if (!file.good())
+    throw std::runtime_error("Error reading weight cache file " + filename);
+  aocommon::SerialIStream stream(std::move(buffer));
+  std::shared_ptr<ImageWeights> weights = std::make_shared<ImageWeights>();
+  weights->Unserialize(stream);
+  weights->SetThreadCount(_threadCount);
+  return weights;
+}
+
+void ImageWeightCache::storeWeights(const ImageWeights& weights,
+                                    const std::string& filename) const {
+  aocommon::Logger::Debug << "Writing weights to " << filename << '\n';
+  aocommon::SerialOStream stream;
+  weights.Serialize(stream);
+  std::ofstream file(filename, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(stream.data()), stream.size());
+  if (!file.good())
+    throw std::runtime_error("Error writing weight cache file " + filename);
+}
@@ -8,8 +8,11 @@
 
 #include <aocommon/logger.h>
 
-#include <limits>
+#include <algorithm>
+#include <condition_variable>
+#include <list>
 #include <mutex>
+#include <string>
 
 class ImageWeightCache {
  public:
@@ -34,8 +37,13 @@ class ImageWeightCache {
         _edgeTukeyTaperInLambda(0),
         _weightsAsTaper(weightsAsTaper),
         _threadCount(threadCount),
-        _currentWeightChannel(std::numeric_limits<size_t>::max()),
-        _currentWeightInterval(std::numeric_limits<size_t>::max()) {}
+        _griddingMemoryLimit(0),
+        _maxCachedEntries(1) {}
+
+  ~ImageWeightCache();
+
+  ImageWeightCache(const ImageWeightCache&) = delete;
+  ImageWeightCache& operator=(const ImageWeightCache&) = delete;
 
   void SetTaperInfo(double gaussianTaperBeamSize, double tukeyTaperInLambda,
                     double tukeyInnerTaperInLambda, double edgeTaperInLambda,
@@ -49,27 +57,51 @@ class ImageWeightCache {
 
   void SetThreadCount(size_t threadCount) { _threadCount = threadCount; }
 
+  /**
+   * Sets the memory in bytes that each weight may use for its thread-private
+   * grids while gridding. Zero means no limit, which is the default.
+   */
+  void SetGriddingMemoryLimit(size_t griddingMemoryLimit) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _griddingMemoryLimit = griddingMemoryLimit;
+  }
+
+  /**
+   * Sets the maximum number of weights that are kept in memory. When more
+   * weights are requested, the least recently used ones are dropped, or
+   * written to disk when SetSpillPrefix() was called. Default: 1.
+   */
+  void SetMaxCachedEntries(size_t maxCachedEntries) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _maxCachedEntries = std::max<size_t>(maxCachedEntries, 1);
+    evict();
+  }
+
+  /**
+   * Enables writing weights that are dropped from memory to files that start
+   * with @p prefix. These files are read back instead of recalculating the
+   * weights, and are removed when the cache is destructed.
+   */
+  void SetSpillPrefix(const std::string& prefix) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _spillPrefix = prefix;
+  }
+
+  /**
+   * Returns the weights for the given output channel and interval. They are
+   * taken from the cache when possible, and calculated otherwise. Multiple
+   * threads may call this function at the same time; if one thread is
+   * calculating the requested weights, the others wait for the result.
+   */
   std::shared_ptr<ImageWeights> Get(
       const std::vector<std::unique_ptr<MSDataDescription>>& msList,
-      size_t outChannelIndex, size_t outIntervalIndex) {
-    std::unique_lock<std::mutex> lock(_mutex);
-    if (outChannelIndex != _currentWeightChannel ||
-        outIntervalIndex != _currentWeightInterval) {
-      lock.unlock();
-      std::unique_ptr<ImageWeights> weights = recalculateWeights(msList);
-      lock.lock();
-      _currentWeightChannel = outChannelIndex;
-      _currentWeightInterval = outIntervalIndex;
-      _cachedWeights = std::move(weights);
-    }
-    return _cachedWeights;
-  }
+      size_t outChannelIndex, size_t outIntervalIndex);
 
   std::unique_ptr<ImageWeights> MakeEmptyWeights() const {
     std::unique_ptr<ImageWeights> weights(new ImageWeights(
         _weightMode, _imageWidth, _imageHeight, _pixelScaleX, _pixelScaleY,
-        _weightsAsTaper, _weightMode.SuperWeight()));
-    weights->SetThreadCount(_threadCount);
+        _weightsAsTaper, _weightMode.SuperWeight(), _threadCount));
+    weights->SetPrivateGridMemoryLimit(_griddingMemoryLimit);
     return weights;
   };
 
@@ -79,17 +111,39 @@ class ImageWeightCache {
     initializeWeightTapers(*weights);
     std::unique_lock<std::mutex> lock(_mutex);
     _cachedWeights = std::move(weights);
-    _currentWeightChannel = std::numeric_limits<size_t>::max();
-    _currentWeightInterval = std::numeric_limits<size_t>::max();
   }
 
  private:
+  struct Entry {
+    size_t outChannelIndex;
+    size_t outIntervalIndex;
+    /** Null while the weights are being calculated or when spilled. */
+    std::shared_ptr<ImageWeights> weights;
+    /** Non-empty once the weights have been written to disk. */
+    std::string spillFilename;
+    bool isPending = false;
+  };
+
+  std::list<Entry>::iterator findEntry(size_t outChannelIndex,
+                                       size_t outIntervalIndex);
+
+  /**
+   * Drops the least recently used weights from memory until at most
+   * _maxCachedEntries are left. Should be called with _mutex locked.
+   */
+  void evict();
+
+  std::shared_ptr<ImageWeights> loadWeights(const std::string& filename) const;
+  void storeWeights(const ImageWeights& weights,
+                    const std::string& filename) const;
+
   std::unique_ptr<ImageWeights> recalculateWeights(
       const std::vector<std::unique_ptr<MSDataDescription>>& msList) {
     aocommon::Logger::Info << "Precalculating weights for "
                            << _weightMode.ToString() << " weighting...\n";
     std::unique_ptr<ImageWeights> weights = MakeEmptyWeights();
-    for (size_t i = 0; i != msList.size(); ++i) {
+    std::mutex logMutex;
+    weights->GridInParallel(msList.size(), [&](size_t i, size_t threadCount) {
       std::unique_ptr<MSProvider> provider = msList[i]->GetProvider();
       const MSSelection& selection = msList[i]->Selection();
       const aocommon::BandData selectedBand =
@@ -98,10 +152,12 @@ class ImageWeightCache {
                                    selection.ChannelRangeStart(),
                                    selection.ChannelRangeEnd())
               : provider->Band();
-      weights->Grid(*provider, selectedBand);
-      if (msList.size() > 1)
+      weights->Grid(*provider, selectedBand, threadCount);
+      if (msList.size() > 1) {
+        std::lock_guard<std::mutex> lock(logMutex);
         (aocommon::Logger::Info << provider->MS().Filename() << ' ').Flush();
-    }
+      }
+    });
     weights->FinishGridding();
     initializeWeightTapers(*weights);
     return weights;
@@ -130,7 +186,10 @@ class ImageWeightCache {
       weights.SetEdgeTaper(_edgeTaperInLambda);
   }
 
+  /** Weights used for MF weighting, which are independent of the channel. */
   std::shared_ptr<ImageWeights> _cachedWeights;
+  /** Cached weights per channel, the most recently used first. */
+  std::list<Entry> _entries;
   const WeightMode _weightMode;
   size_t _imageWidth, _imageHeight;
   double _pixelScaleX, _pixelScaleY;
@@ -143,9 +202,11 @@ class ImageWeightCache {
   double _edgeTukeyTaperInLambda;
   bool _weightsAsTaper;
   std::mutex _mutex;
+  std::condition_variable _entryCondition;
   size_t _threadCount;
-
-  size_t _currentWeightChannel, _currentWeightInterval;
+  size_t _griddingMemoryLimit;
+  size_t _maxCachedEntries;
+  std::string _spillPrefix;
 };
 
 #endif
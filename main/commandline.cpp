@@ -56,6 +56,11 @@ void CommandLine::printHelp() {
          "-abs-mem <memory limit>\n"
          "   Like -mem, but this specifies a fixed amount of memory in "
          "gigabytes.\n"
+         "-image-cache-mem <memory limit>\n"
+         "   Keep the temporary psf, model and residual images in memory "
+         "instead of writing them\n"
+         "   to disk, as long as they fit in the given amount of memory in "
+         "gigabytes. Default: 0.\n"
          "-verbose (or -v)\n"
          "   Increase verbosity of output.\n"
          "-log-time\n"
@@ -69,6 +74,25 @@ void CommandLine::printHelp() {
          "   be iterated several times, such as with many major iterations or "
          "in channel imaging mode.\n"
          "   Default: only reorder when in channel imaging mode.\n"
+         "-compress-reordering\n"
+         "   Store the reordered visibilities and weights as bfloat16 values, "
+         "which halves the size\n"
+         "   of the reordered files at the cost of a relative precision of "
+         "about 0.4%.\n"
+         "-reorder-cache\n"
+         "   Keep the reordered files after imaging and reuse them in a later "
+         "run on the same,\n"
+         "   unchanged measurement set with the same selection, channel ranges "
+         "and polarizations.\n"
+         "   The files are stored in a subdirectory of the temporary "
+         "directory.\n"
+         "-metadata-cache\n"
+         "   Store the w-range and maximum baseline of the measurement sets in "
+         "the temporary\n"
+         "   directory, and reuse these in a later run with the same "
+         "measurement sets, selection,\n"
+         "   image size and weighting. This skips the initial pass over the "
+         "data.\n"
          "-temp-dir <directory>\n"
          "   Set the temporary directory used when reordering files. Default: "
          "same directory as input measurement set.\n"
@@ -183,6 +207,15 @@ void CommandLine::printHelp() {
          "set to level*localmean.\n"
          "-weighting-rank-filter-size <size>\n"
          "   Set size of weighting rank filter. Default: 16.\n"
+         "-weight-cache-size <count>\n"
+         "   Number of output channels for which the imaging weights are kept "
+         "in memory. At least\n"
+         "   the number of -parallel-gridding channels are kept. Default: 1.\n"
+         "-weight-cache-spill\n"
+         "   Write imaging weights that no longer fit in the weight cache to "
+         "the temporary\n"
+         "   directory, instead of recalculating them when they are needed "
+         "again.\n"
          "-taper-gaussian <beamsize>\n"
          "   Taper the weights with a Gaussian function. This will reduce the "
          "contribution of long baselines.\n"
@@ -287,6 +320,13 @@ void CommandLine::printHelp() {
          "   This speeds up inversion considerably, but makes aliasing "
          "slightly worse. This effect is\n"
          "   in most cases <1%. Default: on.\n"
+         "-spill-w-passes\n"
+         "   When the w-layers do not fit in memory and w-stacking requires "
+         "multiple passes,\n"
+         "   read the measurement set only once and store the visibilities of "
+         "later passes\n"
+         "   in the temporary directory, instead of re-reading the measurement "
+         "set in every pass.\n"
          "-grid-mode <\"nn\", \"kb\" or \"rect\">\n"
          "   Kernel and mode used for gridding: kb = Kaiser-Bessel (default "
          "with 7 pixels), nn = nearest\n"
@@ -338,6 +378,28 @@ void CommandLine::printHelp() {
          "-wgridder-accuracy <value>\n"
          "   Set the w-gridding accuracy. Default: 1e-4\n"
          "   Useful range: 1e-2 to 1e-6\n"
+         "-wgridder-sort-by-w\n"
+         "   When the data does not fit in memory at once, grid it in chunks "
+         "that each cover a\n"
+         "   limited range of w. Every w-plane is then Fourier transformed for "
+         "only a few chunks,\n"
+         "   at the cost of reading the data once per chunk. Requires "
+         "-use-wgridder.\n"
+         "-fused-residual-gridding\n"
+         "   In the major iterations, predict the model and grid the residual "
+         "in one pass over\n"
+         "   the data, without writing the model visibilities to disk. "
+         "Requires -use-wgridder.\n"
+         "   Not used with facets or with XY/YX polarizations, and the model "
+         "data column is\n"
+         "   still updated in the last major iteration when required.\n"
+         "-single-pass-facet-gridding\n"
+         "   Image all facets of a channel and polarization in one pass over "
+         "the data, instead\n"
+         "   of reading the data once per facet. This requires memory for "
+         "all facet grids at\n"
+         "   the same time. Requires -use-wgridder and -facet-regions, and "
+         "is not used with MPI.\n"
          "\n"
          "  ** A-TERM GRIDDING **\n"
          "-aterm-config <filename>\n"
@@ -814,6 +876,8 @@ bool CommandLine::ParseWithoutValidation(WSClean& wsclean, int argc,
       ++argi;
       settings.nWLayersFactor =
           parse_double(argv[argi], 0.0, "nwlayers-factor", false);
+    } else if (param == "spill-w-passes") {
+      settings.spillWPasses = true;
     } else if (param == "nwlayers-for-size") {
       settings.widthForNWCalculation =
           parse_size_t(argv[argi + 1], "nwlayers-for-size");
@@ -1147,6 +1211,11 @@ bool CommandLine::ParseWithoutValidation(WSClean& wsclean, int argc,
       ++argi;
       settings.rankFilterSize =
           parse_size_t(argv[argi], "weighting-rank-filter-size");
+    } else if (param == "weight-cache-size") {
+      ++argi;
+      settings.weightCacheSize = parse_size_t(argv[argi], "weight-cache-size");
+    } else if (param == "weight-cache-spill") {
+      settings.isWeightCacheSpilled = true;
     } else if (param == "save-source-list") {
       settings.saveSourceList = true;
       settings.multiscaleShapeFunction = MultiScaleTransforms::GaussianShape;
@@ -1290,6 +1359,12 @@ bool CommandLine::ParseWithoutValidation(WSClean& wsclean, int argc,
     } else if (param == "no-reorder") {
       settings.forceNoReorder = true;
       settings.forceReorder = false;
+    } else if (param == "compress-reordering") {
+      settings.compressReordering = true;
+    } else if (param == "reorder-cache") {
+      settings.reorderCache = true;
+    } else if (param == "metadata-cache") {
+      settings.persistentMetaDataCache = true;
     } else if (param == "update-model-required") {
       settings.modelUpdateRequired = true;
     } else if (param == "no-update-model-required") {
@@ -1314,6 +1389,10 @@ bool CommandLine::ParseWithoutValidation(WSClean& wsclean, int argc,
       ++argi;
       settings.absMemLimit = parse_double(argv[argi], 0.0, "abs-mem", false);
       if (param == "absmem") deprecated(isSlave, param, "abs-mem");
+    } else if (param == "image-cache-mem") {
+      ++argi;
+      settings.imageCacheMemLimit =
+          parse_double(argv[argi], 0.0, "image-cache-mem", false);
     } else if (param == "maxuvw-m") {
       ++argi;
       settings.maxUVWInMeters =
@@ -1430,6 +1509,12 @@ bool CommandLine::ParseWithoutValidation(WSClean& wsclean, int argc,
         throw std::runtime_error("Unknown IDG mode: " + mode);
     } else if (param == "use-wgridder") {
       settings.useWGridder = true;
+    } else if (param == "fused-residual-gridding") {
+      settings.fusedResidualGridding = true;
+    } else if (param == "single-pass-facet-gridding") {
+      settings.singlePassFacetGridding = true;
+    } else if (param == "wgridder-sort-by-w") {
+      settings.wgridderSortByW = true;
     } else if (param == "wgridder-accuracy") {
       ++argi;
       settings.wgridderAccuracy =
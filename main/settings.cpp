@@ -42,6 +42,21 @@ void Settings::Validate() const {
   if (threadCount == 0)
     throw std::runtime_error("A thread count of zero (-j 0) is not valid");
 
+  if (fusedResidualGridding && (!useWGridder || useIDG))
+    throw std::runtime_error(
+        "Fused residual gridding (-fused-residual-gridding) is only "
+        "available for the w-gridder (-use-wgridder).");
+
+  if (singlePassFacetGridding && (!useWGridder || useIDG))
+    throw std::runtime_error(
+        "Single-pass facet gridding (-single-pass-facet-gridding) is only "
+        "available for the w-gridder (-use-wgridder).");
+
+  if (wgridderSortByW && (!useWGridder || useIDG))
+    throw std::runtime_error(
+        "Sorting on w (-wgridder-sort-by-w) is only available for the "
+        "w-gridder (-use-wgridder).");
+
   // antialiasingKernelSize should be odd
   if (antialiasingKernelSize % 2 == 0) {
     std::stringstream s;
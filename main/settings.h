@@ -50,15 +50,17 @@ class Settings {
   bool fittedBeam, theoreticBeam, circularBeam;
   double beamFittingBoxSize;
   bool continuedRun;
-  double memFraction, absMemLimit;
+  double memFraction, absMemLimit, imageCacheMemLimit;
   double minUVWInMeters, maxUVWInMeters, minUVInLambda, maxUVInLambda, wLimit,
       rankFilterLevel;
-  size_t rankFilterSize;
+  size_t rankFilterSize, weightCacheSize;
+  bool isWeightCacheSpilled;
   double gaussianTaperBeamSize, tukeyTaperInLambda, tukeyInnerTaperInLambda,
       edgeTaperInLambda, edgeTukeyTaperInLambda;
   bool useWeightsAsTaper;
   size_t nWLayers;
   double nWLayersFactor;
+  bool spillWPasses;
   size_t antialiasingKernelSize, overSamplingFactor, threadCount,
       parallelReordering, parallelGridding;
   bool useMPI, masterDoesWork;
@@ -81,6 +83,8 @@ class Settings {
   bool writeImagingWeightSpectrumColumn;
   std::string temporaryDirectory;
   bool forceReorder, forceNoReorder, doReorder;
+  bool compressReordering, reorderCache;
+  bool persistentMetaDataCache;
   bool subtractModel, modelUpdateRequired, mfWeighting;
   size_t fullResOffset, fullResWidth, fullResPad;
   std::string beamModel;
@@ -92,7 +96,8 @@ class Settings {
   size_t primaryBeamGridSize, primaryBeamUpdateTime;
   bool directFT;
   DirectFTPrecision directFTPrecision;
-  bool useIDG, useWGridder;
+  bool useIDG, useWGridder, fusedResidualGridding, singlePassFacetGridding,
+      wgridderSortByW;
   double wgridderAccuracy;
   std::string atermConfigFilename;
   double atermKernelSize;
@@ -222,6 +227,7 @@ inline Settings::Settings()
       continuedRun(false),
       memFraction(1.0),
       absMemLimit(0.0),
+      imageCacheMemLimit(0.0),
       minUVWInMeters(0.0),
       maxUVWInMeters(0.0),
       minUVInLambda(0.0),
@@ -229,6 +235,8 @@ inline Settings::Settings()
       wLimit(0.0),
       rankFilterLevel(3.0),
       rankFilterSize(16),
+      weightCacheSize(1),
+      isWeightCacheSpilled(false),
       gaussianTaperBeamSize(0.0),
       tukeyTaperInLambda(0.0),
       tukeyInnerTaperInLambda(0.0),
@@ -237,6 +245,7 @@ inline Settings::Settings()
       useWeightsAsTaper(false),
       nWLayers(0),
       nWLayersFactor(1.0),
+      spillWPasses(false),
       antialiasingKernelSize(7),
       overSamplingFactor(1023),
       threadCount(aocommon::system::ProcessorCount()),
@@ -273,6 +282,9 @@ inline Settings::Settings()
       forceReorder(false),
       forceNoReorder(false),
       doReorder(true),
+      compressReordering(false),
+      reorderCache(false),
+      persistentMetaDataCache(false),
       subtractModel(false),
       modelUpdateRequired(true),
       mfWeighting(false),
@@ -292,6 +304,9 @@ inline Settings::Settings()
       directFTPrecision(DirectFTPrecision::Double),
       useIDG(false),
       useWGridder(false),
+      fusedResidualGridding(false),
+      singlePassFacetGridding(false),
+      wgridderSortByW(false),
       wgridderAccuracy(1e-4),
       atermConfigFilename(),
       atermKernelSize(5.0),
@@ -15,6 +15,7 @@
 #include "../scheduling/griddingtaskmanager.h"
 
 #include "../system/application.h"
+#include "../system/cachekey.h"
 
 #include "../structures/imageweights.h"
 #include "../structures/msselection.h"
@@ -37,7 +38,9 @@
 #include <aocommon/image.h>
 #include <aocommon/logger.h>
 #include <aocommon/uvector.h>
+#include <aocommon/io/serialostream.h>
 #include <aocommon/parallelfor.h>
+#include <aocommon/system.h>
 #include <aocommon/units/angle.h>
 
 #include <schaapcommon/facets/facetimage.h>
@@ -45,8 +48,13 @@
 #include <schaapcommon/fft/restoreimage.h>
 #include <schaapcommon/fitters/nlplfitter.h>
 
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 
 using aocommon::Image;
 using aocommon::Logger;
@@ -165,7 +173,7 @@ void WSClean::imagePSF(ImagingTableEntry& entry) {
   task.polarization = entry.polarization;
   task.subtractModel = false;
   task.verbose = _isFirstInversion;
-  task.cache = std::move(_msGridderMetaCache[entry.index]);
+  task.cache = acquireMetaDataCache(entry);
   task.storeImagingWeights = _settings.writeImagingWeightSpectrumColumn;
   task.observationInfo = _observationInfo;
   task.facet = entry.facet;
@@ -202,7 +210,7 @@ void WSClean::imagePSFCallback(ImagingTableEntry& entry, GriddingResult& result,
   if (_facets.empty()) processFullPSF(result.images[0], entry);
 
   _lastStartTime = result.startTime;
-  _msGridderMetaCache[entry.index] = std::move(result.cache);
+  storeMetaDataCache(entry, std::move(result.cache));
 
   _psfImages.SetFitsWriter(
       createWSCFitsWriter(entry, false, false, false).Writer());
@@ -275,11 +283,8 @@ void WSClean::processFullPSF(Image& image, const ImagingTableEntry& entry) {
   Logger::Info << "DONE\n";
 }
 
-void WSClean::imageMain(ImagingTableEntry& entry, bool isFirstInversion,
-                        bool updateBeamInfo) {
-  Logger::Info.Flush();
-  Logger::Info << " == Constructing image ==\n";
-
+GriddingTask WSClean::makeImageMainTask(const ImagingTableEntry& entry,
+                                        bool isFirstInversion) {
   GriddingTask task;
   task.operation = GriddingTask::Invert;
   task.imagePSF = false;
@@ -290,7 +295,7 @@ void WSClean::imageMain(ImagingTableEntry& entry, bool isFirstInversion,
   task.subtractModel =
       !isFirstInversion || _settings.subtractModel || _settings.continuedRun;
   task.verbose = isFirstInversion && _isFirstInversion;
-  task.cache = std::move(_msGridderMetaCache[entry.index]);
+  task.cache = acquireMetaDataCache(entry);
   task.storeImagingWeights =
       isFirstInversion && _settings.writeImagingWeightSpectrumColumn;
   initializeMSList(entry, task.msList);
@@ -303,20 +308,85 @@ void WSClean::imageMain(ImagingTableEntry& entry, bool isFirstInversion,
                                        entry.outputChannelIndex);
 
   applyFacetPhaseShift(entry, task.observationInfo);
+  return task;
+}
+
+void WSClean::imageMain(ImagingTableEntry& entry, bool isFirstInversion,
+                        bool updateBeamInfo) {
+  Logger::Info.Flush();
+  Logger::Info << " == Constructing image ==\n";
 
   _griddingTaskManager->Run(
-      std::move(task),
+      makeImageMainTask(entry, isFirstInversion),
       [this, &entry, updateBeamInfo, isFirstInversion](GriddingResult& result) {
         imageMainCallback(entry, result, updateBeamInfo, isFirstInversion);
       });
 }
 
+void WSClean::imageMainWithPSF(ImagingTableEntry& entry) {
+  Logger::Info.Flush();
+  Logger::Info << " == Constructing PSF and image ==\n";
+
+  GriddingTask task = makeImageMainTask(entry, true);
+  task.operation = GriddingTask::InvertWithPSF;
+  task.storeImagingWeights = false;
+
+  _griddingTaskManager->Run(
+      std::move(task), [this, &entry](GriddingResult& result) {
+        // The PSF is processed first, because it determines the
+        // normalization of the image.
+        std::vector<Image> images = std::move(result.images);
+        result.images = std::move(result.psfImages);
+        imagePSFCallback(entry, result, true);
+        // imagePSFCallback() has stored the meta data cache; hand it back to
+        // the result so that imageMainCallback() stores it again.
+        result.cache = acquireMetaDataCache(entry);
+        result.images = std::move(images);
+        imageMainCallback(entry, result, false, true);
+      });
+}
+
+bool WSClean::canGridPSFWithDirty() const {
+  const bool doMakePSF = _settings.deconvolutionIterationCount > 0 ||
+                         _settings.makePSF || _settings.makePSFOnly;
+  const bool hasComplexPolarizations =
+      _settings.polarizations.count(Polarization::XY) != 0 ||
+      _settings.polarizations.count(Polarization::YX) != 0;
+  return doMakePSF && !_settings.makePSFOnly && !_settings.reusePsf &&
+         !_settings.reuseDirty && _settings.useWGridder && !_settings.useIDG &&
+         _facets.empty() && !hasComplexPolarizations &&
+         !_settings.writeImagingWeightSpectrumColumn;
+}
+
+void WSClean::imageFacetGroup(const ImagingTable::Group& facetGroup,
+                              bool isFirstInversion, bool updateBeamInfo) {
+  Logger::Info.Flush();
+  Logger::Info << " == Constructing images of " << facetGroup.size()
+               << " facets ==\n";
+
+  std::vector<GriddingTask> tasks;
+  tasks.reserve(facetGroup.size());
+  for (const ImagingTable::EntryPtr& entry : facetGroup)
+    tasks.emplace_back(makeImageMainTask(*entry, isFirstInversion));
+
+  _griddingTaskManager->RunFacetGroup(
+      std::move(tasks), [&](size_t index, GriddingResult& result) {
+        imageMainCallback(*facetGroup[index], result, updateBeamInfo,
+                          isFirstInversion);
+      });
+}
+
+bool WSClean::canGridFacetGroups() const {
+  return _settings.singlePassFacetGridding && !_facets.empty() &&
+         !_settings.useMPI;
+}
+
 void WSClean::imageMainCallback(ImagingTableEntry& entry,
                                 GriddingResult& result, bool updateBeamInfo,
                                 bool isInitialInversion) {
   size_t joinedChannelIndex = entry.outputChannelIndex;
 
-  _msGridderMetaCache[entry.index] = std::move(result.cache);
+  storeMetaDataCache(entry, std::move(result.cache));
   entry.imageWeight = result.imageWeight;
   entry.normalizationFactor = result.normalizationFactor;
   _infoPerChannel[entry.outputChannelIndex].weight = result.imageWeight;
@@ -491,7 +561,7 @@ void WSClean::predict(const ImagingTableEntry& entry) {
   task.operation = GriddingTask::Predict;
   task.polarization =
       isFullStokes ? Polarization::FullStokes : entry.polarization;
-  task.cache = std::move(_msGridderMetaCache[entry.index]);
+  task.cache = acquireMetaDataCache(entry);
   task.verbose = false;
   task.storeImagingWeights = false;
   task.modelImages = std::move(modelImages);
@@ -506,10 +576,38 @@ void WSClean::predict(const ImagingTableEntry& entry) {
   applyFacetPhaseShift(entry, task.observationInfo);
   _griddingTaskManager->Run(
       std::move(task), [this, &entry](GriddingResult& result) {
-        _msGridderMetaCache[entry.index] = std::move(result.cache);
+        storeMetaDataCache(entry, std::move(result.cache));
       });
 }
 
+void WSClean::imageResidual(ImagingTableEntry& entry) {
+  Logger::Info.Flush();
+  Logger::Info << " == Predicting model and constructing residual image ==\n";
+
+  GriddingTask task = makeImageMainTask(entry, false);
+  task.operation = GriddingTask::PredictAndInvert;
+  task.subtractModel = true;
+  task.modelImages.emplace_back(_settings.trimmedImageWidth,
+                                _settings.trimmedImageHeight);
+  _modelImages.LoadFacet(task.modelImages.back().Data(), entry.polarization,
+                         entry.outputChannelIndex, entry.facetIndex,
+                         entry.facet, false);
+
+  _griddingTaskManager->Run(
+      std::move(task), [this, &entry](GriddingResult& result) {
+        imageMainCallback(entry, result, false, false);
+      });
+}
+
+bool WSClean::canFuseResidualGridding(bool isFinished) const {
+  const bool hasComplexPolarizations =
+      _settings.polarizations.count(Polarization::XY) != 0 ||
+      _settings.polarizations.count(Polarization::YX) != 0;
+  return _settings.fusedResidualGridding && _facets.empty() &&
+         !hasComplexPolarizations &&
+         (!isFinished || !_settings.modelUpdateRequired);
+}
+
 ObservationInfo WSClean::getObservationInfo() const {
   casacore::MeasurementSet ms(_settings.filenames[0]);
   ObservationInfo observationInfo =
@@ -556,6 +654,10 @@ void WSClean::initializeMFSImageWeights() {
   Logger::Info << "Precalculating MF weights for "
                << _settings.weightMode.ToString() << " weighting...\n";
   std::unique_ptr<ImageWeights> weights = _imageWeightCache->MakeEmptyWeights();
+  // Each job grids one data description of one measurement set. The jobs are
+  // run in parallel and receive the number of threads they may use.
+  std::vector<std::function<void(size_t)>> gridJobs;
+  std::mutex logMutex;
   if (_settings.doReorder) {
     for (const ImagingTable::Group& sqGroup : _imagingTable.SquaredGroups()) {
       const ImagingTableEntry& entry = *sqGroup.front();
@@ -570,16 +672,19 @@ void WSClean::initializeMFSImageWeights() {
           if (hasSelection) {
             const PolarizationEnum pol =
                 _settings.useIDG ? getIdgPolarization() : entry.polarization;
-            PartitionedMS msProvider(_partitionedMSHandles[msIndex],
-                                     ms.bands[dataDescId].partIndex, pol,
-                                     dataDescId);
+            const size_t partIndex = ms.bands[dataDescId].partIndex;
             aocommon::BandData selectedBand(_msBands[msIndex][dataDescId]);
             if (partSelection.HasChannelRange()) {
               selectedBand = aocommon::BandData(
                   selectedBand, partSelection.ChannelRangeStart(),
                   partSelection.ChannelRangeEnd());
             }
-            weights->Grid(msProvider, selectedBand);
+            gridJobs.emplace_back([&, msIndex, partIndex, pol, dataDescId,
+                                   selectedBand](size_t threadCount) {
+              PartitionedMS msProvider(_partitionedMSHandles[msIndex],
+                                       partIndex, pol, dataDescId);
+              weights->Grid(msProvider, selectedBand, threadCount);
+            });
           }
         }
       }
@@ -590,20 +695,27 @@ void WSClean::initializeMFSImageWeights() {
         const PolarizationEnum pol = _settings.useIDG
                                          ? getIdgPolarization()
                                          : *_settings.polarizations.begin();
-        ContiguousMS msProvider(_settings.filenames[i],
-                                _settings.dataColumnName, _globalSelection, pol,
-                                d, _settings.useMPI);
         aocommon::BandData selectedBand = _msBands[i][d];
         if (_globalSelection.HasChannelRange())
           selectedBand = aocommon::BandData(
               selectedBand, _globalSelection.ChannelRangeStart(),
               _globalSelection.ChannelRangeEnd());
-        weights->Grid(msProvider, selectedBand);
-        Logger::Info << '.';
-        Logger::Info.Flush();
+        gridJobs.emplace_back([&, i, d, pol, selectedBand](size_t threadCount) {
+          ContiguousMS msProvider(_settings.filenames[i],
+                                  _settings.dataColumnName, _globalSelection,
+                                  pol, d, _settings.useMPI);
+          weights->Grid(msProvider, selectedBand, threadCount);
+          std::lock_guard<std::mutex> lock(logMutex);
+          Logger::Info << '.';
+          Logger::Info.Flush();
+        });
       }
     }
   }
+  weights->GridInParallel(gridJobs.size(),
+                          [&](size_t jobIndex, size_t threadCount) {
+                            gridJobs[jobIndex](threadCount);
+                          });
   weights->FinishGridding();
   _imageWeightCache->SetMFWeights(std::move(weights));
   if (_settings.isWeightImageSaved)
@@ -611,7 +723,9 @@ void WSClean::initializeMFSImageWeights() {
                                             "-weights.fits");
 }
 
-void WSClean::performReordering(bool isPredictMode) {
+void WSClean::performReordering(bool isPredictMode,
+                                const MSSelection& fullSelection,
+                                size_t intervalIndex) {
   std::mutex mutex;
 
   // If there are reordered measurement sets on disk, we have to clean them
@@ -623,7 +737,27 @@ void WSClean::performReordering(bool isPredictMode) {
                   _settings.subtractModel || _settings.continuedRun;
   bool initialModelRequired = _settings.subtractModel || _settings.continuedRun;
 
-  if (_settings.parallelReordering != 1) Logger::Info << "Reordering...\n";
+  // All intervals are reordered in one pass over each measurement set, while
+  // processing the first interval. Baseline-dependent averaging can average
+  // over interval boundaries, and therefore reorders each interval separately.
+  const bool reorderAllIntervals =
+      _settings.baselineDependentAveragingInWavelengths == 0.0;
+  const bool isReorderingRequired = !reorderAllIntervals || intervalIndex == 0;
+  std::vector<MSSelection> intervalSelections;
+  if (isReorderingRequired) {
+    if (reorderAllIntervals) {
+      // The caller has already called selectInterval() on fullSelection,
+      // which stored its interval, so the copy is not rescanned.
+      MSSelection selection(fullSelection);
+      for (size_t i = 0; i != _settings.intervalsOut; ++i)
+        intervalSelections.emplace_back(selectInterval(selection, i));
+    } else {
+      intervalSelections.emplace_back(_globalSelection);
+    }
+    _reorderedHandles.clear();
+    _reorderedHandles.resize(_settings.filenames.size());
+    if (_settings.parallelReordering != 1) Logger::Info << "Reordering...\n";
+  }
 
   aocommon::ParallelFor<size_t> loop(_settings.parallelReordering);
   loop.Run(0, _settings.filenames.size(), [&](size_t msIndex, size_t) {
@@ -658,19 +792,34 @@ void WSClean::performReordering(bool isPredictMode) {
       }
     }
 
-    PartitionedMS::Handle partMS = PartitionedMS::Partition(
-        _settings.filenames[msIndex], channels, _globalSelection,
-        _settings.dataColumnName, useModel, initialModelRequired, _settings);
-    std::lock_guard<std::mutex> lock(mutex);
-    _partitionedMSHandles[msIndex] = std::move(partMS);
-    if (_settings.parallelReordering != 1)
-      Logger::Info << "Finished reordering " << _settings.filenames[msIndex]
-                   << " [" << msIndex << "]\n";
+    if (isReorderingRequired) {
+      std::vector<PartitionedMS::Handle> handles = PartitionedMS::Partition(
+          _settings.filenames[msIndex], channels, intervalSelections,
+          _settings.dataColumnName, useModel, initialModelRequired, _settings);
+      std::lock_guard<std::mutex> lock(mutex);
+      _reorderedHandles[msIndex] = std::move(handles);
+      if (_settings.parallelReordering != 1)
+        Logger::Info << "Finished reordering " << _settings.filenames[msIndex]
+                     << " [" << msIndex << "]\n";
+    }
   });
+
+  const size_t handleIndex = reorderAllIntervals ? intervalIndex : 0;
+  for (size_t msIndex = 0; msIndex != _settings.filenames.size(); ++msIndex) {
+    _partitionedMSHandles[msIndex] =
+        std::move(_reorderedHandles[msIndex][handleIndex]);
+  }
 }
 
 void WSClean::RunClean() {
   _deconvolution.emplace(_settings.GetDeconvolutionSettings());
+  if (_settings.imageCacheMemLimit > 0.0) {
+    auto budget = std::make_shared<CachedImageSet::MemoryBudget>(
+        _settings.imageCacheMemLimit * 1024.0 * 1024.0 * 1024.0);
+    _psfImages.SetMemoryBudget(budget);
+    _modelImages.SetMemoryBudget(budget);
+    _residualImages.SetMemoryBudget(budget);
+  }
   _observationInfo = getObservationInfo();
   _facets = FacetReader::ReadFacets(_settings.facetRegionFilename);
 
@@ -715,7 +864,8 @@ void WSClean::RunClean() {
 
     _globalSelection = selectInterval(fullSelection, intervalIndex);
 
-    if (_settings.doReorder) performReordering(false);
+    if (_settings.doReorder)
+      performReordering(false, fullSelection, intervalIndex);
 
     _infoPerChannel.assign(_settings.channelsOut, OutputChannelInfo());
 
@@ -842,6 +992,7 @@ void WSClean::RunClean() {
 
     // This will erase the temporary files
     _partitionedMSHandles.clear();
+    refreshMetaDataCacheFiles();
   }
 }
 
@@ -856,6 +1007,25 @@ std::unique_ptr<ImageWeightCache> WSClean::createWeightCache() {
       _settings.gaussianTaperBeamSize, _settings.tukeyTaperInLambda,
       _settings.tukeyInnerTaperInLambda, _settings.edgeTaperInLambda,
       _settings.edgeTukeyTaperInLambda);
+  // Channels that are gridded in parallel each need their weights
+  cache->SetMaxCachedEntries(
+      std::max(_settings.weightCacheSize, _settings.parallelGridding));
+  // Gridding the weights uses a private grid per thread. Those of all
+  // channels gridded in parallel may together use half of the memory budget.
+  double memory =
+      double(aocommon::system::TotalMemory()) * _settings.memFraction;
+  if (_settings.absMemLimit != 0.0)
+    memory = std::min(memory,
+                      _settings.absMemLimit * (1024.0 * 1024.0 * 1024.0));
+  cache->SetGriddingMemoryLimit(
+      size_t(memory * 0.5 / std::max<size_t>(_settings.parallelGridding, 1)));
+  if (_settings.isWeightCacheSpilled) {
+    boost::filesystem::path prefix(_settings.prefixName + "-weights-cache");
+    if (!_settings.temporaryDirectory.empty())
+      prefix = boost::filesystem::path(_settings.temporaryDirectory) /
+               prefix.filename();
+    cache->SetSpillPrefix(prefix.string());
+  }
   return cache;
 }
 
@@ -880,7 +1050,8 @@ void WSClean::RunPredict() {
 
     _globalSelection = selectInterval(fullSelection, intervalIndex);
 
-    if (_settings.doReorder) performReordering(true);
+    if (_settings.doReorder)
+      performReordering(true, fullSelection, intervalIndex);
     _griddingTaskManager = GriddingTaskManager::Make(_settings);
 
     if (!_facets.empty()) {
@@ -920,6 +1091,10 @@ void WSClean::RunPredict() {
     predictGroup(_imagingTable);
 
     _griddingTaskManager.reset();
+
+    // This writes the predicted model data and erases the temporary files
+    _partitionedMSHandles.clear();
+    refreshMetaDataCacheFiles();
   }
 }
 
@@ -971,10 +1146,12 @@ void WSClean::runIndependentGroup(ImagingTable& groupTable,
   _inversionWatch.Start();
   const bool doMakePSF = _settings.deconvolutionIterationCount > 0 ||
                          _settings.makePSF || _settings.makePSFOnly;
+  // When possible, the PSF is made along with the first inversion instead.
+  const bool doMakeSeparatePSF = doMakePSF && !canGridPSFWithDirty();
   for (ImagingTableEntry& entry : groupTable) {
     const bool isFirstPol =
         entry.polarization == *_settings.polarizations.begin();
-    if (doMakePSF && isFirstPol) {
+    if (doMakeSeparatePSF && isFirstPol) {
       if (_settings.reusePsf)
         loadExistingPSF(entry);
       else
@@ -1420,6 +1597,117 @@ void WSClean::initializeMSList(
   }
 }
 
+std::unique_ptr<MetaDataCache> WSClean::acquireMetaDataCache(
+    const ImagingTableEntry& entry) {
+  std::unique_ptr<MetaDataCache>& cache = _msGridderMetaCache[entry.index];
+  if (!cache && _settings.persistentMetaDataCache) {
+    const std::string identity = metaDataCacheIdentity(entry);
+    const std::string filename = metaDataCacheFilename(identity);
+    std::unique_ptr<MetaDataCache> storedCache(new MetaDataCache());
+    if (storedCache->Load(filename, identity + initialMSFingerprints())) {
+      Logger::Debug << "Using meta data cache " << filename << '\n';
+      _metaDataCacheFiles.emplace(filename, identity);
+      return storedCache;
+    }
+  }
+  return std::move(cache);
+}
+
+void WSClean::storeMetaDataCache(const ImagingTableEntry& entry,
+                                 std::unique_ptr<MetaDataCache> cache) {
+  if (_settings.persistentMetaDataCache && cache &&
+      !cache->msDataVector.empty()) {
+    const std::string identity = metaDataCacheIdentity(entry);
+    const std::string filename = metaDataCacheFilename(identity);
+    if (_metaDataCacheFiles.count(filename) == 0) {
+      cache->Save(filename, identity + initialMSFingerprints());
+      _metaDataCacheFiles.emplace(filename, identity);
+    }
+  }
+  _msGridderMetaCache[entry.index] = std::move(cache);
+}
+
+std::string WSClean::metaDataCacheIdentity(
+    const ImagingTableEntry& entry) const {
+  aocommon::SerialOStream stream;
+  stream.String(_settings.dataColumnName)
+      .UInt32(entry.polarization)
+      .Bool(_settings.useIDG)
+      .Double(_settings.baselineDependentAveragingInWavelengths)
+      .UInt64(_settings.filenames.size());
+  for (size_t msIndex = 0; msIndex != _settings.filenames.size(); ++msIndex) {
+    stream.String(
+        boost::filesystem::canonical(_settings.filenames[msIndex]).string());
+    for (size_t dataDescId = 0; dataDescId != _msBands[msIndex].DataDescCount();
+         ++dataDescId) {
+      MSSelection selection(_globalSelection);
+      if (selection.SelectMsChannels(_msBands[msIndex], dataDescId, entry)) {
+        stream.UInt64(dataDescId);
+        selection.Serialize(stream);
+      }
+    }
+  }
+  // The image size and weighting determine which visibilities are included
+  // in the w-limits.
+  stream.UInt64(_settings.paddedImageWidth)
+      .UInt64(_settings.paddedImageHeight)
+      .Double(_settings.pixelScaleX)
+      .Double(_settings.pixelScaleY)
+      .String(_settings.facetRegionFilename)
+      .UInt64(entry.facetIndex);
+  _settings.weightMode.Serialize(stream);
+  stream.Double(_settings.minUVInLambda)
+      .Double(_settings.maxUVInLambda)
+      .Double(_settings.gaussianTaperBeamSize)
+      .Double(_settings.tukeyTaperInLambda)
+      .Double(_settings.tukeyInnerTaperInLambda)
+      .Double(_settings.edgeTaperInLambda)
+      .Double(_settings.edgeTukeyTaperInLambda)
+      .Bool(_settings.useWeightsAsTaper);
+  return std::string(reinterpret_cast<const char*>(stream.data()),
+                     stream.size());
+}
+
+std::string WSClean::metaDataCacheFilename(const std::string& identity) const {
+  boost::filesystem::path directory;
+  if (_settings.temporaryDirectory.empty()) {
+    std::string msPath = _settings.filenames.front();
+    while (!msPath.empty() && msPath.back() == '/') msPath.pop_back();
+    directory = boost::filesystem::path(msPath).parent_path();
+  } else {
+    directory = _settings.temporaryDirectory;
+  }
+  const std::string filename = "wsclean-metadata-" +
+                               wsclean::system::HashToString(identity) +
+                               ".tmp";
+  return (directory / filename).string();
+}
+
+const std::string& WSClean::initialMSFingerprints() {
+  if (_initialMSFingerprints.empty()) {
+    for (const std::string& msPath : _settings.filenames)
+      _initialMSFingerprints += wsclean::system::MSFingerprint(msPath) + '\n';
+  }
+  return _initialMSFingerprints;
+}
+
+void WSClean::refreshMetaDataCacheFiles() {
+  if (!_metaDataCacheFiles.empty()) {
+    std::string currentFingerprints;
+    for (const std::string& msPath : _settings.filenames)
+      currentFingerprints += wsclean::system::MSFingerprint(msPath) + '\n';
+    if (currentFingerprints != _initialMSFingerprints) {
+      for (const auto& [filename, identity] : _metaDataCacheFiles) {
+        MetaDataCache cache;
+        if (cache.Load(filename, identity + _initialMSFingerprints))
+          cache.Save(filename, identity + currentFingerprints);
+      }
+    }
+    _metaDataCacheFiles.clear();
+  }
+  _initialMSFingerprints.clear();
+}
+
 void WSClean::resetModelColumns(const ImagingTable& groupTable) {
   if (groupTable.FacetCount() > 1) {
     for (const ImagingTable::Group& facetGroup : groupTable.FacetGroups()) {
@@ -1440,34 +1728,65 @@ void WSClean::runFirstInversions(ImagingTable& groupTable,
                                  std::unique_ptr<PrimaryBeam>& primaryBeam,
                                  bool requestPolarizationsAtOnce,
                                  bool parallelizePolarizations) {
-  const size_t facetCount = groupTable.FacetCount();
-  for (size_t facetIndex = 0; facetIndex < facetCount; ++facetIndex) {
-    ImagingTable facetTable = groupTable.GetFacet(facetIndex);
-
-    if (requestPolarizationsAtOnce) {
-      for (ImagingTableEntry& entry : facetTable) {
-        if (entry.polarization == *_settings.polarizations.begin())
-          runSingleFirstInversion(entry, primaryBeam);
-      }
-    } else if (parallelizePolarizations) {
-      for (ImagingTableEntry& entry : facetTable) {
-        runSingleFirstInversion(entry, primaryBeam);
-      }
-    } else {
-      bool hasMore;
-      size_t sqIndex = 0;
-      do {
-        hasMore = false;
-        // Run the inversion for one entry out of each squared group
-        for (const ImagingTable::Group& sqGroup : facetTable.SquaredGroups()) {
-          if (sqIndex < sqGroup.size()) {
-            hasMore = true;
-            runSingleFirstInversion(*sqGroup[sqIndex], primaryBeam);
+  // Facet groups can not store the imaging weights, because these are written
+  // while reading the data row by row.
+  const bool gridFacetGroups = parallelizePolarizations &&
+                               canGridFacetGroups() && !_settings.reuseDirty &&
+                               !_settings.writeImagingWeightSpectrumColumn;
+  if (gridFacetGroups) {
+    const bool doMakePSF = _settings.deconvolutionIterationCount > 0 ||
+                           _settings.makePSF || _settings.makePSFOnly;
+    for (const ImagingTable::Group& facetGroup : groupTable.FacetGroups()) {
+      for (const ImagingTable::EntryPtr& entry : facetGroup)
+        makeFirstInversionBeamImages(*entry, primaryBeam);
+      imageFacetGroup(facetGroup, true, !doMakePSF);
+      _isFirstInversion = false;
+    }
+  } else {
+    const size_t facetCount = groupTable.FacetCount();
+    for (size_t facetIndex = 0; facetIndex < facetCount; ++facetIndex) {
+      ImagingTable facetTable = groupTable.GetFacet(facetIndex);
+
+      if (requestPolarizationsAtOnce) {
+        for (ImagingTableEntry& entry : facetTable) {
+          if (entry.polarization == *_settings.polarizations.begin())
+            runSingleFirstInversion(entry, primaryBeam);
+        }
+      } else if (parallelizePolarizations) {
+        if (canGridPSFWithDirty()) {
+          // The other polarizations are normalized with the PSF, which is
+          // made along with the first polarization.
+          for (ImagingTableEntry& entry : facetTable) {
+            if (entry.polarization == *_settings.polarizations.begin())
+              runSingleFirstInversion(entry, primaryBeam);
+          }
+          _griddingTaskManager->Finish();
+          for (ImagingTableEntry& entry : facetTable) {
+            if (entry.polarization != *_settings.polarizations.begin())
+              runSingleFirstInversion(entry, primaryBeam);
+          }
+        } else {
+          for (ImagingTableEntry& entry : facetTable) {
+            runSingleFirstInversion(entry, primaryBeam);
           }
         }
-        ++sqIndex;
-        _griddingTaskManager->Finish();
-      } while (hasMore);
+      } else {
+        bool hasMore;
+        size_t sqIndex = 0;
+        do {
+          hasMore = false;
+          // Run the inversion for one entry out of each squared group
+          for (const ImagingTable::Group& sqGroup :
+               facetTable.SquaredGroups()) {
+            if (sqIndex < sqGroup.size()) {
+              hasMore = true;
+              runSingleFirstInversion(*sqGroup[sqIndex], primaryBeam);
+            }
+          }
+          ++sqIndex;
+          _griddingTaskManager->Finish();
+        } while (hasMore);
+      }
     }
   }
   if (requestPolarizationsAtOnce) {
@@ -1481,11 +1800,28 @@ void WSClean::runFirstInversions(ImagingTable& groupTable,
 
 void WSClean::runSingleFirstInversion(
     ImagingTableEntry& entry, std::unique_ptr<PrimaryBeam>& primaryBeam) {
-  const bool isLastPol =
-      entry.polarization == *_settings.polarizations.rbegin();
   const bool doMakePSF = _settings.deconvolutionIterationCount > 0 ||
                          _settings.makePSF || _settings.makePSFOnly;
 
+  makeFirstInversionBeamImages(entry, primaryBeam);
+
+  const bool isFirstPol =
+      entry.polarization == *_settings.polarizations.begin();
+  if (_settings.reuseDirty)
+    loadExistingDirty(entry, !doMakePSF);
+  else if (isFirstPol && canGridPSFWithDirty())
+    imageMainWithPSF(entry);
+  else
+    imageMain(entry, true, !doMakePSF);
+
+  _isFirstInversion = false;
+}
+
+void WSClean::makeFirstInversionBeamImages(
+    ImagingTableEntry& entry, std::unique_ptr<PrimaryBeam>& primaryBeam) {
+  const bool isLastPol =
+      entry.polarization == *_settings.polarizations.rbegin();
+
   if (isLastPol) {
     ImageFilename imageName =
         ImageFilename(entry.outputChannelIndex, entry.outputIntervalIndex);
@@ -1506,13 +1842,6 @@ void WSClean::runSingleFirstInversion(
       }
     }
   }
-
-  if (_settings.reuseDirty)
-    loadExistingDirty(entry, !doMakePSF);
-  else
-    imageMain(entry, true, !doMakePSF);
-
-  _isFirstInversion = false;
 }
 
 void WSClean::runMajorIterations(ImagingTable& groupTable,
@@ -1570,6 +1899,18 @@ void WSClean::runMajorIterations(ImagingTable& groupTable,
           }
           _griddingTaskManager->Finish();
           _inversionWatch.Pause();
+        } else if (canFuseResidualGridding(isFinished)) {
+          _inversionWatch.Start();
+          _griddingTaskManager->Start(getMaxNrMSProviders() *
+                                      (groupTable.MaxFacetGroupIndex() + 1));
+          for (const ImagingTable::Group& sqGroup :
+               groupTable.SquaredGroups()) {
+            for (const ImagingTable::EntryPtr& entry : sqGroup) {
+              imageResidual(*entry);
+            }
+          }
+          _griddingTaskManager->Finish();
+          _inversionWatch.Pause();
         } else if (parallelizePolarizations) {
           resetModelColumns(groupTable);
           _predictingWatch.Start();
@@ -1585,12 +1926,19 @@ void WSClean::runMajorIterations(ImagingTable& groupTable,
           _predictingWatch.Pause();
 
           _inversionWatch.Start();
-          for (const ImagingTable::Group& sqGroup :
-               groupTable.SquaredGroups()) {
-            for (const ImagingTable::EntryPtr& entry : sqGroup) {
-              imageMain(*entry, false, false);
-            }  // end of polarization & facets loop
-          }    // end of joined channels loop
+          if (canGridFacetGroups()) {
+            for (const ImagingTable::Group& facetGroup :
+                 groupTable.FacetGroups()) {
+              imageFacetGroup(facetGroup, false, false);
+            }
+          } else {
+            for (const ImagingTable::Group& sqGroup :
+                 groupTable.SquaredGroups()) {
+              for (const ImagingTable::EntryPtr& entry : sqGroup) {
+                imageMain(*entry, false, false);
+              }  // end of polarization & facets loop
+            }    // end of joined channels loop
+          }
           _griddingTaskManager->Finish();
           _inversionWatch.Pause();
         } else {  // only parallelize channels
@@ -73,12 +73,20 @@ class WSClean {
                           bool parallelizePolarizations);
   void runSingleFirstInversion(ImagingTableEntry& entry,
                                std::unique_ptr<PrimaryBeam>& primaryBeam);
+  void makeFirstInversionBeamImages(ImagingTableEntry& entry,
+                                    std::unique_ptr<PrimaryBeam>& primaryBeam);
   void runMajorIterations(ImagingTable& groupTable,
                           std::unique_ptr<PrimaryBeam>& primaryBeam,
                           bool requestPolarizationsAtOnce,
                           bool parallelizePolarizations);
 
-  void performReordering(bool isPredictMode);
+  /**
+   * Makes the reordered measurement sets of interval @p intervalIndex
+   * available in _partitionedMSHandles. Where possible, the first interval
+   * reorders all intervals at once.
+   */
+  void performReordering(bool isPredictMode, const MSSelection& fullSelection,
+                         size_t intervalIndex);
 
   ObservationInfo getObservationInfo() const;
   /**
@@ -96,6 +104,39 @@ class WSClean {
       const ImagingTableEntry& entry,
       std::vector<std::unique_ptr<MSDataDescription>>& msList);
   void resetModelColumns(const ImagingTable& groupTable);
+
+  /**
+   * Returns the meta data cache of an entry, to be passed to a gridding task.
+   * With -metadata-cache, a cache that was written by an earlier run is read
+   * from disk when the entry has no cache yet.
+   */
+  std::unique_ptr<MetaDataCache> acquireMetaDataCache(
+      const ImagingTableEntry& entry);
+  /**
+   * Stores the meta data cache of a finished gridding task, and writes it to
+   * disk when -metadata-cache is given.
+   */
+  void storeMetaDataCache(const ImagingTableEntry& entry,
+                          std::unique_ptr<MetaDataCache> cache);
+  /**
+   * Describes everything that the meta data of an entry depends on, apart from
+   * the state of the measurement sets on disk.
+   */
+  std::string metaDataCacheIdentity(const ImagingTableEntry& entry) const;
+  std::string metaDataCacheFilename(const std::string& identity) const;
+  /**
+   * Fingerprint of all measurement sets, as they were when it was first
+   * requested in the current interval.
+   */
+  const std::string& initialMSFingerprints();
+  /**
+   * WSClean only writes model data and imaging weights to the measurement
+   * sets, which do not change the meta data. This updates the fingerprints in
+   * the cache files that were used in this run, such that these writes do not
+   * invalidate them. It should be called after the model data has been
+   * written.
+   */
+  void refreshMetaDataCacheFiles();
   void resetModelColumns(const ImagingTableEntry& entry);
   void storeAndCombineXYandYX(CachedImageSet& dest, size_t joinedChannelIndex,
                               const ImagingTableEntry& entry,
@@ -142,14 +183,58 @@ class WSClean {
   void imagePSFCallback(ImagingTableEntry& entry, struct GriddingResult& result,
                         bool writeBeamImage);
 
+  GriddingTask makeImageMainTask(const ImagingTableEntry& entry,
+                                 bool isFirstInversion);
   void imageMain(ImagingTableEntry& entry, bool isFirstInversion,
                  bool updateBeamInfo);
+
+  /**
+   * First inversion of an entry that also makes its PSF, in a single pass
+   * over the data. Replaces the imagePSF() and imageMain() calls.
+   */
+  void imageMainWithPSF(ImagingTableEntry& entry);
+
+  /**
+   * Whether the PSF can be made by imageMainWithPSF() during the first
+   * inversion. This requires the w-gridder, no facets, no XY/YX
+   * polarizations, and that neither the PSF nor the dirty image is reused.
+   */
+  bool canGridPSFWithDirty() const;
+
+  /**
+   * Makes the images of all facets in a facet group (i.e., all facets of a
+   * single channel and polarization) by reading the data only once, instead
+   * of calling imageMain() for each facet.
+   */
+  void imageFacetGroup(const ImagingTable::Group& facetGroup,
+                       bool isFirstInversion, bool updateBeamInfo);
+
+  /**
+   * Whether imageFacetGroup() can be used. This requires the w-gridder and
+   * facets, and is not supported with MPI.
+   */
+  bool canGridFacetGroups() const;
   void imageMainCallback(ImagingTableEntry& entry,
                          struct GriddingResult& result, bool updateBeamInfo,
                          bool isInitialInversion);
 
   void predict(const ImagingTableEntry& entry);
 
+  /**
+   * Makes the residual image of an entry in a single gridding pass that
+   * predicts the model and grids the residual, instead of a predict() and
+   * an imageMain() call. The model data is not written.
+   */
+  void imageResidual(ImagingTableEntry& entry);
+
+  /**
+   * Whether the major iteration can use imageResidual(). This requires the
+   * w-gridder, no facets and no XY/YX polarizations. When the model data is
+   * required after imaging, the last major iteration writes it and therefore
+   * can not be fused.
+   */
+  bool canFuseResidualGridding(bool isFinished) const;
+
   void saveUVImage(const aocommon::Image& image, const ImagingTableEntry& entry,
                    bool isImaginary, const std::string& prefix) const;
 
@@ -248,6 +333,9 @@ class WSClean {
   std::vector<OutputChannelInfo> _infoPerChannel;
   OutputChannelInfo _infoForMFS;
   std::map<size_t, std::unique_ptr<MetaDataCache>> _msGridderMetaCache;
+  // Cache files that were read or written in this run, with their identity
+  std::map<std::string, std::string> _metaDataCacheFiles;
+  std::string _initialMSFingerprints;
 
   std::unique_ptr<class GriddingTaskManager> _griddingTaskManager;
   std::unique_ptr<class ImageWeightCache> _imageWeightCache;
@@ -260,6 +348,9 @@ class WSClean {
   CachedImageSet _scalarBeamImages;
   CachedImageSet _matrixBeamImages;
   std::vector<PartitionedMS::Handle> _partitionedMSHandles;
+  // Reordered measurement sets of the intervals that are still to be
+  // processed, indexed by [ms][interval].
+  std::vector<std::vector<PartitionedMS::Handle>> _reorderedHandles;
   std::vector<aocommon::MultiBandData> _msBands;
   // Deconvolution object only needed in RunClean runs.
   std::optional<Deconvolution> _deconvolution;
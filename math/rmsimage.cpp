@@ -7,6 +7,9 @@
 
 #include <schaapcommon/fft/restoreimage.h>
 
+#include <algorithm>
+#include <limits>
+
 using aocommon::Image;
 
 void RMSImage::Make(Image& rmsOutput, const Image& inputImage,
@@ -30,38 +33,77 @@ void RMSImage::Make(Image& rmsOutput, const Image& inputImage,
   for (auto& val : rmsOutput) val = std::sqrt(val * norm);
 }
 
+namespace {
+/**
+ * One-dimensional sliding minimum with the van Herk/Gil-Werman algorithm.
+ * Element i of the output is the minimum of input values [i - h, i + h),
+ * clipped to the range of the input, with h = halfWindow. Out-of-range values
+ * are treated as +infinity, and the result is built from the running minima
+ * from the start and from the end of blocks of length 2h. This takes three
+ * comparisons per element, independent of the window size.
+ * @param prefix, suffix Scratch buffers of at least size + 2h elements.
+ */
+void SlidingMinimum1D(const float* input, float* output, size_t size,
+                      size_t halfWindow, float* prefix, float* suffix) {
+  const size_t h = std::min(halfWindow, size);
+  if (h == 0) {
+    std::copy_n(input, size, output);
+    return;
+  }
+  const size_t blockSize = 2 * h;
+  const size_t paddedSize = size + blockSize;
+  auto padded = [&](size_t i) {
+    return (i >= h && i < size + h) ? input[i - h]
+                                    : std::numeric_limits<float>::infinity();
+  };
+  for (size_t blockStart = 0; blockStart < paddedSize;
+       blockStart += blockSize) {
+    const size_t blockEnd = std::min(blockStart + blockSize, paddedSize);
+    prefix[blockStart] = padded(blockStart);
+    for (size_t i = blockStart + 1; i != blockEnd; ++i)
+      prefix[i] = std::min(prefix[i - 1], padded(i));
+    suffix[blockEnd - 1] = padded(blockEnd - 1);
+    for (size_t i = blockEnd - 1; i != blockStart; --i)
+      suffix[i - 1] = std::min(suffix[i], padded(i - 1));
+  }
+  // Output i covers the padded elements [i, i + 2h), which span at most two
+  // blocks.
+  for (size_t i = 0; i != size; ++i)
+    output[i] = std::min(suffix[i], prefix[i + blockSize - 1]);
+}
+}  // namespace
+
 void RMSImage::SlidingMinimum(Image& output, const Image& input,
                               size_t windowSize, size_t threadCount) {
   const size_t width = input.Width();
-  output = Image(width, input.Height());
+  const size_t height = input.Height();
+  const size_t halfWindow = windowSize / 2;
+  const size_t rowPadding = 2 * std::min(halfWindow, width);
+  const size_t columnPadding = 2 * std::min(halfWindow, height);
+  output = Image(width, height);
   Image temp(output);
 
   aocommon::StaticFor<size_t> loop(threadCount);
 
-  loop.Run(0, input.Height(), [&](size_t yStart, size_t yEnd) {
+  loop.Run(0, height, [&](size_t yStart, size_t yEnd) {
+    aocommon::UVector<float> prefix(width + rowPadding);
+    aocommon::UVector<float> suffix(width + rowPadding);
     for (size_t y = yStart; y != yEnd; ++y) {
-      float* outRowptr = &temp[y * width];
-      const float* inRowptr = &input[y * width];
-      for (size_t x = 0; x != width; ++x) {
-        size_t left = std::max(x, windowSize / 2) - windowSize / 2;
-        size_t right = std::min(x, width - windowSize / 2) + windowSize / 2;
-        outRowptr[x] = *std::min_element(inRowptr + left, inRowptr + right);
-      }
+      SlidingMinimum1D(&input[y * width], &temp[y * width], width, halfWindow,
+                       prefix.data(), suffix.data());
     }
   });
 
   loop.Run(0, width, [&](size_t xStart, size_t xEnd) {
-    aocommon::UVector<float> vals;
+    aocommon::UVector<float> column(height);
+    aocommon::UVector<float> result(height);
+    aocommon::UVector<float> prefix(height + columnPadding);
+    aocommon::UVector<float> suffix(height + columnPadding);
     for (size_t x = xStart; x != xEnd; ++x) {
-      for (size_t y = 0; y != input.Height(); ++y) {
-        size_t top = std::max(y, windowSize / 2) - windowSize / 2;
-        size_t bottom =
-            std::min(y, input.Height() - windowSize / 2) + windowSize / 2;
-        vals.clear();
-        for (size_t winY = top; winY != bottom; ++winY)
-          vals.push_back(temp[winY * width + x]);
-        output[y * width + x] = *std::min_element(vals.begin(), vals.end());
-      }
+      for (size_t y = 0; y != height; ++y) column[y] = temp[y * width + x];
+      SlidingMinimum1D(column.data(), result.data(), height, halfWindow,
+                       prefix.data(), suffix.data());
+      for (size_t y = 0; y != height; ++y) output[y * width + x] = result[y];
     }
   });
 }
@@ -1,6 +1,12 @@
 #include "contiguousmsreader.h"
 #include "../contiguousms.h"
 
+#include <casacore/casa/Arrays/Slicer.h>
+#include <casacore/tables/Tables/ColumnDesc.h>
+
+#include <algorithm>
+#include <cmath>
+
 ContiguousMSReader::ContiguousMSReader(ContiguousMS* contiguousms)
     : MSReader(contiguousms),
       _currentInputRow(contiguousms->_startRow - 1),
@@ -16,7 +22,12 @@ ContiguousMSReader::ContiguousMSReader(ContiguousMS* contiguousms)
   NextInputRow();
 }
 
+ContiguousMSReader::~ContiguousMSReader() {
+  if (_prefetch.valid()) _prefetch.wait();
+}
+
 bool ContiguousMSReader::CurrentRowAvailable() {
+  waitForPrefetch();
   const ContiguousMS& contiguousms =
       static_cast<const ContiguousMS&>(*_msProvider);
 
@@ -53,6 +64,7 @@ bool ContiguousMSReader::CurrentRowAvailable() {
 }
 
 void ContiguousMSReader::NextInputRow() {
+  waitForPrefetch();
   const ContiguousMS& contiguousms =
       static_cast<const ContiguousMS&>(*_msProvider);
 
@@ -83,6 +95,7 @@ void ContiguousMSReader::NextInputRow() {
 }
 
 void ContiguousMSReader::ReadMeta(double& u, double& v, double& w) {
+  waitForPrefetch();
   const ContiguousMS& contiguousms =
       static_cast<const ContiguousMS&>(*_msProvider);
 
@@ -93,6 +106,7 @@ void ContiguousMSReader::ReadMeta(double& u, double& v, double& w) {
 }
 
 void ContiguousMSReader::ReadMeta(MSProvider::MetaData& metaData) {
+  waitForPrefetch();
   const ContiguousMS& contiguousms =
       static_cast<const ContiguousMS&>(*_msProvider);
 
@@ -107,6 +121,7 @@ void ContiguousMSReader::ReadMeta(MSProvider::MetaData& metaData) {
 }
 
 void ContiguousMSReader::ReadData(std::complex<float>* buffer) {
+  waitForPrefetch();
   ContiguousMS& contiguousms = static_cast<ContiguousMS&>(*_msProvider);
 
   readData();
@@ -126,6 +141,7 @@ void ContiguousMSReader::ReadData(std::complex<float>* buffer) {
 }
 
 void ContiguousMSReader::ReadModel(std::complex<float>* buffer) {
+  waitForPrefetch();
   ContiguousMS& contiguousms = static_cast<ContiguousMS&>(*_msProvider);
 
   if (!contiguousms._isModelColumnPrepared) contiguousms.prepareModelColumn();
@@ -147,6 +163,7 @@ void ContiguousMSReader::ReadModel(std::complex<float>* buffer) {
 }
 
 void ContiguousMSReader::ReadWeights(float* buffer) {
+  waitForPrefetch();
   const ContiguousMS& contiguousms =
       static_cast<const ContiguousMS&>(*_msProvider);
 
@@ -168,6 +185,7 @@ void ContiguousMSReader::ReadWeights(float* buffer) {
 }
 
 void ContiguousMSReader::WriteImagingWeights(const float* buffer) {
+  waitForPrefetch();
   ContiguousMS& contiguousms = static_cast<ContiguousMS&>(*_msProvider);
 
   if (_imagingWeightsColumn == nullptr) {
@@ -194,6 +212,172 @@ void ContiguousMSReader::WriteImagingWeights(const float* buffer) {
                              contiguousms._imagingWeightSpectrumArray);
 }
 
+size_t ContiguousMSReader::ReadBlock(size_t maxRows, RowBlock& block,
+                                     bool includeData, bool includeModel) {
+  ContiguousMS& contiguousms = static_cast<ContiguousMS&>(*_msProvider);
+
+  if (includeModel && !contiguousms._isModelColumnPrepared) {
+    waitForPrefetch();
+    contiguousms.prepareModelColumn();
+  }
+
+  size_t startChannel, endChannel;
+  if (contiguousms._selection.HasChannelRange()) {
+    startChannel = contiguousms._selection.ChannelRangeStart();
+    endChannel = contiguousms._selection.ChannelRangeEnd();
+  } else {
+    startChannel = 0;
+    endChannel =
+        contiguousms._bandData[contiguousms._dataDescId].ChannelCount();
+  }
+  block.Reserve(maxRows,
+                (endChannel - startChannel) * contiguousms.NPolarizations(),
+                includeModel);
+  if (!canReadSlabs(includeModel))
+    return ReadBlockPerRow(*this, maxRows, block, includeData, includeModel);
+
+  size_t row = 0;
+  while (row != maxRows && _currentInputRow < contiguousms._endRow) {
+    const Slab& slab = slabForRow(_currentInputRow, includeModel);
+    const size_t index = _currentInputRow - slab.startRow;
+    std::copy_n(&slab.uvw.data()[index * 3], 3, &block.uvw[row * 3]);
+    block.time[row] = slab.time[index];
+    block.antenna1[row] = slab.antenna1[index];
+    block.antenna2[row] = slab.antenna2[index];
+    block.fieldId[row] = slab.fieldId[index];
+    block.rowId[row] = _currentRowId;
+
+    // The data array is also needed to copy the weights
+    const casacore::Array<std::complex<float>> data = slab.data[index];
+    if (includeData)
+      MSProvider::CopyData(block.Data(row), startChannel, endChannel,
+                           contiguousms._inputPolarizations, data,
+                           contiguousms._outputPolarization);
+    if (includeModel)
+      MSProvider::CopyData(block.Model(row), startChannel, endChannel,
+                           contiguousms._inputPolarizations,
+                           slab.model[index],
+                           contiguousms._outputPolarization);
+    if (contiguousms._msHasWeightSpectrum) {
+      MSProvider::CopyWeights(
+          block.Weights(row), startChannel, endChannel,
+          contiguousms._inputPolarizations, data, slab.weights[index],
+          slab.flags[index], contiguousms._outputPolarization);
+    } else {
+      _expandedWeights.resize(data.shape());
+      ContiguousMS::ExpandScalarWeights(slab.weights[index], _expandedWeights);
+      MSProvider::CopyWeights(
+          block.Weights(row), startChannel, endChannel,
+          contiguousms._inputPolarizations, data, _expandedWeights,
+          slab.flags[index], contiguousms._outputPolarization);
+    }
+    ++row;
+
+    // Move to the next selected row like NextInputRow() does, but using the
+    // meta data of the slabs.
+    ++_currentRowId;
+    bool isSelected = false;
+    while (!isSelected) {
+      ++_currentInputRow;
+      if (_currentInputRow >= contiguousms._endRow) break;
+
+      const Slab& nextSlab = slabForRow(_currentInputRow, includeModel);
+      const size_t nextIndex = _currentInputRow - nextSlab.startRow;
+      if (_currentInputTime != nextSlab.time[nextIndex]) {
+        ++_currentInputTimestep;
+        _currentInputTime = nextSlab.time[nextIndex];
+      }
+      const double* uvw = &nextSlab.uvw.data()[nextIndex * 3];
+      const double uvwInMeters =
+          std::sqrt(uvw[0] * uvw[0] + uvw[1] * uvw[1] + uvw[2] * uvw[2]);
+      isSelected =
+          nextSlab.dataDescId[nextIndex] == contiguousms._dataDescId &&
+          contiguousms._selection.IsSelected(
+              nextSlab.fieldId[nextIndex], _currentInputTimestep,
+              nextSlab.antenna1[nextIndex], nextSlab.antenna2[nextIndex],
+              uvwInMeters);
+    }
+  }
+  // The measurement set may be accessed by the caller after returning
+  waitForPrefetch();
+  _isDataRead = false;
+  _isWeightRead = false;
+  _isModelRead = false;
+  block.nRows = row;
+  return row;
+}
+
+const ContiguousMSReader::Slab& ContiguousMSReader::slabForRow(
+    size_t row, bool includeModel) {
+  if (_slab.Contains(row) && (_slab.hasModel || !includeModel)) return _slab;
+
+  waitForPrefetch();
+  if (_nextSlab.Contains(row) && (_nextSlab.hasModel || !includeModel))
+    std::swap(_slab, _nextSlab);
+  else
+    readSlab(_slab, row, includeModel);
+
+  const ContiguousMS& contiguousms =
+      static_cast<const ContiguousMS&>(*_msProvider);
+  const size_t nextStartRow = _slab.startRow + _slab.nRows;
+  if (nextStartRow < contiguousms._endRow) {
+    _prefetch = std::async(std::launch::async,
+                           [this, nextStartRow, includeModel]() {
+                             readSlab(_nextSlab, nextStartRow, includeModel);
+                           });
+  }
+  return _slab;
+}
+
+bool ContiguousMSReader::canReadSlabs(bool includeModel) const {
+  const ContiguousMS& contiguousms =
+      static_cast<const ContiguousMS&>(*_msProvider);
+  // Rows of a single data description have the same shape
+  if (contiguousms._bandData.DataDescCount() == 1) return true;
+  const casacore::ArrayColumn<float>& weightColumn =
+      contiguousms._msHasWeightSpectrum ? *contiguousms._weightSpectrumColumn
+                                        : *contiguousms._weightScalarColumn;
+  return contiguousms._dataColumn.columnDesc().isFixedShape() &&
+         contiguousms._flagColumn.columnDesc().isFixedShape() &&
+         weightColumn.columnDesc().isFixedShape() &&
+         (!includeModel ||
+          contiguousms._modelColumn.columnDesc().isFixedShape());
+}
+
+void ContiguousMSReader::readSlab(Slab& slab, size_t startRow,
+                                  bool includeModel) const {
+  const ContiguousMS& contiguousms =
+      static_cast<const ContiguousMS&>(*_msProvider);
+
+  const casacore::IPosition shape = contiguousms._dataColumn.shape(startRow);
+  const size_t bytesPerRow =
+      shape.product() * (sizeof(std::complex<float>) * (includeModel ? 2 : 1) +
+                         sizeof(float) + sizeof(bool));
+  const size_t maxRows = std::max<size_t>(1, kSlabSize / bytesPerRow);
+
+  slab.startRow = startRow;
+  slab.nRows = std::min(maxRows, contiguousms._endRow - startRow);
+  slab.hasModel = includeModel;
+  const casacore::Slicer rows(casacore::IPosition(1, slab.startRow),
+                              casacore::IPosition(1, slab.nRows));
+
+  contiguousms._timeColumn.getColumnRange(rows, slab.time, true);
+  contiguousms._antenna1Column.getColumnRange(rows, slab.antenna1, true);
+  contiguousms._antenna2Column.getColumnRange(rows, slab.antenna2, true);
+  contiguousms._fieldIdColumn.getColumnRange(rows, slab.fieldId, true);
+  contiguousms._dataDescIdColumn.getColumnRange(rows, slab.dataDescId, true);
+  contiguousms._uvwColumn.getColumnRange(rows, slab.uvw, true);
+  contiguousms._dataColumn.getColumnRange(rows, slab.data, true);
+  contiguousms._flagColumn.getColumnRange(rows, slab.flags, true);
+  if (contiguousms._msHasWeightSpectrum)
+    contiguousms._weightSpectrumColumn->getColumnRange(rows, slab.weights,
+                                                       true);
+  else
+    contiguousms._weightScalarColumn->getColumnRange(rows, slab.weights, true);
+  if (includeModel)
+    contiguousms._modelColumn.getColumnRange(rows, slab.model, true);
+}
+
 void ContiguousMSReader::readData() {
   ContiguousMS& contiguousms = static_cast<ContiguousMS&>(*_msProvider);
   if (!_isDataRead) {
@@ -3,13 +3,34 @@
 
 #include "msreader.h"
 
+#include <casacore/casa/Arrays/Array.h>
+#include <casacore/casa/Arrays/Vector.h>
+
+#include <future>
+
 class ContiguousMS;
 
+/**
+ * Reads the visibilities of a @ref ContiguousMS directly from the measurement
+ * set.
+ *
+ * The per-row interface reads every row with separate casacore calls.
+ * ReadBlock() instead reads slabs of consecutive measurement set rows with
+ * a single getColumnRange() call per column. While the rows of one slab are
+ * copied into the block, the next slab is read by a background thread, such
+ * that the casacore decoding overlaps with the copying.
+ *
+ * casacore tables are not thread safe, so the background read may not
+ * overlap with any other access to the measurement set. Therefore, ReadBlock()
+ * waits for it before returning: the caller may access the same measurement
+ * set afterwards, for example to write the model data or to evaluate the
+ * beam.
+ */
 class ContiguousMSReader final : public MSReader {
  public:
   explicit ContiguousMSReader(ContiguousMS* contiguousMS);
 
-  virtual ~ContiguousMSReader(){};
+  ~ContiguousMSReader() override;
 
   size_t RowId() const override { return _currentRowId; }
 
@@ -29,6 +50,9 @@ class ContiguousMSReader final : public MSReader {
 
   void WriteImagingWeights(const float* buffer) override;
 
+  size_t ReadBlock(size_t maxRows, RowBlock& block, bool readData = true,
+                   bool readModel = false) override;
+
  private:
   size_t _currentInputRow;
   size_t _currentInputTimestep;
@@ -38,6 +62,66 @@ class ContiguousMSReader final : public MSReader {
   bool _isDataRead, _isModelRead, _isWeightRead;
   std::unique_ptr<casacore::ArrayColumn<float>> _imagingWeightsColumn;
 
+  /**
+   * A range of consecutive measurement set rows, as read by readSlab(). The
+   * last axis of each array is the row. Rows that are not selected are
+   * included, and are skipped when the slab is used.
+   */
+  struct Slab {
+    size_t startRow = 0;
+    size_t nRows = 0;
+    bool hasModel = false;
+    casacore::Vector<double> time;
+    casacore::Vector<int> antenna1, antenna2, fieldId, dataDescId;
+    casacore::Array<double> uvw;
+    casacore::Array<std::complex<float>> data, model;
+    /** Either the weight spectrum, or a weight per polarization. */
+    casacore::Array<float> weights;
+    casacore::Array<bool> flags;
+
+    bool Contains(size_t row) const {
+      return row >= startRow && row < startRow + nRows;
+    }
+  };
+
+  /**
+   * Number of bytes per slab. Together with the prefetched slab, twice this
+   * amount of memory is used by ReadBlock().
+   */
+  static constexpr size_t kSlabSize = 32 * 1024 * 1024;
+
+  Slab _slab;
+  Slab _nextSlab;
+  casacore::Array<float> _expandedWeights;
+  // Declared last, so that the prefetch is finished before the slabs are
+  // destructed.
+  std::future<void> _prefetch;
+
+  /**
+   * Returns the slab with the given measurement set row. When necessary, the
+   * prefetched slab is used or a new slab is read. In both cases, the read of
+   * the slab that follows it is started in the background. Only to be called
+   * from ReadBlock(), which waits for that read to finish before it returns.
+   */
+  const Slab& slabForRow(size_t row, bool includeModel);
+
+  void readSlab(Slab& slab, size_t startRow, bool includeModel) const;
+
+  /**
+   * Whether all rows of the columns read by readSlab() have the same shape,
+   * which getColumnRange() requires. This is not necessarily the case when
+   * the measurement set has data descriptions with different shapes.
+   */
+  bool canReadSlabs(bool includeModel) const;
+
+  /**
+   * Waits until the background read of the next slab is finished. Needs to
+   * be called before the measurement set is accessed.
+   */
+  void waitForPrefetch() {
+    if (_prefetch.valid()) _prefetch.get();
+  }
+
   void readData();
 
   void readWeights();
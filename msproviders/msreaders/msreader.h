@@ -3,6 +3,10 @@
 
 #include "../msprovider.h"
 
+#include <aocommon/uvector.h>
+
+#include <algorithm>
+
 /**
  * The abstract MSReader class is the base class for classes that read
  * visibilities. Derived classes are usually instantiated via
@@ -12,9 +16,87 @@
  * This class maintains a reading position, that goes sequentially through the
  * data. The interface of this class is implemented in @ref ContiguousMSReader
  * and @ref PartitionedMSReader.
+ *
+ * Rows can be read one at a time with the ReadMeta(), ReadData(), etc.
+ * functions, or as a block of consecutive rows with ReadBlock().
  */
 class MSReader {
  public:
+  /**
+   * A block of consecutive rows in structure-of-arrays layout, as filled by
+   * ReadBlock(). The arrays are only grown, such that a RowBlock can be reused
+   * for reading subsequent blocks without reallocating.
+   */
+  struct RowBlock {
+    /** Number of rows in the block. */
+    size_t nRows = 0;
+    /** Number of visibilities per row (channels x polarizations). */
+    size_t rowSize = 0;
+    /** u, v and w in meters, three values per row. */
+    aocommon::UVector<double> uvw;
+    aocommon::UVector<double> time;
+    aocommon::UVector<size_t> antenna1;
+    aocommon::UVector<size_t> antenna2;
+    aocommon::UVector<size_t> fieldId;
+    /** The RowId() of each row. */
+    aocommon::UVector<size_t> rowId;
+    /** Visibilities, rowSize values per row. */
+    aocommon::UVector<std::complex<float>> data;
+    /** Model visibilities. Only filled when requested in ReadBlock(). */
+    aocommon::UVector<std::complex<float>> model;
+    aocommon::UVector<float> weights;
+
+    std::complex<float>* Data(size_t row) { return &data[row * rowSize]; }
+    std::complex<float>* Model(size_t row) { return &model[row * rowSize]; }
+    float* Weights(size_t row) { return &weights[row * rowSize]; }
+
+    /**
+     * Make sure that the block can hold @p maxRows rows of @p newRowSize
+     * visibilities each.
+     */
+    void Reserve(size_t maxRows, size_t newRowSize, bool withModel) {
+      rowSize = newRowSize;
+      uvw.resize(maxRows * 3);
+      time.resize(maxRows);
+      antenna1.resize(maxRows);
+      antenna2.resize(maxRows);
+      fieldId.resize(maxRows);
+      rowId.resize(maxRows);
+      data.resize(maxRows * rowSize);
+      if (withModel) model.resize(maxRows * rowSize);
+      weights.resize(maxRows * rowSize);
+    }
+
+    void SetMeta(size_t row, const MSProvider::MetaData& metaData) {
+      uvw[row * 3] = metaData.uInM;
+      uvw[row * 3 + 1] = metaData.vInM;
+      uvw[row * 3 + 2] = metaData.wInM;
+      time[row] = metaData.time;
+      antenna1[row] = metaData.antenna1;
+      antenna2[row] = metaData.antenna2;
+      fieldId[row] = metaData.fieldId;
+    }
+
+    /**
+     * Copies row @p row of @p source to the end of this block. The block
+     * should have been reserved with enough space and the same row size.
+     * @param withModel If true, the model visibilities are also copied.
+     */
+    void AppendRow(const RowBlock& source, size_t row, bool withModel) {
+      std::copy_n(&source.uvw[row * 3], 3, &uvw[nRows * 3]);
+      time[nRows] = source.time[row];
+      antenna1[nRows] = source.antenna1[row];
+      antenna2[nRows] = source.antenna2[row];
+      fieldId[nRows] = source.fieldId[row];
+      rowId[nRows] = source.rowId[row];
+      std::copy_n(&source.data[row * rowSize], rowSize, Data(nRows));
+      if (withModel)
+        std::copy_n(&source.model[row * rowSize], rowSize, Model(nRows));
+      std::copy_n(&source.weights[row * rowSize], rowSize, Weights(nRows));
+      ++nRows;
+    }
+  };
+
   MSReader(MSProvider* msProvider) : _msProvider(msProvider){};
 
   virtual ~MSReader(){};
@@ -68,7 +150,54 @@ class MSReader {
    */
   virtual void WriteImagingWeights(const float* buffer) = 0;
 
+  /**
+   * Read up to @p maxRows rows, starting at the current reading position,
+   * into @p block. Afterwards, the reading position is at the first row after
+   * the block, as if NextInputRow() was called for each row read. Because of
+   * this, WriteImagingWeights() can not be used for the rows of the block.
+   *
+   * The base implementation reads the rows one by one; derived readers
+   * override it to read the rows in bulk.
+   * @param readData If false, the visibility data is not read. This is useful
+   * when imaging the PSF. The data array is still allocated.
+   * @param readModel If true, the model data is read into block.model.
+   * @returns The number of rows read, which is only smaller than @p maxRows
+   * when the end of the data is reached.
+   */
+  virtual size_t ReadBlock(size_t maxRows, RowBlock& block,
+                           bool readData = true, bool readModel = false) {
+    block.Reserve(maxRows,
+                  _msProvider->NChannels() * _msProvider->NPolarizations(),
+                  readModel);
+    return ReadBlockPerRow(*this, maxRows, block, readData, readModel);
+  }
+
  protected:
+  /**
+   * Reads a block row by row using the per-row interface of @p reader. This
+   * is a template such that final reader classes can use it without virtual
+   * calls.
+   */
+  template <typename Reader>
+  static size_t ReadBlockPerRow(Reader& reader, size_t maxRows,
+                                RowBlock& block, bool readData,
+                                bool readModel) {
+    MSProvider::MetaData metaData;
+    size_t row = 0;
+    while (row != maxRows && reader.CurrentRowAvailable()) {
+      reader.ReadMeta(metaData);
+      block.SetMeta(row, metaData);
+      if (readData) reader.ReadData(block.Data(row));
+      if (readModel) reader.ReadModel(block.Model(row));
+      reader.ReadWeights(block.Weights(row));
+      block.rowId[row] = reader.RowId();
+      reader.NextInputRow();
+      ++row;
+    }
+    block.nRows = row;
+    return row;
+  }
+
   MSProvider* _msProvider;
 };
 
@@ -1,36 +1,76 @@
 #include "partitionedmsreader.h"
 #include "../partitionedms.h"
+#include "../reducedprecision.h"
+
+namespace {
+// Number of rows that are prefetched ahead of a block read with ReadBlock().
+constexpr size_t kPrefetchRowCount = 1024;
+}  // namespace
 
 PartitionedMSReader::PartitionedMSReader(PartitionedMS* partitionedMS)
     : MSReader(partitionedMS),
       _currentInputRow(0),
-      _readPtrIsOk(true),
-      _metaPtrIsOk(true),
-      _weightPtrIsOk(true) {
-  _metaFile.open(PartitionedMS::getMetaFilename(
-                     partitionedMS->_handle._data->_msPath,
-                     partitionedMS->_handle._data->_temporaryDirectory,
-                     partitionedMS->_partHeader.dataDescId),
-                 std::ios::in);
-  std::vector<char> msPath(partitionedMS->_metaHeader.filenameLength + 1,
-                           char(0));
+      _rowSize(partitionedMS->_partHeader.channelCount *
+               partitionedMS->_polarizationCountInFile),
+      _isCompressed(partitionedMS->_partHeader.isCompressed),
+      _dataValueSize(_isCompressed ? sizeof(uint16_t) : sizeof(float)) {
+  const std::string metaFilename = PartitionedMS::getMetaFilename(
+      partitionedMS->_handle._data->_msPath,
+      partitionedMS->_handle._data->_intervalIndex,
+      partitionedMS->_handle._data->_temporaryDirectory,
+      partitionedMS->_partHeader.dataDescId);
+  const size_t rowCount = partitionedMS->_metaHeader.selectedRowCount;
+  const size_t filenameLength = partitionedMS->_metaHeader.filenameLength;
+
   // meta and data header were read in PartitionedMS constructor
-  _metaFile.seekg(PartitionedMS::MetaHeader::BINARY_SIZE, std::ios::beg);
-  _metaFile.read(msPath.data(), partitionedMS->_metaHeader.filenameLength);
-  std::string partPrefix = PartitionedMS::getPartPrefix(
-      msPath.data(), partitionedMS->_partIndex, partitionedMS->_polarization,
+  _metaFile = MappedFile::OpenReadOnly(metaFilename);
+  const size_t metaRecordStart =
+      PartitionedMS::MetaHeader::BINARY_SIZE + filenameLength;
+  checkFileSize(_metaFile, metaFilename,
+                metaRecordStart +
+                    rowCount * PartitionedMS::MetaRecord::BINARY_SIZE);
+  const std::string msPath(_metaFile.Data() +
+                               PartitionedMS::MetaHeader::BINARY_SIZE,
+                           filenameLength);
+  _metaRecords = _metaFile.Data() + metaRecordStart;
+
+  const std::string partPrefix = PartitionedMS::getPartPrefix(
+      msPath, partitionedMS->_handle._data->_intervalIndex,
+      partitionedMS->_partIndex, partitionedMS->_polarization,
       partitionedMS->_partHeader.dataDescId,
       partitionedMS->_handle._data->_temporaryDirectory);
-  _dataFile.open(partPrefix + ".tmp", std::ios::in);
-  if (!_dataFile.good())
-    throw std::runtime_error("Error opening temporary data file in '" +
-                             partPrefix + ".tmp'");
-  _dataFile.seekg(PartitionedMS::PartHeader::BINARY_SIZE, std::ios::beg);
-
-  _weightFile.open(partPrefix + "-w.tmp", std::ios::in);
-  if (!_weightFile.good())
-    throw std::runtime_error("Error opening temporary data weight file '" +
-                             partPrefix + "-w.tmp'");
+  _dataFile = MappedFile::OpenReadOnly(partPrefix + ".tmp");
+  checkFileSize(_dataFile, partPrefix + ".tmp",
+                PartitionedMS::PartHeader::BINARY_SIZE +
+                    rowCount * _rowSize * 2 * _dataValueSize);
+  // The data starts after the part header and is therefore not aligned: it
+  // is copied byte-wise.
+  _data = _dataFile.Data() + PartitionedMS::PartHeader::BINARY_SIZE;
+
+  _weightFile = MappedFile::OpenReadOnly(partPrefix + "-w.tmp");
+  checkFileSize(_weightFile, partPrefix + "-w.tmp",
+                rowCount * _rowSize * _dataValueSize);
+  _weights = _weightFile.Data();
+
+  _metaFile.AdviseSequential();
+  _dataFile.AdviseSequential();
+  _weightFile.AdviseSequential();
+}
+
+void PartitionedMSReader::checkFileSize(const MappedFile& file,
+                                        const std::string& filename,
+                                        size_t requiredSize) {
+  // Accessing a map beyond the end of its file raises SIGBUS instead of an
+  // error, so truncated files are detected here.
+  if (file.Size() < requiredSize)
+    throw std::runtime_error("Temporary file '" + filename +
+                             "' is truncated: expected at least " +
+                             std::to_string(requiredSize) + " bytes, found " +
+                             std::to_string(file.Size()));
+}
+
+const char* PartitionedMSReader::metaRecord(size_t row) const {
+  return _metaRecords + row * PartitionedMS::MetaRecord::BINARY_SIZE;
 }
 
 bool PartitionedMSReader::CurrentRowAvailable() {
@@ -39,50 +79,19 @@ bool PartitionedMSReader::CurrentRowAvailable() {
   return _currentInputRow < partitionedms._metaHeader.selectedRowCount;
 }
 
-void PartitionedMSReader::NextInputRow() {
-  const PartitionedMS& partitionedms =
-      static_cast<const PartitionedMS&>(*_msProvider);
-
-  const size_t n_visibilities = partitionedms._partHeader.channelCount *
-                                partitionedms._polarizationCountInFile;
-  ++_currentInputRow;
-  if (_currentInputRow < partitionedms._metaHeader.selectedRowCount) {
-    if (_readPtrIsOk)
-      _dataFile.seekg(n_visibilities * sizeof(std::complex<float>),
-                      std::ios::cur);
-    else
-      _readPtrIsOk = true;
-
-    if (_metaPtrIsOk)
-      _metaFile.seekg(PartitionedMS::MetaRecord::BINARY_SIZE, std::ios::cur);
-    else
-      _metaPtrIsOk = true;
-
-    if (_weightPtrIsOk)
-      _weightFile.seekg(n_visibilities * sizeof(float), std::ios::cur);
-    _weightPtrIsOk = true;
-  }
-}
+void PartitionedMSReader::NextInputRow() { ++_currentInputRow; }
 
 void PartitionedMSReader::ReadMeta(double& u, double& v, double& w) {
-  if (!_metaPtrIsOk)
-    _metaFile.seekg(-PartitionedMS::MetaRecord::BINARY_SIZE, std::ios::cur);
-  _metaPtrIsOk = false;
-
   PartitionedMS::MetaRecord record;
-  record.Read(_metaFile);
+  record.Read(metaRecord(_currentInputRow));
   u = record.u;
   v = record.v;
   w = record.w;
 }
 
 void PartitionedMSReader::ReadMeta(MSProvider::MetaData& metaData) {
-  if (!_metaPtrIsOk)
-    _metaFile.seekg(-PartitionedMS::MetaRecord::BINARY_SIZE, std::ios::cur);
-  _metaPtrIsOk = false;
-
   PartitionedMS::MetaRecord record;
-  record.Read(_metaFile);
+  record.Read(metaRecord(_currentInputRow));
   metaData.uInM = record.u;
   metaData.vInM = record.v;
   metaData.wInM = record.w;
@@ -92,32 +101,31 @@ void PartitionedMSReader::ReadMeta(MSProvider::MetaData& metaData) {
   metaData.time = record.time;
 }
 
-void PartitionedMSReader::ReadData(std::complex<float>* buffer) {
-  const PartitionedMS& partitionedms =
-      static_cast<const PartitionedMS&>(*_msProvider);
+void PartitionedMSReader::copyData(size_t startRow, size_t nRows,
+                                   std::complex<float>* buffer) const {
+  const size_t nValues = nRows * _rowSize * 2;
+  const char* source = _data + startRow * _rowSize * 2 * _dataValueSize;
+  if (_isCompressed)
+    reduced_precision::Decode(source, nValues,
+                              reinterpret_cast<float*>(buffer));
+  else
+    std::copy_n(source, nValues * sizeof(float),
+                reinterpret_cast<char*>(buffer));
+}
 
-  const int64_t n_visibilities = partitionedms._partHeader.channelCount *
-                                 partitionedms._polarizationCountInFile;
-  if (!_readPtrIsOk) {
-    // Data file position was moved forward already, so seek back by one block
-    _dataFile.seekg(-n_visibilities * sizeof(std::complex<float>),
-                    std::ios::cur);
-  }
-#ifndef NDEBUG
-  const size_t pos =
-      size_t(_dataFile.tellg()) - PartitionedMS::PartHeader::BINARY_SIZE;
-  if (pos != _currentInputRow * n_visibilities * sizeof(std::complex<float>)) {
-    std::ostringstream s;
-    s << "Not on right pos: " << pos << " instead of "
-      << _currentInputRow * n_visibilities * sizeof(std::complex<float>)
-      << " (row " << (pos / (n_visibilities * sizeof(std::complex<float>)))
-      << " instead of " << _currentInputRow << ")";
-    throw std::runtime_error(s.str());
-  }
-#endif
-  _dataFile.read(reinterpret_cast<char*>(buffer),
-                 n_visibilities * sizeof(std::complex<float>));
-  _readPtrIsOk = false;
+void PartitionedMSReader::copyWeights(size_t startRow, size_t nRows,
+                                      float* buffer) const {
+  const size_t nValues = nRows * _rowSize;
+  const char* source = _weights + startRow * _rowSize * _dataValueSize;
+  if (_isCompressed)
+    reduced_precision::Decode(source, nValues, buffer);
+  else
+    std::copy_n(source, nValues * sizeof(float),
+                reinterpret_cast<char*>(buffer));
+}
+
+void PartitionedMSReader::ReadData(std::complex<float>* buffer) {
+  copyData(_currentInputRow, 1, buffer);
 }
 
 void PartitionedMSReader::ReadModel(std::complex<float>* buffer) {
@@ -128,26 +136,75 @@ void PartitionedMSReader::ReadModel(std::complex<float>* buffer) {
   if (!partitionedms._partHeader.hasModel)
     throw std::runtime_error("Partitioned MS initialized without model");
 #endif
-  const size_t rowLength = partitionedms._partHeader.channelCount *
-                           partitionedms._polarizationCountInFile *
-                           sizeof(std::complex<float>);
-  std::copy_n(partitionedms._modelFile.Data() + rowLength * _currentInputRow,
-              rowLength, reinterpret_cast<char*>(buffer));
+  const std::complex<float>* model =
+      reinterpret_cast<const std::complex<float>*>(
+          partitionedms._modelFile.Data());
+  std::copy_n(&model[_currentInputRow * _rowSize], _rowSize, buffer);
 }
 
 void PartitionedMSReader::ReadWeights(float* buffer) {
+  copyWeights(_currentInputRow, 1, buffer);
+}
+
+size_t PartitionedMSReader::ReadBlock(size_t maxRows, RowBlock& block,
+                                      bool readData, bool readModel) {
   const PartitionedMS& partitionedms =
       static_cast<const PartitionedMS&>(*_msProvider);
 
-  const int64_t n_visibilities = partitionedms._partHeader.channelCount *
-                                 partitionedms._polarizationCountInFile;
-  if (!_weightPtrIsOk) {
-    // jump to the previous block of weights
-    _weightFile.seekg(-n_visibilities * sizeof(float), std::ios::cur);
+  block.Reserve(maxRows, _rowSize, readModel);
+  const size_t nRows =
+      std::min(maxRows,
+               partitionedms._metaHeader.selectedRowCount - _currentInputRow);
+  block.nRows = nRows;
+  if (nRows == 0) return 0;
+
+  // Let the kernel start reading the rows after this block while this block
+  // is being copied and processed.
+  const size_t nextRow = _currentInputRow + nRows;
+  const size_t prefetchRows = std::max(nRows, kPrefetchRowCount);
+  _metaFile.Prefetch(PartitionedMS::MetaHeader::BINARY_SIZE +
+                         partitionedms._metaHeader.filenameLength +
+                         nextRow * PartitionedMS::MetaRecord::BINARY_SIZE,
+                     prefetchRows * PartitionedMS::MetaRecord::BINARY_SIZE);
+  const size_t dataRowLength = _rowSize * 2 * _dataValueSize;
+  if (readData)
+    _dataFile.Prefetch(
+        PartitionedMS::PartHeader::BINARY_SIZE + nextRow * dataRowLength,
+        prefetchRows * dataRowLength);
+  _weightFile.Prefetch(nextRow * _rowSize * _dataValueSize,
+                       prefetchRows * _rowSize * _dataValueSize);
+
+  for (size_t row = 0; row != nRows; ++row) {
+    PartitionedMS::MetaRecord record;
+    record.Read(metaRecord(_currentInputRow + row));
+    block.uvw[row * 3] = record.u;
+    block.uvw[row * 3 + 1] = record.v;
+    block.uvw[row * 3 + 2] = record.w;
+    block.time[row] = record.time;
+    block.antenna1[row] = record.antenna1;
+    block.antenna2[row] = record.antenna2;
+    block.fieldId[row] = record.fieldId;
+    block.rowId[row] = _currentInputRow + row;
+  }
+
+  if (readData) copyData(_currentInputRow, nRows, block.data.data());
+
+  if (readModel) {
+#ifndef NDEBUG
+    if (!partitionedms._partHeader.hasModel)
+      throw std::runtime_error("Partitioned MS initialized without model");
+#endif
+    const std::complex<float>* model =
+        reinterpret_cast<const std::complex<float>*>(
+            partitionedms._modelFile.Data());
+    std::copy_n(&model[_currentInputRow * _rowSize], nRows * _rowSize,
+                block.model.data());
   }
-  _weightFile.read(reinterpret_cast<char*>(buffer),
-                   n_visibilities * sizeof(float));
-  _weightPtrIsOk = false;
+
+  copyWeights(_currentInputRow, nRows, block.weights.data());
+
+  _currentInputRow = nextRow;
+  return nRows;
 }
 
 void PartitionedMSReader::WriteImagingWeights(const float* buffer) {
@@ -156,15 +213,15 @@ void PartitionedMSReader::WriteImagingWeights(const float* buffer) {
 
   if (_imagingWeightsFile == nullptr) {
     std::string partPrefix = PartitionedMS::getPartPrefix(
-        partitionedms._handle._data->_msPath, partitionedms._partIndex,
+        partitionedms._handle._data->_msPath,
+        partitionedms._handle._data->_intervalIndex, partitionedms._partIndex,
         partitionedms._polarization, partitionedms._partHeader.dataDescId,
         partitionedms._handle._data->_temporaryDirectory);
     _imagingWeightsFile.reset(
         new std::fstream(partPrefix + "-imgw.tmp",
                          std::ios::in | std::ios::out | std::ios::binary));
   }
-  const size_t nVis = partitionedms._partHeader.channelCount *
-                      partitionedms._polarizationCountInFile;
+  const size_t nVis = _rowSize;
   _imagingWeightBuffer.resize(nVis);
   const size_t chunkSize = nVis * sizeof(float);
   _imagingWeightsFile->seekg(chunkSize * _currentInputRow, std::ios::beg);
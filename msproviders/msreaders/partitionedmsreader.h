@@ -3,12 +3,20 @@
 
 #include "msreader.h"
 
+#include "../../system/mappedfile.h"
+
 #include <aocommon/uvector.h>
 
 #include <fstream>
 
 class PartitionedMS;
 
+/**
+ * Reads the reordered part files of a @ref PartitionedMS. The meta, data and
+ * weight files are memory mapped read-only, such that reading a row copies
+ * directly from the page cache without any seeking. Compressed parts are
+ * decoded while copying.
+ */
 class PartitionedMSReader final : public MSReader {
  public:
   PartitionedMSReader(PartitionedMS* partitionedMS);
@@ -32,11 +40,41 @@ class PartitionedMSReader final : public MSReader {
 
   void WriteImagingWeights(const float* buffer) override;
 
+  /**
+   * Copies the meta data, data and weights of the block each as one range,
+   * because the rows are stored consecutively in the partition files. The
+   * rows following the block are prefetched.
+   */
+  size_t ReadBlock(size_t maxRows, RowBlock& block, bool readData = true,
+                   bool readModel = false) override;
+
  private:
-  size_t _currentInputRow;
-  bool _readPtrIsOk, _metaPtrIsOk, _weightPtrIsOk;
+  const char* metaRecord(size_t row) const;
 
-  std::ifstream _metaFile, _weightFile, _dataFile;
+  /**
+   * Copy the data or weights of @p nRows rows, decoding them when the part
+   * is compressed.
+   * @{
+   */
+  void copyData(size_t startRow, size_t nRows,
+                std::complex<float>* buffer) const;
+  void copyWeights(size_t startRow, size_t nRows, float* buffer) const;
+  /** @} */
+
+  static void checkFileSize(const MappedFile& file,
+                            const std::string& filename, size_t requiredSize);
+
+  size_t _currentInputRow;
+  // Number of visibilities per row
+  size_t _rowSize;
+  bool _isCompressed;
+  // Size of a stored float or complex component: 2 bytes when compressed.
+  size_t _dataValueSize;
+
+  MappedFile _metaFile, _dataFile, _weightFile;
+  const char* _metaRecords = nullptr;
+  const char* _data = nullptr;
+  const char* _weights = nullptr;
 
   aocommon::UVector<float> _imagingWeightBuffer;
   std::unique_ptr<std::fstream> _imagingWeightsFile;
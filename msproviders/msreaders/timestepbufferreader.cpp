@@ -1,5 +1,7 @@
 #include "timestepbufferreader.h"
 
+#include <algorithm>
+
 TimestepBufferReader::TimestepBufferReader(TimestepBuffer* timestepBuffer)
     : MSReader(timestepBuffer),
       _msReader(timestepBuffer->_msProvider->MakeReader()),
@@ -48,6 +50,36 @@ void TimestepBufferReader::WriteImagingWeights(const float* buffer) {
   _msReader->WriteImagingWeights(buffer);
 }
 
+size_t TimestepBufferReader::ReadBlock(size_t maxRows, RowBlock& block,
+                                       bool readData, bool readModel) {
+  block.Reserve(maxRows,
+                _msProvider->NChannels() * _msProvider->NPolarizations(),
+                readModel);
+  size_t row = 0;
+  // Copy directly from the buffered rows, one timestep at a time
+  while (row != maxRows && !_buffer.empty()) {
+    const size_t nCopy =
+        std::min(maxRows - row, _buffer.size() - _bufferPosition);
+    for (size_t i = 0; i != nCopy; ++i) {
+      const TimestepBuffer::RowData& rowData = _buffer[_bufferPosition + i];
+      block.SetMeta(row, rowData.metaData);
+      block.rowId[row] = rowData.rowId;
+      if (readData)
+        std::copy(rowData.data.begin(), rowData.data.end(), block.Data(row));
+      if (readModel)
+        std::copy(rowData.model.begin(), rowData.model.end(),
+                  block.Model(row));
+      std::copy(rowData.weights.begin(), rowData.weights.end(),
+                block.Weights(row));
+      ++row;
+    }
+    _bufferPosition += nCopy;
+    if (_bufferPosition == _buffer.size()) readTimeblock();
+  }
+  block.nRows = row;
+  return row;
+}
+
 void TimestepBufferReader::readTimeblock() {
   // Beware that the _msProvider data member is a TimestepBuffer,
   // which in turn has its own _msProvider
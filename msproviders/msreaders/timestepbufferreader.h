@@ -28,6 +28,9 @@ class TimestepBufferReader final : public MSReader {
 
   void WriteImagingWeights(const float* buffer) final override;
 
+  size_t ReadBlock(size_t maxRows, RowBlock& block, bool readData = true,
+                   bool readModel = false) final override;
+
   /**
    * Returns an Array containing the uvws for baselines (antenna1, antenna2)
    * that have antenna1=0, sorted by antenna2.
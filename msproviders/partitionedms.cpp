@@ -5,18 +5,30 @@
 #include "directmsrowprovider.h"
 #include "msrowprovider.h"
 #include "noisemsrowprovider.h"
+#include "reducedprecision.h"
 
 #include "../main/progressbar.h"
 #include "../main/settings.h"
+#include "../system/cachekey.h"
+#include "../system/spsc_ring.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <exception>
 #include <fstream>
+#include <limits>
+#include <mutex>
 #include <sstream>
 #include <memory>
+#include <thread>
 #include <vector>
 
+#include <aocommon/lane.h>
 #include <aocommon/logger.h>
+#include <aocommon/io/serialostream.h>
 
+#include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 
 #include <casacore/measures/Measures/MEpoch.h>
@@ -24,6 +36,9 @@
 #include <casacore/measures/TableMeasures/ScalarMeasColumn.h>
 
 using aocommon::Logger;
+using wsclean::system::HashToString;
+using wsclean::system::MSFingerprint;
+using wsclean::system::ReadFileContents;
 
 /**
  * MAP_NORESERVE is unsuported AND not defined on hurd-i386, so
@@ -39,6 +54,59 @@ struct PartitionFiles {
   std::unique_ptr<std::ofstream> weight;
   std::unique_ptr<std::ofstream> model;
 };
+
+/**
+ * A batch of consecutive rows that is passed through the reordering pipeline
+ * of PartitionedMS::Partition(). The reading thread fills the input arrays, a
+ * worker thread converts these into one output buffer per part file, and the
+ * writer threads write the output buffers to the part files.
+ */
+struct ReorderBatch {
+  size_t nRows = 0;
+  // All rows of a batch belong to the same output interval.
+  size_t intervalIndex = 0;
+  std::vector<uint32_t> dataDescIds;
+  std::vector<casacore::Array<std::complex<float>>> data;
+  std::vector<casacore::Array<std::complex<float>>> model;
+  std::vector<casacore::Array<float>> weights;
+  std::vector<casacore::Array<bool>> flags;
+  // Indexed by file index: the rows of this batch for that part file.
+  std::vector<aocommon::UVector<std::complex<float>>> dataOut;
+  std::vector<aocommon::UVector<std::complex<float>>> modelOut;
+  std::vector<aocommon::UVector<float>> weightOut;
+  // When compressing, the bfloat16 encoded dataOut and weightOut buffers.
+  std::vector<aocommon::UVector<char>> encodedDataOut;
+  std::vector<aocommon::UVector<char>> encodedWeightOut;
+  // Number of writer threads that have not yet written this batch.
+  std::atomic<size_t> pendingWriters{0};
+};
+
+// Approximate number of output bytes per reorder batch, and the maximum
+// number of rows in a batch.
+constexpr size_t kReorderBatchSize = 8 * 1024 * 1024;
+constexpr size_t kMaxReorderBatchRowCount = 1024;
+
+/**
+ * Writes the part of a temporary filename that identifies the output interval.
+ */
+void WriteIntervalIndex(std::ostream& stream, size_t intervalIndex) {
+  stream << "-t";
+  if (intervalIndex < 1000) stream << '0';
+  if (intervalIndex < 100) stream << '0';
+  if (intervalIndex < 10) stream << '0';
+  stream << intervalIndex;
+}
+
+/**
+ * Exchanges the contents of two casacore arrays without copying the values.
+ */
+template <typename T>
+void SwapArrays(casacore::Array<T>& a, casacore::Array<T>& b) {
+  casacore::Array<T> tmp;
+  tmp.reference(a);
+  a.reference(b);
+  b.reference(tmp);
+}
 }  // namespace
 
 PartitionedMS::PartitionedMS(const Handle& handle, size_t partIndex,
@@ -51,17 +119,19 @@ PartitionedMS::PartitionedMS(const Handle& handle, size_t partIndex,
       _polarization(polarization),
       _polarizationCountInFile(
           aocommon::Polarization::GetVisibilityCount(_polarization)) {
-  std::ifstream metaFile(getMetaFilename(
-      handle._data->_msPath, handle._data->_temporaryDirectory, dataDescId));
+  std::ifstream metaFile(getMetaFilename(handle._data->_msPath,
+                                         handle._data->_intervalIndex,
+                                         handle._data->_temporaryDirectory,
+                                         dataDescId));
 
   _metaHeader.Read(metaFile);
   std::vector<char> msPath(_metaHeader.filenameLength + 1, char(0));
   metaFile.read(msPath.data(), _metaHeader.filenameLength);
   Logger::Info << "Opening reordered part " << partIndex << " spw "
                << dataDescId << " for " << msPath.data() << '\n';
-  std::string partPrefix =
-      getPartPrefix(msPath.data(), partIndex, polarization, dataDescId,
-                    handle._data->_temporaryDirectory);
+  std::string partPrefix = getPartPrefix(
+      msPath.data(), handle._data->_intervalIndex, partIndex, polarization,
+      dataDescId, handle._data->_temporaryDirectory);
 
   std::ifstream dataFile(partPrefix + ".tmp", std::ios::in);
   if (!dataFile.good())
@@ -136,14 +206,16 @@ std::string PartitionedMS::getFilenamePrefix(const std::string& msPathStr,
 }
 
 std::string PartitionedMS::getPartPrefix(const std::string& msPathStr,
-                                         size_t partIndex,
+                                         size_t intervalIndex, size_t partIndex,
                                          aocommon::PolarizationEnum pol,
                                          size_t dataDescId,
                                          const std::string& tempDir) {
   std::string prefix = getFilenamePrefix(msPathStr, tempDir);
 
   std::ostringstream partPrefix;
-  partPrefix << prefix << "-part";
+  partPrefix << prefix;
+  WriteIntervalIndex(partPrefix, intervalIndex);
+  partPrefix << "-part";
   if (partIndex < 1000) partPrefix << '0';
   if (partIndex < 100) partPrefix << '0';
   if (partIndex < 10) partPrefix << '0';
@@ -155,15 +227,23 @@ std::string PartitionedMS::getPartPrefix(const std::string& msPathStr,
 }
 
 string PartitionedMS::getMetaFilename(const string& msPathStr,
+                                      size_t intervalIndex,
                                       const std::string& tempDir,
                                       size_t dataDescId) {
   std::string prefix = getFilenamePrefix(msPathStr, tempDir);
 
   std::ostringstream s;
-  s << prefix << "-spw" << dataDescId << "-parted-meta.tmp";
+  s << prefix;
+  WriteIntervalIndex(s, intervalIndex);
+  s << "-spw" << dataDescId << "-parted-meta.tmp";
   return s.str();
 }
 
+std::string PartitionedMS::getCacheKeyFilename(
+    const std::string& cacheDirectory) {
+  return (boost::filesystem::path(cacheDirectory) / "reorder-key.tmp").string();
+}
+
 /*
  * When partitioned:
  * One global file stores:
@@ -179,11 +259,19 @@ string PartitionedMS::getMetaFilename(const string& msPathStr,
  * - Weights (single)
  * - Model, optionally
  */
-PartitionedMS::Handle PartitionedMS::Partition(
+std::vector<PartitionedMS::Handle> PartitionedMS::Partition(
     const string& msPath, const std::vector<ChannelRange>& channels,
-    MSSelection& selection, const string& dataColumnName, bool includeModel,
-    bool initialModelRequired, const Settings& settings) {
+    const std::vector<MSSelection>& intervalSelections,
+    const string& dataColumnName, bool includeModel, bool initialModelRequired,
+    const Settings& settings) {
   const bool modelUpdateRequired = settings.modelUpdateRequired;
+  const size_t nIntervals = intervalSelections.size();
+  // The rows of all intervals are read with a single selection that spans
+  // the intervals.
+  MSSelection selection(intervalSelections.front());
+  if (nIntervals != 1)
+    selection.SetInterval(intervalSelections.front().IntervalStart(),
+                          intervalSelections.back().IntervalEnd());
   std::set<aocommon::PolarizationEnum> polsOut;
   if (settings.useIDG) {
     if (settings.polarizations.size() == 1) {
@@ -196,7 +284,59 @@ PartitionedMS::Handle PartitionedMS::Partition(
   }
   const size_t polarizationsPerFile =
       aocommon::Polarization::GetVisibilityCount(*polsOut.begin());
-  const std::string& temporaryDirectory = settings.temporaryDirectory;
+  std::string temporaryDirectory = settings.temporaryDirectory;
+
+  // The reorder cache is keyed on everything that determines the contents of
+  // the data, weight and meta files. The model can not be cached, because it
+  // changes during imaging, and neither can simulated noise.
+  std::string cacheKey;
+  if (settings.reorderCache) {
+    if (initialModelRequired || settings.simulateNoise) {
+      Logger::Info << "Not using the reorder cache for " << msPath
+                   << ", because the model data or simulated noise is "
+                      "reordered.\n";
+    } else {
+      aocommon::SerialOStream keyStream;
+      keyStream.UInt64(PartHeader::BINARY_SIZE)
+          .UInt64(MetaRecord::BINARY_SIZE)
+          .String(boost::filesystem::canonical(msPath).string())
+          .String(dataColumnName)
+          .UInt64(channels.size());
+      for (const ChannelRange& range : channels) {
+        keyStream.UInt64(range.dataDescId)
+            .UInt64(range.start)
+            .UInt64(range.end);
+      }
+      keyStream.UInt64(polsOut.size());
+      for (aocommon::PolarizationEnum p : polsOut) keyStream.UInt32(p);
+      keyStream.UInt64(nIntervals);
+      for (const MSSelection& intervalSelection : intervalSelections)
+        intervalSelection.Serialize(keyStream);
+      keyStream.Bool(includeModel)
+          .Bool(settings.compressReordering)
+          .Double(settings.baselineDependentAveragingInWavelengths);
+      cacheKey.assign(reinterpret_cast<const char*>(keyStream.data()),
+                      keyStream.size());
+
+      temporaryDirectory =
+          getFilenamePrefix(msPath, settings.temporaryDirectory) +
+          "-reorder-cache-" + HashToString(cacheKey);
+      const std::string keyFilename = getCacheKeyFilename(temporaryDirectory);
+      if (ReadFileContents(keyFilename) == cacheKey + MSFingerprint(msPath)) {
+        Logger::Info << "Reusing reordered files of " << msPath << " from "
+                     << temporaryDirectory << ".\n";
+        std::vector<Handle> handles = openCachedPartition(
+            msPath, channels, intervalSelections, dataColumnName, includeModel,
+            modelUpdateRequired, polsOut, temporaryDirectory);
+        for (Handle& handle : handles) handle._data->_cacheKey = cacheKey;
+        return handles;
+      }
+      // The key file is written once reordering has finished, so that an
+      // interrupted run does not leave behind a cache that seems valid.
+      boost::filesystem::create_directories(temporaryDirectory);
+      boost::filesystem::remove(keyFilename);
+    }
+  }
 
   const size_t channelParts = channels.size();
 
@@ -212,27 +352,7 @@ PartitionedMS::Handle PartitionedMS::Partition(
   // meta file because they can have different uvws and other info
   std::map<size_t, size_t> selectedDataDescIds;
   getDataDescIdMap(selectedDataDescIds, channels);
-
-  // Ordered as files[pol x channelpart]
-  std::vector<PartitionFiles> files(channelParts * polsOut.size());
-
-  size_t fileIndex = 0, maxChannels = 0;
-  for (size_t part = 0; part != channelParts; ++part) {
-    maxChannels =
-        std::max(maxChannels, channels[part].end - channels[part].start);
-    for (aocommon::PolarizationEnum p : polsOut) {
-      PartitionFiles& f = files[fileIndex];
-      std::string partPrefix = getPartPrefix(
-          msPath, part, p, channels[part].dataDescId, temporaryDirectory);
-      f.data.reset(new std::ofstream(partPrefix + ".tmp"));
-      f.weight.reset(new std::ofstream(partPrefix + "-w.tmp"));
-      if (initialModelRequired)
-        f.model.reset(new std::ofstream(partPrefix + "-m.tmp"));
-      f.data->seekp(PartHeader::BINARY_SIZE, std::ios::beg);
-
-      ++fileIndex;
-    }
-  }
+  const size_t nSpws = selectedDataDescIds.size();
 
   std::unique_ptr<MsRowProviderBase> rowProvider;
   if (settings.baselineDependentAveragingInWavelengths == 0.0) {
@@ -255,6 +375,10 @@ PartitionedMS::Handle PartitionedMS::Partition(
           "Baseline-dependent averaging is enabled together with a mode that "
           "requires the model data (e.g. -continue or -subtract-model). This "
           "is not possible.");
+    if (nIntervals != 1)
+      throw std::runtime_error(
+          "Baseline-dependent averaging can not be combined with reordering "
+          "multiple intervals at once.");
     rowProvider.reset(new AveragingMSRowProvider(
         settings.baselineDependentAveragingInWavelengths, msPath, selection,
         selectedDataDescIds, settings.fieldIds[0], dataColumnName,
@@ -266,184 +390,511 @@ PartitionedMS::Handle PartitionedMS::Partition(
   const size_t nAntennas = rowProvider->Ms().antenna().nrow();
   const aocommon::MultiBandData bands(rowProvider->Ms());
 
-  if (settings.parallelReordering == 1)
-    Logger::Info << "Reordering " << msPath << " into " << channelParts << " x "
-                 << polsOut.size() << " parts.\n";
-
-  // Write header of meta file, one meta file for each data desc id
-  // TODO rather than writing we can just skip and write later
-  std::vector<std::unique_ptr<std::ofstream>> metaFiles(
-      selectedDataDescIds.size());
-  for (const std::pair<const size_t, size_t>& p : selectedDataDescIds) {
-    const size_t dataDescId = p.first;
-    const size_t spwIndex = p.second;
-    std::string metaFilename =
-        getMetaFilename(msPath, temporaryDirectory, dataDescId);
-    metaFiles[spwIndex].reset(new std::ofstream(metaFilename));
-    MetaHeader metaHeader;
-    metaHeader.selectedRowCount = 0;  // not yet known
-    metaHeader.filenameLength = msPath.size();
-    metaHeader.startTime = rowProvider->StartTime();
-    metaHeader.Write(*metaFiles[spwIndex]);
-    metaFiles[spwIndex]->write(msPath.c_str(), msPath.size());
-    if (!metaFiles[spwIndex]->good())
-      throw std::runtime_error("Error writing to temporary file " +
-                               metaFilename);
+  // Determine the TIME value and start time of the first timestep of each
+  // interval. Timesteps are counted from the first row, as in GetRowRange().
+  // The rows are assigned to intervals by their time, which requires the
+  // measurement set to be ordered in time. Intervals that start beyond the
+  // selected rows stay empty.
+  std::vector<double> intervalStartTimes(
+      nIntervals, std::numeric_limits<double>::infinity());
+  std::vector<double> intervalEpochs(nIntervals, rowProvider->StartTime());
+  if (nIntervals != 1) {
+    MsColumns& columns = rowProvider->Columns();
+    size_t interval = 1;
+    size_t timestep = 0;
+    double time = columns.time(0);
+    for (size_t row = 0; row != rowProvider->EndRow() && interval != nIntervals;
+         ++row) {
+      if (time != columns.time(row)) {
+        ++timestep;
+        time = columns.time(row);
+        if (timestep == intervalSelections[interval].IntervalStart()) {
+          intervalStartTimes[interval] = time;
+          intervalEpochs[interval] =
+              columns.epoch_as_time(row).getValue().get();
+          ++interval;
+        }
+      }
+    }
+  }
+  auto findInterval = [&](double time) -> size_t {
+    return std::upper_bound(intervalStartTimes.begin() + 1,
+                            intervalStartTimes.end(), time) -
+           (intervalStartTimes.begin() + 1);
+  };
+
+  if (settings.parallelReordering == 1) {
+    Logger::Info << "Reordering " << msPath << " into ";
+    if (nIntervals != 1) Logger::Info << nIntervals << " x ";
+    Logger::Info << channelParts << " x " << polsOut.size() << " parts.\n";
   }
 
-  // Write actual data
-  std::vector<std::complex<float>> dataBuffer(polarizationsPerFile *
-                                              maxChannels);
-  std::vector<float> weightBuffer(polarizationsPerFile * maxChannels);
-
-  casacore::Array<std::complex<float>> dataArray;
-  casacore::Array<std::complex<float>> modelArray;
-  casacore::Array<float> weightSpectrumArray;
-  casacore::Array<bool> flagArray;
+  // The meta files of the interval that is being read, one meta file for
+  // each data desc id. The header is rewritten once the number of rows is
+  // known.
+  size_t metaInterval = 0;
+  std::vector<std::unique_ptr<std::ofstream>> metaFiles(nSpws);
+  // Indexed by [interval x spwIndex]
+  aocommon::UVector<size_t> selectedRowCounts(nIntervals * nSpws, 0);
+  auto writeMetaHeaders = [&](size_t interval) {
+    for (const std::pair<const size_t, size_t>& p : selectedDataDescIds) {
+      const size_t spwIndex = p.second;
+      std::ofstream& metaFile = *metaFiles[spwIndex];
+      MetaHeader metaHeader;
+      metaHeader.selectedRowCount =
+          selectedRowCounts[interval * nSpws + spwIndex];
+      metaHeader.filenameLength = msPath.size();
+      metaHeader.startTime = intervalEpochs[interval];
+      metaFile.seekp(0);
+      metaHeader.Write(metaFile);
+      metaFile.write(msPath.c_str(), msPath.size());
+      if (!metaFile.good())
+        throw std::runtime_error("Error writing to temporary meta file of " +
+                                 msPath);
+    }
+  };
+  auto openMetaFiles = [&](size_t interval) {
+    for (const std::pair<const size_t, size_t>& p : selectedDataDescIds) {
+      metaFiles[p.second].reset(new std::ofstream(
+          getMetaFilename(msPath, interval, temporaryDirectory, p.first)));
+    }
+    writeMetaHeaders(interval);
+  };
+  // Finishes the meta files of the current interval, and creates those of the
+  // intervals up to @p interval, which have no rows.
+  auto advanceMetaInterval = [&](size_t interval) {
+    while (metaInterval != interval) {
+      writeMetaHeaders(metaInterval);
+      ++metaInterval;
+      if (metaInterval != nIntervals) openMetaFiles(metaInterval);
+    }
+  };
+  openMetaFiles(0);
+
+  // Write actual data. This is pipelined: this thread reads the rows in
+  // batches and writes the meta data, worker threads convert the batches to
+  // the requested polarizations and channel ranges, and writer threads write
+  // the results to the part files. Batches are distributed round-robin over
+  // the workers and collected round-robin by the writers, which keeps them in
+  // order.
+  const std::vector<aocommon::PolarizationEnum> polList(polsOut.begin(),
+                                                        polsOut.end());
+  // Ordered as files[pol x channelpart]. Each writer thread opens its files
+  // for an interval when it receives the first batch of that interval.
+  const size_t nFiles = channelParts * polsOut.size();
+  std::vector<PartitionFiles> files(nFiles);
+  std::vector<size_t> fileIntervals(nFiles, nIntervals);
+  std::vector<size_t> fileRowSizes;
+  size_t outputRowSize = 0, maxChannels = 0;
+  for (size_t part = 0; part != channelParts; ++part) {
+    maxChannels =
+        std::max(maxChannels, channels[part].end - channels[part].start);
+    const size_t partRowSize =
+        (channels[part].end - channels[part].start) * polarizationsPerFile;
+    for (size_t p = 0; p != polsOut.size(); ++p)
+      fileRowSizes.emplace_back(partRowSize);
+    outputRowSize +=
+        partRowSize * polsOut.size() *
+        (sizeof(float) +
+         sizeof(std::complex<float>) * (initialModelRequired ? 2 : 1));
+  }
+  const size_t batchRowCount =
+      std::clamp(kReorderBatchSize / std::max<size_t>(outputRowSize, 1),
+                 size_t(1), kMaxReorderBatchRowCount);
+  const size_t parallelReordering =
+      std::max<size_t>(settings.parallelReordering, 1);
+  const size_t nWorkers =
+      std::max<size_t>(1, settings.threadCount / parallelReordering);
+  const size_t nWriters = std::max<size_t>(1, std::min(nFiles, nWorkers));
+  Logger::Debug << "Reordering with " << nWorkers << " worker and "
+                << nWriters << " writer threads, " << batchRowCount
+                << " rows per batch.\n";
+
+  // Limiting the number of batches limits the memory used by the pipeline.
+  std::vector<std::unique_ptr<ReorderBatch>> batches(nWorkers * 2 + nWriters);
+  aocommon::Lane<ReorderBatch*> freeBatches(batches.size());
+  for (std::unique_ptr<ReorderBatch>& batch : batches) {
+    batch.reset(new ReorderBatch());
+    batch->dataDescIds.resize(batchRowCount);
+    batch->data.resize(batchRowCount);
+    if (initialModelRequired) batch->model.resize(batchRowCount);
+    batch->weights.resize(batchRowCount);
+    batch->flags.resize(batchRowCount);
+    batch->dataOut.resize(nFiles);
+    if (initialModelRequired) batch->modelOut.resize(nFiles);
+    batch->weightOut.resize(nFiles);
+    if (settings.compressReordering) {
+      batch->encodedDataOut.resize(nFiles);
+      batch->encodedWeightOut.resize(nFiles);
+    }
+    freeBatches.write(batch.get());
+  }
+  std::vector<spsc_ring<ReorderBatch*>> workerLanes(nWorkers);
+  for (spsc_ring<ReorderBatch*>& lane : workerLanes) lane.resize(2);
+  // Indexed by [worker x writer]
+  std::vector<spsc_ring<ReorderBatch*>> writerLanes(nWorkers * nWriters);
+  for (spsc_ring<ReorderBatch*>& lane : writerLanes)
+    lane.resize(batches.size());
+
+  std::mutex errorMutex;
+  std::exception_ptr pipelineError;
+  std::atomic<bool> hasFailed(false);
+  auto setError = [&](std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (!pipelineError) pipelineError = error;
+    hasFailed = true;
+  };
+
+  auto convertBatch = [&](ReorderBatch& batch) {
+    for (size_t i = 0; i != nFiles; ++i) {
+      batch.dataOut[i].clear();
+      batch.dataOut[i].reserve(batchRowCount * fileRowSizes[i]);
+      if (initialModelRequired) {
+        batch.modelOut[i].clear();
+        batch.modelOut[i].reserve(batchRowCount * fileRowSizes[i]);
+      }
+      batch.weightOut[i].clear();
+      batch.weightOut[i].reserve(batchRowCount * fileRowSizes[i]);
+    }
+    for (size_t row = 0; row != batch.nRows; ++row) {
+      size_t fileIndex = 0;
+      for (size_t part = 0; part != channelParts; ++part) {
+        if (channels[part].dataDescId == int(batch.dataDescIds[row])) {
+          const size_t partStartCh = channels[part].start;
+          const size_t partEndCh = channels[part].end;
+
+          for (aocommon::PolarizationEnum p : polsOut) {
+            const size_t offset = batch.dataOut[fileIndex].size();
+            const size_t newSize = offset + fileRowSizes[fileIndex];
+            batch.dataOut[fileIndex].resize(newSize);
+            CopyData(&batch.dataOut[fileIndex][offset], partStartCh, partEndCh,
+                     msPolarizations, batch.data[row], p);
+            if (initialModelRequired) {
+              batch.modelOut[fileIndex].resize(newSize);
+              CopyData(&batch.modelOut[fileIndex][offset], partStartCh,
+                       partEndCh, msPolarizations, batch.model[row], p);
+            }
+            batch.weightOut[fileIndex].resize(newSize);
+            CopyWeights(&batch.weightOut[fileIndex][offset], partStartCh,
+                        partEndCh, msPolarizations, batch.data[row],
+                        batch.weights[row], batch.flags[row], p);
+            ++fileIndex;
+          }
+        } else {
+          fileIndex += polsOut.size();
+        }
+      }
+    }
+    if (settings.compressReordering) {
+      for (size_t i = 0; i != nFiles; ++i) {
+        const size_t nDataValues = batch.dataOut[i].size() * 2;
+        batch.encodedDataOut[i].resize(nDataValues * sizeof(uint16_t));
+        reduced_precision::Encode(
+            reinterpret_cast<const float*>(batch.dataOut[i].data()),
+            nDataValues, batch.encodedDataOut[i].data());
+        const size_t nWeights = batch.weightOut[i].size();
+        batch.encodedWeightOut[i].resize(nWeights * sizeof(uint16_t));
+        reduced_precision::Encode(batch.weightOut[i].data(), nWeights,
+                                  batch.encodedWeightOut[i].data());
+      }
+    }
+  };
+
+  // Opens the part files with index @p fileIndex of an interval and writes
+  // their header. Files that were open for the previous interval are closed.
+  auto openPartFiles = [&](size_t fileIndex, size_t interval) {
+    const size_t part = fileIndex / polsOut.size();
+    const std::string partPrefix = getPartPrefix(
+        msPath, interval, part, polList[fileIndex % polsOut.size()],
+        channels[part].dataDescId, temporaryDirectory);
+    PartitionFiles& f = files[fileIndex];
+    f.data.reset(new std::ofstream(partPrefix + ".tmp"));
+    f.weight.reset(new std::ofstream(partPrefix + "-w.tmp"));
+    if (initialModelRequired)
+      f.model.reset(new std::ofstream(partPrefix + "-m.tmp"));
+    PartHeader header;
+    header.hasModel = includeModel;
+    header.isCompressed = settings.compressReordering;
+    header.channelStart = channels[part].start;
+    header.channelCount = channels[part].end - channels[part].start;
+    header.dataDescId = channels[part].dataDescId;
+    header.Write(*f.data);
+    if (!f.data->good())
+      throw std::runtime_error("Error writing to temporary data file " +
+                               partPrefix + ".tmp");
+    fileIntervals[fileIndex] = interval;
+  };
+
+  auto writeBatch = [&](const ReorderBatch& batch, size_t fileIndex) {
+    if (fileIntervals[fileIndex] != batch.intervalIndex)
+      openPartFiles(fileIndex, batch.intervalIndex);
+    PartitionFiles& f = files[fileIndex];
+    if (settings.compressReordering)
+      f.data->write(batch.encodedDataOut[fileIndex].data(),
+                    batch.encodedDataOut[fileIndex].size());
+    else
+      f.data->write(
+          reinterpret_cast<const char*>(batch.dataOut[fileIndex].data()),
+          batch.dataOut[fileIndex].size() * sizeof(std::complex<float>));
+    if (!f.data->good())
+      throw std::runtime_error("Error writing to temporary data file");
+    if (initialModelRequired) {
+      f.model->write(
+          reinterpret_cast<const char*>(batch.modelOut[fileIndex].data()),
+          batch.modelOut[fileIndex].size() * sizeof(std::complex<float>));
+      if (!f.model->good())
+        throw std::runtime_error("Error writing to temporary model data file");
+    }
+    if (settings.compressReordering)
+      f.weight->write(batch.encodedWeightOut[fileIndex].data(),
+                      batch.encodedWeightOut[fileIndex].size());
+    else
+      f.weight->write(
+          reinterpret_cast<const char*>(batch.weightOut[fileIndex].data()),
+          batch.weightOut[fileIndex].size() * sizeof(float));
+    if (!f.weight->good())
+      throw std::runtime_error("Error writing to temporary weights file");
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t worker = 0; worker != nWorkers; ++worker) {
+    threads.emplace_back([&, worker]() {
+      ReorderBatch* batch;
+      while (workerLanes[worker].read(batch)) {
+        if (!hasFailed) {
+          try {
+            convertBatch(*batch);
+          } catch (...) {
+            setError(std::current_exception());
+          }
+        }
+        batch->pendingWriters = nWriters;
+        for (size_t writer = 0; writer != nWriters; ++writer)
+          writerLanes[worker * nWriters + writer].write(batch);
+      }
+      for (size_t writer = 0; writer != nWriters; ++writer)
+        writerLanes[worker * nWriters + writer].write_end();
+    });
+  }
+  for (size_t writer = 0; writer != nWriters; ++writer) {
+    threads.emplace_back([&, writer]() {
+      ReorderBatch* batch;
+      size_t worker = 0;
+      while (writerLanes[worker * nWriters + writer].read(batch)) {
+        if (!hasFailed) {
+          try {
+            for (size_t i = writer; i < nFiles; i += nWriters)
+              writeBatch(*batch, i);
+          } catch (...) {
+            setError(std::current_exception());
+          }
+        }
+        if (--batch->pendingWriters == 0) freeBatches.write(batch);
+        worker = (worker + 1) % nWorkers;
+      }
+    });
+  }
 
   std::unique_ptr<ProgressBar> progress1;
   if (settings.parallelReordering == 1)
     progress1.reset(new ProgressBar("Reordering"));
 
   size_t selectedRowsTotal = 0;
-  aocommon::UVector<size_t> selectedRowCountPerSpwIndex(
-      selectedDataDescIds.size(), 0);
-  while (!rowProvider->AtEnd()) {
-    if (progress1)
-      progress1->SetProgress(rowProvider->CurrentProgress(),
-                             rowProvider->TotalProgress());
-
-    MetaRecord meta;
-
-    double time;
-    uint32_t dataDescId, antenna1, antenna2, fieldId;
-    rowProvider->ReadData(dataArray, flagArray, weightSpectrumArray, meta.u,
-                          meta.v, meta.w, dataDescId, antenna1, antenna2,
-                          fieldId, time);
-    meta.antenna1 = antenna1;
-    meta.antenna2 = antenna2;
-    meta.fieldId = fieldId;
-    meta.time = time;
-    const size_t spwIndex = selectedDataDescIds[dataDescId];
-    ++selectedRowCountPerSpwIndex[spwIndex];
-    ++selectedRowsTotal;
-    std::ofstream& metaFile = *metaFiles[spwIndex];
-    meta.Write(metaFile);
-    if (!metaFile.good())
-      throw std::runtime_error("Error writing to temporary file");
-
-    if (initialModelRequired) rowProvider->ReadModel(modelArray);
-
-    fileIndex = 0;
-    for (size_t part = 0; part != channelParts; ++part) {
-      if (channels[part].dataDescId == int(dataDescId)) {
-        const size_t partStartCh = channels[part].start;
-        const size_t partEndCh = channels[part].end;
-
-        for (aocommon::PolarizationEnum p : polsOut) {
-          PartitionFiles& f = files[fileIndex];
-          CopyData(dataBuffer.data(), partStartCh, partEndCh, msPolarizations,
-                   dataArray, p);
-          f.data->write(reinterpret_cast<char*>(dataBuffer.data()),
-                        (partEndCh - partStartCh) *
-                            sizeof(std::complex<float>) * polarizationsPerFile);
-          if (!f.data->good())
-            throw std::runtime_error("Error writing to temporary data file");
-
-          if (initialModelRequired) {
-            CopyData(dataBuffer.data(), partStartCh, partEndCh, msPolarizations,
-                     modelArray, p);
-            f.model->write(reinterpret_cast<char*>(dataBuffer.data()),
-                           (partEndCh - partStartCh) *
-                               sizeof(std::complex<float>) *
-                               polarizationsPerFile);
-            if (!f.model->good())
-              throw std::runtime_error(
-                  "Error writing to temporary model data file");
-          }
-
-          CopyWeights(weightBuffer.data(), partStartCh, partEndCh,
-                      msPolarizations, dataArray, weightSpectrumArray,
-                      flagArray, p);
-          f.weight->write(
-              reinterpret_cast<char*>(weightBuffer.data()),
-              (partEndCh - partStartCh) * sizeof(float) * polarizationsPerFile);
-          if (!f.weight->good())
-            throw std::runtime_error("Error writing to temporary weights file");
-          ++fileIndex;
+  try {
+    size_t batchIndex = 0;
+    ReorderBatch* batch = nullptr;
+    while (!rowProvider->AtEnd() && !hasFailed) {
+      if (!batch) {
+        freeBatches.read(batch);
+        batch->nRows = 0;
+        batch->intervalIndex = metaInterval;
+      }
+      if (progress1)
+        progress1->SetProgress(rowProvider->CurrentProgress(),
+                               rowProvider->TotalProgress());
+
+      size_t row = batch->nRows;
+      MetaRecord meta;
+
+      double time;
+      uint32_t dataDescId, antenna1, antenna2, fieldId;
+      rowProvider->ReadData(batch->data[row], batch->flags[row],
+                            batch->weights[row], meta.u, meta.v, meta.w,
+                            dataDescId, antenna1, antenna2, fieldId, time);
+      const size_t interval = findInterval(time);
+      if (interval != metaInterval) {
+        if (interval < metaInterval)
+          throw std::runtime_error(
+              "The rows of " + msPath +
+              " are not ordered in time, which is required for imaging "
+              "multiple intervals.");
+        advanceMetaInterval(interval);
+        // A batch does not span multiple intervals: the row is moved to a
+        // new batch.
+        if (row != 0) {
+          ReorderBatch* next;
+          freeBatches.read(next);
+          SwapArrays(next->data[0], batch->data[row]);
+          SwapArrays(next->flags[0], batch->flags[row]);
+          SwapArrays(next->weights[0], batch->weights[row]);
+          workerLanes[batchIndex % nWorkers].write(batch);
+          ++batchIndex;
+          batch = next;
+          batch->nRows = 0;
+          row = 0;
         }
-      } else {
-        fileIndex += polsOut.size();
+        batch->intervalIndex = interval;
+      }
+      meta.antenna1 = antenna1;
+      meta.antenna2 = antenna2;
+      meta.fieldId = fieldId;
+      meta.time = time;
+      batch->dataDescIds[row] = dataDescId;
+      const size_t spwIndex = selectedDataDescIds[dataDescId];
+      ++selectedRowCounts[interval * nSpws + spwIndex];
+      ++selectedRowsTotal;
+      std::ofstream& metaFile = *metaFiles[spwIndex];
+      meta.Write(metaFile);
+      if (!metaFile.good())
+        throw std::runtime_error("Error writing to temporary file");
+
+      if (initialModelRequired) rowProvider->ReadModel(batch->model[row]);
+
+      ++batch->nRows;
+      rowProvider->NextRow();
+      if (batch->nRows == batchRowCount || rowProvider->AtEnd()) {
+        workerLanes[batchIndex % nWorkers].write(batch);
+        ++batchIndex;
+        batch = nullptr;
       }
     }
-
-    rowProvider->NextRow();
+    if (!hasFailed) advanceMetaInterval(nIntervals);
+  } catch (...) {
+    setError(std::current_exception());
   }
+  for (spsc_ring<ReorderBatch*>& lane : workerLanes) lane.write_end();
+  for (std::thread& thread : threads) thread.join();
+  if (pipelineError) std::rethrow_exception(pipelineError);
+  metaFiles.clear();
+
   progress1.reset();
   Logger::Debug << "Total selected rows: " << selectedRowsTotal << '\n';
   rowProvider->OutputStatistics();
 
-  // Rewrite meta headers to include selected row count
-  for (std::pair<const size_t, size_t>& p : selectedDataDescIds) {
-    size_t spwIndex = p.second;
-    MetaHeader metaHeader;
-    metaHeader.selectedRowCount = selectedRowCountPerSpwIndex[spwIndex];
-    metaHeader.filenameLength = msPath.size();
-    metaHeader.startTime = rowProvider->StartTime();
-    metaFiles[spwIndex]->seekp(0);
-    metaHeader.Write(*metaFiles[spwIndex]);
-    metaFiles[spwIndex]->write(msPath.c_str(), msPath.size());
+  // Intervals without rows were not seen by the writers, but still need part
+  // files with a header.
+  for (size_t interval = 0; interval != nIntervals; ++interval) {
+    const size_t* counts = selectedRowCounts.data() + interval * nSpws;
+    if (std::all_of(counts, counts + nSpws, [](size_t n) { return n == 0; })) {
+      for (size_t fileIndex = 0; fileIndex != nFiles; ++fileIndex)
+        openPartFiles(fileIndex, interval);
+    }
   }
+  files.clear();
 
-  // Write header to parts and write empty model files (if requested)
-  PartHeader header;
-  header.hasModel = includeModel;
-  fileIndex = 0;
-  dataBuffer.assign(maxChannels * polarizationsPerFile, 0.0);
+  // Write empty model files (if requested)
+  const std::vector<std::complex<float>> dataBuffer(
+      maxChannels * polarizationsPerFile, 0.0);
   std::unique_ptr<ProgressBar> progress2;
   if (includeModel && !initialModelRequired && settings.parallelReordering == 1)
     progress2.reset(new ProgressBar("Initializing model visibilities"));
-  for (size_t part = 0; part != channelParts; ++part) {
-    header.channelStart = channels[part].start,
-    header.channelCount = channels[part].end - header.channelStart;
-    header.dataDescId = channels[part].dataDescId;
-    for (std::set<aocommon::PolarizationEnum>::const_iterator p =
-             polsOut.begin();
-         p != polsOut.end(); ++p) {
-      PartitionFiles& f = files[fileIndex];
-      f.data->seekp(0, std::ios::beg);
-      header.Write(*f.data);
-      if (!f.data->good())
-        throw std::runtime_error("Error writing to temporary data file");
-
-      f.data.reset();
-      f.weight.reset();
-      f.model.reset();
-      ++fileIndex;
-
-      // If model is requested, fill model file with zeros
-      if (includeModel && !initialModelRequired) {
-        std::string partPrefix = getPartPrefix(
-            msPath, part, *p, header.dataDescId, temporaryDirectory);
-        std::ofstream modelFile(partPrefix + "-m.tmp");
-        const size_t selectedRowCount = selectedRowCountPerSpwIndex
-            [selectedDataDescIds[channels[part].dataDescId]];
-        for (size_t i = 0; i != selectedRowCount; ++i) {
-          modelFile.write(reinterpret_cast<char*>(dataBuffer.data()),
-                          header.channelCount * sizeof(std::complex<float>) *
-                              polarizationsPerFile);
-          if (progress2)
-            progress2->SetProgress(part * selectedRowCount + i,
-                                   channelParts * selectedRowCount);
+  if (includeModel && !initialModelRequired) {
+    for (size_t interval = 0; interval != nIntervals; ++interval) {
+      for (size_t part = 0; part != channelParts; ++part) {
+        const size_t dataDescId = channels[part].dataDescId;
+        const size_t channelCount = channels[part].end - channels[part].start;
+        const size_t selectedRowCount =
+            selectedRowCounts[interval * nSpws +
+                              selectedDataDescIds[dataDescId]];
+        for (aocommon::PolarizationEnum p : polsOut) {
+          std::string partPrefix = getPartPrefix(
+              msPath, interval, part, p, dataDescId, temporaryDirectory);
+          std::ofstream modelFile(partPrefix + "-m.tmp");
+          for (size_t i = 0; i != selectedRowCount; ++i) {
+            modelFile.write(reinterpret_cast<const char*>(dataBuffer.data()),
+                            channelCount * sizeof(std::complex<float>) *
+                                polarizationsPerFile);
+          }
+          if (!modelFile.good())
+            throw std::runtime_error("Error writing to temporary model file");
         }
+        if (progress2)
+          progress2->SetProgress(interval * channelParts + part + 1,
+                                 nIntervals * channelParts);
       }
     }
   }
   progress2.reset();
 
-  return Handle(msPath, dataColumnName, temporaryDirectory, channels,
-                initialModelRequired, modelUpdateRequired, polsOut, selection,
-                bands, nAntennas);
+  if (!cacheKey.empty()) {
+    const std::string keyFilename = getCacheKeyFilename(temporaryDirectory);
+    std::ofstream keyFile(keyFilename, std::ios::binary);
+    keyFile << cacheKey << MSFingerprint(msPath);
+    if (!keyFile.good())
+      throw std::runtime_error("Error writing reorder cache key file " +
+                               keyFilename);
+  }
+
+  std::vector<Handle> handles;
+  handles.reserve(nIntervals);
+  for (size_t interval = 0; interval != nIntervals; ++interval) {
+    handles.emplace_back(msPath, dataColumnName, temporaryDirectory, interval,
+                         channels, initialModelRequired, modelUpdateRequired,
+                         polsOut, intervalSelections[interval], bands,
+                         nAntennas);
+    handles.back()._data->_cacheKey = cacheKey;
+  }
+  return handles;
+}
+
+std::vector<PartitionedMS::Handle> PartitionedMS::openCachedPartition(
+    const std::string& msPath, const std::vector<ChannelRange>& channels,
+    const std::vector<MSSelection>& intervalSelections,
+    const std::string& dataColumnName, bool includeModel,
+    bool modelUpdateRequired,
+    const std::set<aocommon::PolarizationEnum>& polarizations,
+    const std::string& cacheDirectory) {
+  casacore::MeasurementSet ms(msPath);
+  const size_t nAntennas = ms.antenna().nrow();
+  const aocommon::MultiBandData bands(ms);
+
+  std::vector<Handle> handles;
+  for (size_t interval = 0; interval != intervalSelections.size();
+       ++interval) {
+    // The model files are removed after every run, so need to be recreated
+    if (includeModel) {
+      const size_t polarizationsPerFile =
+          aocommon::Polarization::GetVisibilityCount(*polarizations.begin());
+      for (size_t part = 0; part != channels.size(); ++part) {
+        const size_t dataDescId = channels[part].dataDescId;
+        std::ifstream metaFile(
+            getMetaFilename(msPath, interval, cacheDirectory, dataDescId));
+        MetaHeader metaHeader;
+        metaHeader.Read(metaFile);
+        if (!metaFile.good())
+          throw std::runtime_error("Error reading cached meta file of " +
+                                   msPath);
+        const std::vector<std::complex<float>> zeroRow(
+            (channels[part].end - channels[part].start) * polarizationsPerFile,
+            0.0);
+        for (aocommon::PolarizationEnum p : polarizations) {
+          std::ofstream modelFile(getPartPrefix(msPath, interval, part, p,
+                                                dataDescId, cacheDirectory) +
+                                  "-m.tmp");
+          for (size_t i = 0; i != metaHeader.selectedRowCount; ++i)
+            modelFile.write(reinterpret_cast<const char*>(zeroRow.data()),
+                            zeroRow.size() * sizeof(std::complex<float>));
+          if (!modelFile.good())
+            throw std::runtime_error("Error writing to temporary model file");
+        }
+      }
+    }
+
+    handles.emplace_back(msPath, dataColumnName, cacheDirectory, interval,
+                         channels, false, modelUpdateRequired, polarizations,
+                         intervalSelections[interval], bands, nAntennas);
+  }
+  return handles;
 }
 
 void PartitionedMS::unpartition(
@@ -455,8 +906,10 @@ void PartitionedMS::unpartition(
 
   std::vector<MetaHeader> metaHeaders(dataDescIds.size());
   for (const std::pair<const size_t, size_t>& dataDescId : dataDescIds) {
-    std::ifstream metaFile(getMetaFilename(
-        handle._msPath, handle._temporaryDirectory, dataDescId.first));
+    std::ifstream metaFile(getMetaFilename(handle._msPath,
+                                           handle._intervalIndex,
+                                           handle._temporaryDirectory,
+                                           dataDescId.first));
     MetaHeader& metaHeader = metaHeaders[dataDescId.second];
     metaHeader.Read(metaFile);
     std::vector<char> msPath(metaHeader.filenameLength + 1, char(0));
@@ -465,8 +918,8 @@ void PartitionedMS::unpartition(
 
   ChannelRange firstRange = handle._channels[0];
   std::ifstream firstDataFile(
-      getPartPrefix(handle._msPath, 0, *pols.begin(), firstRange.dataDescId,
-                    handle._temporaryDirectory) +
+      getPartPrefix(handle._msPath, handle._intervalIndex, 0, *pols.begin(),
+                    firstRange.dataDescId, handle._temporaryDirectory) +
           ".tmp",
       std::ios::in);
   if (!firstDataFile.good())
@@ -488,8 +941,9 @@ void PartitionedMS::unpartition(
       for (std::set<aocommon::PolarizationEnum>::const_iterator p =
                pols.begin();
            p != pols.end(); ++p) {
-        std::string partPrefix = getPartPrefix(
-            handle._msPath, part, *p, dataDescId, handle._temporaryDirectory);
+        std::string partPrefix =
+            getPartPrefix(handle._msPath, handle._intervalIndex, part, *p,
+                          dataDescId, handle._temporaryDirectory);
         modelFiles[fileIndex].reset(new std::ifstream(partPrefix + "-m.tmp"));
         ++fileIndex;
       }
@@ -590,24 +1044,43 @@ void PartitionedMS::unpartition(
 
 PartitionedMS::Handle::HandleData::~HandleData() {
   if (!_isCopy) {
-    if (_modelUpdateRequired) PartitionedMS::unpartition(*this);
+    if (_modelUpdateRequired) {
+      // Writing the model back changes the measurement set. If the cache was
+      // still valid before that, it is updated such that the change does not
+      // invalidate it.
+      const std::string keyFilename =
+          _cacheKey.empty() ? std::string()
+                            : getCacheKeyFilename(_temporaryDirectory);
+      const bool isCacheValid =
+          !_cacheKey.empty() &&
+          ReadFileContents(keyFilename) == _cacheKey + MSFingerprint(_msPath);
+      PartitionedMS::unpartition(*this);
+      if (isCacheValid) {
+        std::ofstream keyFile(keyFilename, std::ios::binary);
+        keyFile << _cacheKey << MSFingerprint(_msPath);
+      }
+    }
 
     Logger::Info << "Cleaning up temporary files...\n";
 
+    const bool isCached = !_cacheKey.empty();
     std::set<size_t> removedMetaFiles;
     for (size_t part = 0; part != _channels.size(); ++part) {
       for (aocommon::PolarizationEnum p : _polarizations) {
-        std::string prefix = getPartPrefix(
-            _msPath, part, p, _channels[part].dataDescId, _temporaryDirectory);
-        std::remove((prefix + ".tmp").c_str());
-        std::remove((prefix + "-w.tmp").c_str());
+        std::string prefix =
+            getPartPrefix(_msPath, _intervalIndex, part, p,
+                          _channels[part].dataDescId, _temporaryDirectory);
+        if (!isCached) {
+          std::remove((prefix + ".tmp").c_str());
+          std::remove((prefix + "-w.tmp").c_str());
+        }
         std::remove((prefix + "-m.tmp").c_str());
       }
       size_t dataDescId = _channels[part].dataDescId;
-      if (removedMetaFiles.count(dataDescId) == 0) {
+      if (!isCached && removedMetaFiles.count(dataDescId) == 0) {
         removedMetaFiles.insert(dataDescId);
-        std::string metaFile =
-            getMetaFilename(_msPath, _temporaryDirectory, dataDescId);
+        std::string metaFile = getMetaFilename(_msPath, _intervalIndex,
+                                               _temporaryDirectory, dataDescId);
         std::remove(metaFile.c_str());
       }
     }
@@ -653,6 +1126,7 @@ void PartitionedMS::Handle::HandleData::Serialize(
   stream.String(_msPath)
       .String(_dataColumnName)
       .String(_temporaryDirectory)
+      .UInt64(_intervalIndex)
       .UInt64(_channels.size());
   for (const ChannelRange& range : _channels) {
     stream.UInt64(range.dataDescId).UInt64(range.start).UInt64(range.end);
@@ -669,6 +1143,7 @@ void PartitionedMS::Handle::HandleData::Unserialize(
     aocommon::SerialIStream& stream) {
   _isCopy = true;
   stream.String(_msPath).String(_dataColumnName).String(_temporaryDirectory);
+  stream.UInt64(_intervalIndex);
   _channels.resize(stream.UInt64());
   for (ChannelRange& range : _channels) {
     stream.UInt64(range.dataDescId).UInt64(range.start).UInt64(range.end);
@@ -14,9 +14,11 @@
 #include <casacore/tables/Tables/ArrayColumn.h>
 #include <casacore/tables/Tables/ScalarColumn.h>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
 
 class PartitionedMSReader;
 
@@ -76,12 +78,18 @@ class PartitionedMS final : public MSProvider {
 
   size_t DataDescId() override { return _partHeader.dataDescId; }
 
-  static Handle Partition(const string& msPath,
-                          const std::vector<ChannelRange>& channels,
-                          class MSSelection& selection,
-                          const string& dataColumnName, bool includeModel,
-                          bool initialModelRequired,
-                          const class Settings& settings);
+  /**
+   * Reorders the selected data of a measurement set into part files. All
+   * output intervals are reordered in a single pass over the measurement set.
+   * @param intervalSelections The selection of each output interval. These
+   * should be equal, except for their consecutive timestep intervals.
+   * @returns One handle for each interval.
+   */
+  static std::vector<Handle> Partition(
+      const string& msPath, const std::vector<ChannelRange>& channels,
+      const std::vector<MSSelection>& intervalSelections,
+      const string& dataColumnName, bool includeModel,
+      bool initialModelRequired, const class Settings& settings);
 
   const aocommon::BandData& Band() override {
     return _handle._data->_bands[_dataDescId];
@@ -105,7 +113,7 @@ class PartitionedMS final : public MSProvider {
       HandleData() : _isCopy(false) {}
 
       HandleData(const std::string& msPath, const string& dataColumnName,
-                 const std::string& temporaryDirectory,
+                 const std::string& temporaryDirectory, size_t intervalIndex,
                  const std::vector<ChannelRange>& channels,
                  bool initialModelRequired, bool modelUpdateRequired,
                  const std::set<aocommon::PolarizationEnum>& polarizations,
@@ -114,6 +122,7 @@ class PartitionedMS final : public MSProvider {
           : _msPath(msPath),
             _dataColumnName(dataColumnName),
             _temporaryDirectory(temporaryDirectory),
+            _intervalIndex(intervalIndex),
             _channels(channels),
             _initialModelRequired(initialModelRequired),
             _modelUpdateRequired(modelUpdateRequired),
@@ -126,6 +135,8 @@ class PartitionedMS final : public MSProvider {
       ~HandleData();
 
       std::string _msPath, _dataColumnName, _temporaryDirectory;
+      // Index of the output interval, which is part of the file names.
+      size_t _intervalIndex = 0;
       std::vector<ChannelRange> _channels;
       bool _initialModelRequired, _modelUpdateRequired;
       std::set<aocommon::PolarizationEnum> _polarizations;
@@ -133,6 +144,10 @@ class PartitionedMS final : public MSProvider {
       aocommon::MultiBandData _bands;
       size_t _nAntennas;
       bool _isCopy;
+      // Non-empty when the parts are stored in the reorder cache: in that
+      // case, _temporaryDirectory is the cache directory, and the data, weight
+      // and meta files are kept after use.
+      std::string _cacheKey;
 
       void Serialize(aocommon::SerialOStream& stream) const;
       void Unserialize(aocommon::SerialIStream& stream);
@@ -140,14 +155,14 @@ class PartitionedMS final : public MSProvider {
     std::shared_ptr<HandleData> _data;
 
     Handle(const std::string& msPath, const string& dataColumnName,
-           const std::string& temporaryDirectory,
+           const std::string& temporaryDirectory, size_t intervalIndex,
            const std::vector<ChannelRange>& channels, bool initialModelRequired,
            bool modelUpdateRequired,
            const std::set<aocommon::PolarizationEnum>& polarizations,
            const MSSelection& selection, const aocommon::MultiBandData& bands,
            size_t nAntennas)
         : _data(new HandleData(msPath, dataColumnName, temporaryDirectory,
-                               channels, initialModelRequired,
+                               intervalIndex, channels, initialModelRequired,
                                modelUpdateRequired, polarizations, selection,
                                bands, nAntennas)) {}
   };
@@ -155,6 +170,19 @@ class PartitionedMS final : public MSProvider {
  private:
   static void unpartition(const Handle::HandleData& handle);
 
+  /**
+   * Constructs handles to the parts that an earlier run stored in the
+   * reorder cache directory @p cacheDirectory, one for each interval. Only
+   * the model files are recreated.
+   */
+  static std::vector<Handle> openCachedPartition(
+      const std::string& msPath, const std::vector<ChannelRange>& channels,
+      const std::vector<MSSelection>& intervalSelections,
+      const std::string& dataColumnName, bool includeModel,
+      bool modelUpdateRequired,
+      const std::set<aocommon::PolarizationEnum>& polarizations,
+      const std::string& cacheDirectory);
+
   static void getDataDescIdMap(
       std::map<size_t, size_t>& dataDescIds,
       const std::vector<PartitionedMS::ChannelRange>& channels);
@@ -205,6 +233,22 @@ class PartitionedMS final : public MSProvider {
       str.read(reinterpret_cast<char*>(&antenna2), sizeof(uint16_t));
       str.read(reinterpret_cast<char*>(&fieldId), sizeof(uint16_t));
     }
+    /**
+     * Read a record from a memory buffer that holds the record in the same
+     * format as written by Write().
+     */
+    void Read(const char* buffer) {
+      std::copy_n(buffer, sizeof(double), reinterpret_cast<char*>(&u));
+      std::copy_n(buffer + 8, sizeof(double), reinterpret_cast<char*>(&v));
+      std::copy_n(buffer + 16, sizeof(double), reinterpret_cast<char*>(&w));
+      std::copy_n(buffer + 24, sizeof(double), reinterpret_cast<char*>(&time));
+      std::copy_n(buffer + 32, sizeof(uint16_t),
+                  reinterpret_cast<char*>(&antenna1));
+      std::copy_n(buffer + 34, sizeof(uint16_t),
+                  reinterpret_cast<char*>(&antenna2));
+      std::copy_n(buffer + 36, sizeof(uint16_t),
+                  reinterpret_cast<char*>(&fieldId));
+    }
     void Write(std::ostream& str) const {
       str.write(reinterpret_cast<const char*>(&u), sizeof(double));
       str.write(reinterpret_cast<const char*>(&v), sizeof(double));
@@ -220,15 +264,19 @@ class PartitionedMS final : public MSProvider {
     uint64_t channelStart = 0;
     uint32_t dataDescId = 0;
     bool hasModel = false;
-    static constexpr size_t BINARY_SIZE = sizeof(channelCount) +
-                                          sizeof(channelStart) +
-                                          sizeof(dataDescId) + sizeof(hasModel);
-    static_assert(BINARY_SIZE == 21);
+    // If true, the data and weights are stored as bfloat16 values (see
+    // reducedprecision.h) instead of as floats.
+    bool isCompressed = false;
+    static constexpr size_t BINARY_SIZE =
+        sizeof(channelCount) + sizeof(channelStart) + sizeof(dataDescId) +
+        sizeof(hasModel) + sizeof(isCompressed);
+    static_assert(BINARY_SIZE == 22);
     void Read(std::istream& str) {
       str.read(reinterpret_cast<char*>(&channelCount), sizeof(channelCount));
       str.read(reinterpret_cast<char*>(&channelStart), sizeof(channelStart));
       str.read(reinterpret_cast<char*>(&dataDescId), sizeof(dataDescId));
       str.read(reinterpret_cast<char*>(&hasModel), sizeof(hasModel));
+      str.read(reinterpret_cast<char*>(&isCompressed), sizeof(isCompressed));
     }
     void Write(std::ostream& str) const {
       str.write(reinterpret_cast<const char*>(&channelCount),
@@ -237,18 +285,23 @@ class PartitionedMS final : public MSProvider {
                 sizeof(channelStart));
       str.write(reinterpret_cast<const char*>(&dataDescId), sizeof(dataDescId));
       str.write(reinterpret_cast<const char*>(&hasModel), sizeof(hasModel));
+      str.write(reinterpret_cast<const char*>(&isCompressed),
+                sizeof(isCompressed));
     }
   } _partHeader;
 
   static std::string getFilenamePrefix(const std::string& msPath,
                                        const std::string& tempDir);
-  static std::string getPartPrefix(const std::string& msPath, size_t partIndex,
+  static std::string getPartPrefix(const std::string& msPath,
+                                   size_t intervalIndex, size_t partIndex,
                                    aocommon::PolarizationEnum pol,
                                    size_t dataDescId,
                                    const std::string& tempDir);
   static std::string getMetaFilename(const std::string& msPath,
+                                     size_t intervalIndex,
                                      const std::string& tempDir,
                                      size_t dataDescId);
+  static std::string getCacheKeyFilename(const std::string& cacheDirectory);
 };
 
 #endif
@@ -0,0 +1,59 @@
+#ifndef MSPROVIDERS_REDUCED_PRECISION_H
+#define MSPROVIDERS_REDUCED_PRECISION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Conversion between floats and bfloat16 values, which are used to store the
+ * reordered visibilities and weights with half the number of bytes. A
+ * bfloat16 value consists of the upper 16 bits of a float: it has the same
+ * exponent range, but only 8 bits of precision, which gives a relative error
+ * of at most 2^-8.
+ */
+namespace reduced_precision {
+
+inline uint16_t ToBfloat16(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(float));
+  // Keep NaNs a NaN, which the rounding below could turn into an infinity
+  if ((bits & 0x7fffffffu) > 0x7f800000u) return (bits >> 16) | 0x0040u;
+  // Round to nearest, ties to even
+  bits += 0x7fffu + ((bits >> 16) & 1u);
+  return bits >> 16;
+}
+
+inline float FromBfloat16(uint16_t value) {
+  const uint32_t bits = uint32_t(value) << 16;
+  float result;
+  std::memcpy(&result, &bits, sizeof(float));
+  return result;
+}
+
+/**
+ * Convert @p n floats to bfloat16 values. The destination does not need to be
+ * aligned.
+ */
+inline void Encode(const float* source, size_t n, char* destination) {
+  for (size_t i = 0; i != n; ++i) {
+    const uint16_t value = ToBfloat16(source[i]);
+    std::memcpy(destination + i * sizeof(uint16_t), &value, sizeof(uint16_t));
+  }
+}
+
+/**
+ * Convert @p n bfloat16 values back to floats. The source does not need to be
+ * aligned.
+ */
+inline void Decode(const char* source, size_t n, float* destination) {
+  for (size_t i = 0; i != n; ++i) {
+    uint16_t value;
+    std::memcpy(&value, source + i * sizeof(uint16_t), sizeof(uint16_t));
+    destination[i] = FromBfloat16(value);
+  }
+}
+
+}  // namespace reduced_precision
+
+#endif
@@ -109,27 +109,49 @@ float MultiScaleAlgorithm::ExecuteMajorIteration(
   bool hasHitThresholdInSubLoop = false;
   size_t thresholdCountdown = std::max(size_t(8), _scaleInfos.size() * 3 / 2);
 
-  Image scratch, scratchB, integratedScratch;
-  // scratch and scratchB are used by the subminorloop, which convolves the
-  // images and requires therefore more space. This space depends on the scale,
-  // so here the required size for the largest scale is calculated.
+  Image scratch, integratedScratch;
+  // scratch is used by the subminorloop, which convolves the images and
+  // requires therefore more space. This space depends on the scale, so here
+  // the required size for the largest scale is calculated.
   size_t scratchWidth, scratchHeight;
   getConvolutionDimensions(_scaleInfos.size() - 1, width, height, scratchWidth,
                            scratchHeight);
   scratch = Image(scratchWidth, scratchHeight);
-  scratchB = Image(scratchWidth, scratchHeight);
   integratedScratch = Image(width, height);
-  std::unique_ptr<std::unique_ptr<Image[]>[]> convolvedPSFs(
-      new std::unique_ptr<Image[]>[dirtySet.PSFCount()]);
-  dirtySet.GetIntegratedPSF(integratedScratch, psfs);
-  convolvePSFs(convolvedPSFs[0], integratedScratch, scratch, true);
-
-  // If there's only one, the integrated equals the first, so we can skip this
-  if (dirtySet.PSFCount() > 1) {
-    for (size_t i = 0; i != dirtySet.PSFCount(); ++i) {
-      convolvePSFs(convolvedPSFs[i], psfs[i], scratch, false);
+
+  // The PSFs are the same in every major iteration, so the convolved PSFs are
+  // only recalculated when the image size or the scales change.
+  if (_psfCache.width != width || _psfCache.height != height ||
+      _psfCache.convolvedPsfs.size() != dirtySet.PSFCount() ||
+      _psfCache.psfPeaks.size() != _scaleInfos.size()) {
+    _psfCache = PsfCache();
+    _psfCache.width = width;
+    _psfCache.height = height;
+    _psfCache.convolvedPsfs.resize(dirtySet.PSFCount());
+    _psfCache.twiceConvolvedPsfs.resize(_scaleInfos.size());
+    _psfCache.kernels.resize(_scaleInfos.size());
+
+    dirtySet.GetIntegratedPSF(integratedScratch, psfs);
+    std::vector<Image> integratedConvolvedPsfs;
+    convolvePSFs(integratedConvolvedPsfs, integratedScratch, scratch);
+    for (const Image& convolvedPsf : integratedConvolvedPsfs) {
+      _psfCache.psfPeaks.push_back(
+          convolvedPsf[width / 2 + (height / 2) * width]);
+    }
+
+    // If there's only one, the integrated equals the first, so we can skip
+    // this
+    if (dirtySet.PSFCount() > 1) {
+      for (size_t i = 0; i != dirtySet.PSFCount(); ++i) {
+        convolvePSFs(_psfCache.convolvedPsfs[i], psfs[i], scratch);
+      }
+    } else {
+      _psfCache.convolvedPsfs[0] = std::move(integratedConvolvedPsfs);
     }
   }
+  initializeScaleParameters();
+  const std::vector<std::vector<Image>>& convolvedPSFs =
+      _psfCache.convolvedPsfs;
 
   MultiScaleTransforms msTransforms(width, height, _scaleShape);
   msTransforms.SetThreadCount(_threadCount);
@@ -179,11 +201,10 @@ float MultiScaleAlgorithm::ExecuteMajorIteration(
          thresholdCountdown > 0) {
     // Create double-convolved PSFs & individually convolved images for this
     // scale
+    const std::vector<Image>& twiceConvolvedPSFs =
+        getTwiceConvolvedPsfs(scaleWithPeak, msTransforms, scratch);
     std::vector<Image> transformList;
-    transformList.reserve(dirtySet.PSFCount() + dirtySet.size());
-    for (size_t i = 0; i != dirtySet.PSFCount(); ++i) {
-      transformList.push_back(convolvedPSFs[i][scaleWithPeak]);
-    }
+    transformList.reserve(dirtySet.size());
     for (size_t i = 0; i != dirtySet.size(); ++i) {
       transformList.emplace_back(width, height);
       std::copy_n(dirtySet.Data(i), width * height,
@@ -193,15 +214,8 @@ float MultiScaleAlgorithm::ExecuteMajorIteration(
       msTransforms.Transform(transformList, scratch,
                              _scaleInfos[scaleWithPeak].scale);
     }
-
-    std::vector<Image> twiceConvolvedPSFs;
-    twiceConvolvedPSFs.reserve(dirtySet.PSFCount());
-    for (size_t i = 0; i != dirtySet.PSFCount(); ++i) {
-      twiceConvolvedPSFs.emplace_back(std::move(transformList[i]));
-    }
     for (size_t i = 0; i != dirtySet.size(); ++i) {
-      individualConvolvedImages.SetImage(
-          i, std::move(transformList[i + dirtySet.PSFCount()]));
+      individualConvolvedImages.SetImage(i, std::move(transformList[i]));
     }
 
     //
@@ -261,14 +275,22 @@ float MultiScaleAlgorithm::ExecuteMajorIteration(
           (_iterationNumber - subMinorStartIteration);
       _scaleInfos[scaleWithPeak].totalFluxCleaned += subLoop.FluxCleaned();
 
+      std::vector<Image>& kernels = _psfCache.kernels[scaleWithPeak];
+      if (kernels.empty()) {
+        for (const std::vector<Image>& convolvedPsf : convolvedPSFs) {
+          kernels.emplace_back(convolutionWidth, convolutionHeight);
+          subLoop.PrepareKernel(kernels.back().Data(), scratch.Data(),
+                                convolvedPsf[scaleWithPeak].Data());
+        }
+      }
+
       for (size_t imageIndex = 0; imageIndex != dirtySet.size(); ++imageIndex) {
         // TODO this can be multi-threaded if each thread has its own
         // temporaries
-        const aocommon::Image& psf =
-            convolvedPSFs[dirtySet.PSFIndex(imageIndex)][scaleWithPeak];
-        subLoop.CorrectResidualDirty(scratch.Data(), scratchB.Data(),
-                                     integratedScratch.Data(), imageIndex,
-                                     dirtySet.Data(imageIndex), psf.Data());
+        const aocommon::Image& kernel = kernels[dirtySet.PSFIndex(imageIndex)];
+        subLoop.CorrectResidualDirtyWithKernel(
+            scratch.Data(), integratedScratch.Data(), imageIndex,
+            dirtySet.Data(imageIndex), kernel.Data());
 
         subLoop.GetFullIndividualModel(imageIndex, scratch.Data());
         if (imageIndex == 0) {
@@ -433,63 +455,67 @@ void MultiScaleAlgorithm::initializeScaleInfo(size_t minWidthHeight) {
   }
 }
 
-void MultiScaleAlgorithm::convolvePSFs(std::unique_ptr<Image[]>& convolvedPSFs,
-                                       const Image& psf, Image& scratch,
-                                       bool isIntegrated) {
+void MultiScaleAlgorithm::convolvePSFs(std::vector<Image>& convolvedPSFs,
+                                       const Image& psf, Image& scratch) {
   MultiScaleTransforms msTransforms(psf.Width(), psf.Height(), _scaleShape);
   msTransforms.SetThreadCount(_threadCount);
-  convolvedPSFs.reset(new Image[_scaleInfos.size()]);
-  if (isIntegrated) _logReceiver->Info << "Scale info:\n";
+  convolvedPSFs.assign(_scaleInfos.size(), psf);
+  for (size_t scaleIndex = 0; scaleIndex != _scaleInfos.size(); ++scaleIndex) {
+    const float scale = _scaleInfos[scaleIndex].scale;
+    if (scale != 0.0)
+      msTransforms.Transform(convolvedPSFs[scaleIndex], scratch, scale);
+  }
+}
+
+void MultiScaleAlgorithm::initializeScaleParameters() {
+  _logReceiver->Info << "Scale info:\n";
   const double firstAutoScaleSize = _beamSizeInPixels * 2.0;
   for (size_t scaleIndex = 0; scaleIndex != _scaleInfos.size(); ++scaleIndex) {
     ScaleInfo& scaleEntry = _scaleInfos[scaleIndex];
 
-    convolvedPSFs[scaleIndex] = psf;
-
-    if (isIntegrated) {
-      if (scaleEntry.scale != 0.0)
-        msTransforms.Transform(convolvedPSFs[scaleIndex], scratch,
-                               scaleEntry.scale);
-
-      scaleEntry.psfPeak =
-          convolvedPSFs[scaleIndex]
-                       [psf.Width() / 2 + (psf.Height() / 2) * psf.Width()];
-      // We normalize this factor to 1 for scale 0, so:
-      // factor = (psf / kernel) / (psf0 / kernel0) = psf * kernel0 / (kernel *
-      // psf0)
-      // scaleEntry.biasFactor = std::max(1.0,
-      //	scaleEntry.psfPeak * scaleInfos[0].kernelPeak /
-      //	(scaleEntry.kernelPeak * scaleInfos[0].psfPeak));
-      double expTerm;
-      if (scaleEntry.scale == 0.0 || _scaleInfos.size() < 2)
-        expTerm = 0.0;
-      else
-        expTerm = std::log2(scaleEntry.scale / firstAutoScaleSize);
-      scaleEntry.biasFactor =
-          std::pow(_multiscaleScaleBias, -double(expTerm)) * 1.0;
-
-      // I tried this, but wasn't perfect:
-      // _gain * _scaleInfos[0].kernelPeak / scaleEntry.kernelPeak;
-      scaleEntry.gain = _gain / scaleEntry.psfPeak;
-
-      scaleEntry.isActive = true;
-
-      if (scaleEntry.scale == 0.0) {
-        convolvedPSFs[scaleIndex] = psf;
-      }
+    scaleEntry.psfPeak = _psfCache.psfPeaks[scaleIndex];
+    // We normalize this factor to 1 for scale 0, so:
+    // factor = (psf / kernel) / (psf0 / kernel0) = psf * kernel0 / (kernel *
+    // psf0)
+    // scaleEntry.biasFactor = std::max(1.0,
+    //	scaleEntry.psfPeak * scaleInfos[0].kernelPeak /
+    //	(scaleEntry.kernelPeak * scaleInfos[0].psfPeak));
+    double expTerm;
+    if (scaleEntry.scale == 0.0 || _scaleInfos.size() < 2)
+      expTerm = 0.0;
+    else
+      expTerm = std::log2(scaleEntry.scale / firstAutoScaleSize);
+    scaleEntry.biasFactor =
+        std::pow(_multiscaleScaleBias, -double(expTerm)) * 1.0;
+
+    // I tried this, but wasn't perfect:
+    // _gain * _scaleInfos[0].kernelPeak / scaleEntry.kernelPeak;
+    scaleEntry.gain = _gain / scaleEntry.psfPeak;
+
+    scaleEntry.isActive = true;
+
+    _logReceiver->Info << "- Scale " << round(scaleEntry.scale)
+                       << ", bias factor="
+                       << round(scaleEntry.biasFactor * 10.0) / 10.0
+                       << ", psfpeak=" << scaleEntry.psfPeak
+                       << ", gain=" << scaleEntry.gain
+                       << ", kernel peak=" << scaleEntry.kernelPeak << '\n';
+  }
+}
 
-      _logReceiver->Info << "- Scale " << round(scaleEntry.scale)
-                         << ", bias factor="
-                         << round(scaleEntry.biasFactor * 10.0) / 10.0
-                         << ", psfpeak=" << scaleEntry.psfPeak
-                         << ", gain=" << scaleEntry.gain
-                         << ", kernel peak=" << scaleEntry.kernelPeak << '\n';
-    } else {
-      if (scaleEntry.scale != 0.0)
-        msTransforms.Transform(convolvedPSFs[scaleIndex], scratch,
-                               scaleEntry.scale);
+const std::vector<Image>& MultiScaleAlgorithm::getTwiceConvolvedPsfs(
+    size_t scaleIndex, MultiScaleTransforms& msTransforms, Image& scratch) {
+  std::vector<Image>& twiceConvolvedPsfs =
+      _psfCache.twiceConvolvedPsfs[scaleIndex];
+  if (twiceConvolvedPsfs.empty()) {
+    for (const std::vector<Image>& convolvedPsf : _psfCache.convolvedPsfs)
+      twiceConvolvedPsfs.push_back(convolvedPsf[scaleIndex]);
+    if (_scaleInfos[scaleIndex].scale != 0.0) {
+      msTransforms.Transform(twiceConvolvedPsfs, scratch,
+                             _scaleInfos[scaleIndex].scale);
     }
   }
+  return twiceConvolvedPsfs;
 }
 
 void MultiScaleAlgorithm::findActiveScaleConvolvedMaxima(
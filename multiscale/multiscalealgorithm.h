@@ -113,10 +113,36 @@ class MultiScaleAlgorithm : public DeconvolutionAlgorithm {
   std::vector<aocommon::UVector<bool>> _scaleMasks;
   aocommon::cloned_ptr<ComponentList> _componentList;
 
+  /**
+   * Images derived from the PSFs. They only depend on the PSFs, the image size
+   * and the scales, and are therefore kept over major iterations.
+   */
+  struct PsfCache {
+    size_t width = 0;
+    size_t height = 0;
+    /// Peak value of the integrated PSF, convolved with each scale.
+    std::vector<float> psfPeaks;
+    /// Indexed by [psf index][scale index].
+    std::vector<std::vector<aocommon::Image>> convolvedPsfs;
+    /// Indexed by [scale index][psf index]. Calculated on first use of a scale.
+    std::vector<std::vector<aocommon::Image>> twiceConvolvedPsfs;
+    /// Convolution kernels of the convolved PSFs, as used by the subminor
+    /// loop. Indexed by [scale index][psf index] and calculated on first use.
+    std::vector<std::vector<aocommon::Image>> kernels;
+  };
+  PsfCache _psfCache;
+
   void initializeScaleInfo(size_t minWidthHeight);
-  void convolvePSFs(std::unique_ptr<aocommon::Image[]>& convolvedPSFs,
-                    const aocommon::Image& psf, aocommon::Image& scratch,
-                    bool isIntegrated);
+  void convolvePSFs(std::vector<aocommon::Image>& convolvedPSFs,
+                    const aocommon::Image& psf, aocommon::Image& scratch);
+  /**
+   * Sets the PSF-dependent parameters of the scales from the PSF cache, and
+   * activates all scales.
+   */
+  void initializeScaleParameters();
+  const std::vector<aocommon::Image>& getTwiceConvolvedPsfs(
+      size_t scaleIndex, MultiScaleTransforms& msTransforms,
+      aocommon::Image& scratch);
   void findActiveScaleConvolvedMaxima(const ImageSet& imageSet,
                                       aocommon::Image& integratedScratch,
                                       aocommon::Image& scratch, bool reportRMS,
@@ -6,60 +6,25 @@
 
 #include <aocommon/image.h>
 
-#include <memory>
+#include <algorithm>
 
 using aocommon::Image;
 
 ThreadedDeconvolutionTools::ThreadedDeconvolutionTools(size_t threadCount)
-    : _taskLanes(threadCount),
-      _resultLanes(threadCount),
-      _threadCount(threadCount) {
-  for (size_t i = 0; i != _threadCount; ++i) {
-    _taskLanes[i].resize(1);
-    _resultLanes[i].resize(1);
-    _threadGroup.emplace_back(&ThreadedDeconvolutionTools::threadFunc, this,
-                              &_taskLanes[i], &_resultLanes[i]);
-  }
-}
-
-ThreadedDeconvolutionTools::~ThreadedDeconvolutionTools() {
-  for (size_t i = 0; i != _threadCount; ++i) {
-    _taskLanes[i].write_end();
-  }
-
-  for (std::thread& t : _threadGroup) t.join();
-}
+    : _threadCount(threadCount), _pool(threadCount) {}
 
 void ThreadedDeconvolutionTools::SubtractImage(float* image,
                                                const aocommon::Image& psf,
                                                size_t x, size_t y,
                                                float factor) {
-  for (size_t thr = 0; thr != _threadCount; ++thr) {
-    auto task = std::make_unique<SubtractionTask>();
-    task->image = image;
-    task->psf = &psf;
-    task->x = x;
-    task->y = y;
-    task->factor = factor;
-    task->startY = psf.Height() * thr / _threadCount;
-    task->endY = psf.Height() * (thr + 1) / _threadCount;
-    if (thr == _threadCount - 1) {
-      (*task)();
-    } else {
-      _taskLanes[thr].write(std::move(task));
-    }
-  }
-  for (size_t thr = 0; thr != _threadCount - 1; ++thr) {
-    std::unique_ptr<ThreadResult> result;
-    _resultLanes[thr].read(result);
-  }
-}
-
-std::unique_ptr<ThreadedDeconvolutionTools::ThreadResult>
-ThreadedDeconvolutionTools::SubtractionTask::operator()() {
-  SimpleClean::PartialSubtractImage(image, psf->Data(), psf->Width(),
-                                    psf->Height(), x, y, factor, startY, endY);
-  return std::unique_ptr<ThreadedDeconvolutionTools::ThreadResult>();
+  auto subtract = [&](size_t thread) {
+    const size_t startY = psf.Height() * thread / _threadCount;
+    const size_t endY = psf.Height() * (thread + 1) / _threadCount;
+    SimpleClean::PartialSubtractImage(image, psf.Data(), psf.Width(),
+                                      psf.Height(), x, y, factor, startY,
+                                      endY);
+  };
+  _pool.Run(subtract);
 }
 
 void ThreadedDeconvolutionTools::FindMultiScalePeak(
@@ -69,124 +34,85 @@ void ThreadedDeconvolutionTools::FindMultiScalePeak(
     bool allowNegativeComponents, const bool* mask,
     const std::vector<aocommon::UVector<bool>>& scaleMasks, float borderRatio,
     const Image& rmsFactorImage, bool calculateRMS) {
-  size_t imageIndex = 0;
-  size_t nextThread = 0;
-  size_t resultIndex = 0;
-
   results.resize(scales.size());
 
-  size_t size = std::min(scales.size(), _threadCount);
-  std::vector<Image> imageData;
-  std::vector<Image> scratchData;
-  imageData.reserve(size);
-  scratchData.reserve(size);
-  for (size_t i = 0; i != size; ++i) {
-    imageData.emplace_back(msTransforms->Width(), msTransforms->Height());
-    scratchData.emplace_back(msTransforms->Width(), msTransforms->Height());
+  const size_t size = std::min(scales.size(), _threadCount);
+  const size_t width = msTransforms->Width();
+  const size_t height = msTransforms->Height();
+  if (_imageData.size() < size || (!_imageData.empty() &&
+                                   (_imageData.front().Width() != width ||
+                                    _imageData.front().Height() != height))) {
+    _imageData.clear();
+    _scratchData.clear();
+    for (size_t i = 0; i != size; ++i) {
+      _imageData.emplace_back(width, height);
+      _scratchData.emplace_back(width, height);
+    }
   }
 
-  while (imageIndex < scales.size()) {
-    std::unique_ptr<FindMultiScalePeakTask> task(new FindMultiScalePeakTask());
-    task->msTransforms = msTransforms;
-    imageData[nextThread] = image;
-    task->image = &imageData[nextThread];
-    task->scratch = &scratchData[nextThread];
-    task->scale = scales[imageIndex];
-    task->allowNegativeComponents = allowNegativeComponents;
-    if (scaleMasks.empty())
-      task->mask = mask;
-    else
-      task->mask = scaleMasks[imageIndex].data();
-    task->borderRatio = borderRatio;
-    task->calculateRMS = calculateRMS;
-    task->rmsFactorImage = &rmsFactorImage;
-    _taskLanes[nextThread].write(std::move(task));
-
-    ++nextThread;
-    if (nextThread == _threadCount) {
-      for (size_t thr = 0; thr != nextThread; ++thr) {
-        std::unique_ptr<ThreadResult> result;
-        _resultLanes[thr].read(result);
-        results[resultIndex].normalizedValue =
-            static_cast<FindMultiScalePeakResult&>(*result).normalizedValue;
-        results[resultIndex].unnormalizedValue =
-            static_cast<FindMultiScalePeakResult&>(*result).unnormalizedValue;
-        results[resultIndex].x =
-            static_cast<FindMultiScalePeakResult&>(*result).x;
-        results[resultIndex].y =
-            static_cast<FindMultiScalePeakResult&>(*result).y;
-        results[resultIndex].rms =
-            static_cast<FindMultiScalePeakResult&>(*result).rms;
-        ++resultIndex;
-      }
-      nextThread = 0;
+  // Scale i is processed by thread i % size, which handles its scales in
+  // order, such that each thread only writes to its own buffers and results.
+  auto findPeaks = [&](size_t thread) {
+    for (size_t i = thread; i < scales.size(); i += size) {
+      _imageData[thread] = image;
+      const bool* scaleMask = scaleMasks.empty() ? mask : scaleMasks[i].data();
+      findSingleScalePeak(*msTransforms, _imageData[thread],
+                          _scratchData[thread], scales[i],
+                          allowNegativeComponents, scaleMask, borderRatio,
+                          rmsFactorImage, calculateRMS, results[i]);
     }
-    ++imageIndex;
-  }
-  for (size_t thr = 0; thr != nextThread; ++thr) {
-    std::unique_ptr<ThreadResult> result;
-    _resultLanes[thr].read(result);
-    results[resultIndex].unnormalizedValue =
-        static_cast<FindMultiScalePeakResult&>(*result).unnormalizedValue;
-    results[resultIndex].normalizedValue =
-        static_cast<FindMultiScalePeakResult&>(*result).normalizedValue;
-    results[resultIndex].x = static_cast<FindMultiScalePeakResult&>(*result).x;
-    results[resultIndex].y = static_cast<FindMultiScalePeakResult&>(*result).y;
-    results[resultIndex].rms =
-        static_cast<FindMultiScalePeakResult&>(*result).rms;
-    ++resultIndex;
-  }
+  };
+  _pool.Run(findPeaks);
 }
 
-std::unique_ptr<ThreadedDeconvolutionTools::ThreadResult>
-ThreadedDeconvolutionTools::FindMultiScalePeakTask::operator()() {
-  msTransforms->Transform(*image, *scratch, scale);
-  const size_t width = msTransforms->Width();
-  const size_t height = msTransforms->Height();
+void ThreadedDeconvolutionTools::findSingleScalePeak(
+    MultiScaleTransforms& msTransforms, Image& image, Image& scratch,
+    float scale, bool allowNegativeComponents, const bool* mask,
+    float borderRatio, const Image& rmsFactorImage, bool calculateRMS,
+    PeakData& result) {
+  msTransforms.Transform(image, scratch, scale);
+  const size_t width = msTransforms.Width();
+  const size_t height = msTransforms.Height();
   const size_t scaleBorder = size_t(std::ceil(scale * 0.5));
   const size_t horBorderSize =
       std::max<size_t>(std::round(width * borderRatio), scaleBorder);
   const size_t vertBorderSize =
       std::max<size_t>(std::round(height * borderRatio), scaleBorder);
-  std::unique_ptr<FindMultiScalePeakResult> result(
-      new FindMultiScalePeakResult());
   if (calculateRMS)
-    result->rms = RMS(*image, width * height);
+    result.rms = RMS(image, width * height);
   else
-    result->rms = -1.0;
-  if (rmsFactorImage->Empty()) {
+    result.rms = -1.0;
+  if (rmsFactorImage.Empty()) {
     if (mask == nullptr)
-      result->unnormalizedValue = PeakFinder::Find(
-          image->Data(), width, height, result->x, result->y,
+      result.unnormalizedValue = PeakFinder::Find(
+          image.Data(), width, height, result.x, result.y,
           allowNegativeComponents, 0, height, horBorderSize, vertBorderSize);
     else
-      result->unnormalizedValue =
-          PeakFinder::FindWithMask(image->Data(), width, height, result->x,
-                                   result->y, allowNegativeComponents, 0,
-                                   height, mask, horBorderSize, vertBorderSize);
+      result.unnormalizedValue = PeakFinder::FindWithMask(
+          image.Data(), width, height, result.x, result.y,
+          allowNegativeComponents, 0, height, mask, horBorderSize,
+          vertBorderSize);
 
-    result->normalizedValue = result->unnormalizedValue;
+    result.normalizedValue = result.unnormalizedValue;
   } else {
-    for (size_t i = 0; i != rmsFactorImage->Size(); ++i)
-      (*scratch)[i] = (*image)[i] * (*rmsFactorImage)[i];
+    for (size_t i = 0; i != rmsFactorImage.Size(); ++i)
+      scratch[i] = image[i] * rmsFactorImage[i];
 
     if (mask == nullptr)
-      result->unnormalizedValue = PeakFinder::Find(
-          scratch->Data(), width, height, result->x, result->y,
+      result.unnormalizedValue = PeakFinder::Find(
+          scratch.Data(), width, height, result.x, result.y,
           allowNegativeComponents, 0, height, horBorderSize, vertBorderSize);
     else
-      result->unnormalizedValue =
-          PeakFinder::FindWithMask(scratch->Data(), width, height, result->x,
-                                   result->y, allowNegativeComponents, 0,
-                                   height, mask, horBorderSize, vertBorderSize);
-
-    if (result->unnormalizedValue) {
-      result->normalizedValue =
-          (*result->unnormalizedValue) /
-          (*rmsFactorImage)[result->x + result->y * width];
+      result.unnormalizedValue = PeakFinder::FindWithMask(
+          scratch.Data(), width, height, result.x, result.y,
+          allowNegativeComponents, 0, height, mask, horBorderSize,
+          vertBorderSize);
+
+    if (result.unnormalizedValue) {
+      result.normalizedValue = (*result.unnormalizedValue) /
+                               rmsFactorImage[result.x + result.y * width];
     } else {
-      result->normalizedValue.reset();
+      result.normalizedValue.reset();
     }
   }
-  return result;
 }
@@ -26,6 +26,11 @@ struct GriddingResult {
    * cases, this list will only hold one image.
    */
   std::vector<aocommon::Image> images;
+  /**
+   * The PSF, when it was imaged together with the data by a
+   * GriddingTask::InvertWithPSF task. Empty otherwise.
+   */
+  std::vector<aocommon::Image> psfImages;
   double startTime;
   double beamSize;
   double imageWeight;
@@ -29,7 +29,18 @@ class GriddingTask {
   GriddingTask& operator=(const GriddingTask& source) = delete;
   GriddingTask& operator=(GriddingTask&& source) noexcept;
 
-  enum Operation { Invert, Predict } operation;
+  /**
+   * PredictAndInvert predicts the model images and images the residual in a
+   * single pass, without writing the model visibilities. InvertWithPSF
+   * images the data and the PSF in a single pass; the PSF is returned in
+   * @ref GriddingResult::psfImages.
+   */
+  enum Operation {
+    Invert,
+    Predict,
+    PredictAndInvert,
+    InvertWithPSF
+  } operation;
   bool imagePSF;
   bool subtractModel;
   aocommon::PolarizationEnum polarization;
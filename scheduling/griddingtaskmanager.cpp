@@ -49,16 +49,87 @@ GriddingResult GriddingTaskManager::RunDirect(GriddingTask&& task) {
   return runDirect(std::move(task), *gridder);
 }
 
+void GriddingTaskManager::RunFacetGroup(
+    std::vector<GriddingTask>&& tasks,
+    std::function<void(size_t, GriddingResult&)> finishCallback) {
+  if (tasks.empty()) return;
+  std::vector<std::unique_ptr<MSGridderBase>> gridders;
+  std::vector<WGriddingMSGridder*> facetGridders;
+  // All facets of the group read the same data, so the providers are opened
+  // once and shared by the gridders of all facets.
+  const std::vector<std::unique_ptr<MSProvider>> msProviders =
+      makeMSProviders(tasks.front());
+  for (GriddingTask& task : tasks) {
+    gridders.emplace_back(makeGridder());
+    WGriddingMSGridder* gridder =
+        dynamic_cast<WGriddingMSGridder*>(gridders.back().get());
+    if (!gridder || task.operation != GriddingTask::Invert)
+      throw std::runtime_error(
+          "Facet groups can only be inverted together with the w-gridder");
+    if (task.msList.size() != msProviders.size())
+      throw std::runtime_error(
+          "The facets of a facet group should have the same measurement sets");
+    initializeGridder(task, *gridder, msProviders);
+    gridder->SetDoImagePSF(task.imagePSF);
+    gridder->SetDoSubtractModel(task.subtractModel);
+    gridder->SetStoreImagingWeights(task.storeImagingWeights);
+    facetGridders.emplace_back(gridder);
+  }
+
+  WGriddingMSGridder::InvertFacetGroup(facetGridders);
+
+  for (size_t i = 0; i != gridders.size(); ++i) {
+    GriddingResult result = makeResult(*gridders[i], false);
+    finishCallback(i, result);
+  }
+}
+
 GriddingResult GriddingTaskManager::runDirect(GriddingTask&& task,
                                               MSGridderBase& gridder) {
-  gridder.ClearMeasurementSetList();
-  std::vector<std::unique_ptr<MSProvider>> msProviders;
-  for (auto& p : task.msList) {
-    msProviders.emplace_back(p->GetProvider());
-    gridder.AddMeasurementSet(msProviders.back().get(), p->Selection());
-  }
+  const std::vector<std::unique_ptr<MSProvider>> msProviders =
+      makeMSProviders(task);
+  initializeGridder(task, gridder, msProviders);
   const bool has_input_average_beam(task.averageBeam);
-  if (has_input_average_beam) {
+
+  if (task.operation == GriddingTask::Invert) {
+    gridder.SetDoImagePSF(task.imagePSF);
+    gridder.SetDoSubtractModel(task.subtractModel);
+    gridder.SetStoreImagingWeights(task.storeImagingWeights);
+    gridder.Invert();
+  } else if (task.operation == GriddingTask::PredictAndInvert) {
+    gridder.SetDoImagePSF(false);
+    gridder.SetDoSubtractModel(true);
+    gridder.SetStoreImagingWeights(false);
+    gridder.PredictAndInvert(std::move(task.modelImages));
+  } else if (task.operation == GriddingTask::InvertWithPSF) {
+    gridder.SetDoImagePSF(false);
+    gridder.SetDoSubtractModel(task.subtractModel);
+    gridder.SetStoreImagingWeights(false);
+    gridder.InvertWithPSF();
+  } else {
+    gridder.SetWriterLockManager(this);
+    gridder.Predict(std::move(task.modelImages));
+  }
+
+  return makeResult(gridder, has_input_average_beam);
+}
+
+std::vector<std::unique_ptr<MSProvider>> GriddingTaskManager::makeMSProviders(
+    const GriddingTask& task) {
+  std::vector<std::unique_ptr<MSProvider>> msProviders;
+  for (const std::unique_ptr<MSDataDescription>& description : task.msList)
+    msProviders.emplace_back(description->GetProvider());
+  return msProviders;
+}
+
+void GriddingTaskManager::initializeGridder(
+    GriddingTask& task, MSGridderBase& gridder,
+    const std::vector<std::unique_ptr<MSProvider>>& msProviders) {
+  gridder.ClearMeasurementSetList();
+  for (size_t i = 0; i != task.msList.size(); ++i)
+    gridder.AddMeasurementSet(msProviders[i].get(),
+                              task.msList[i]->Selection());
+  if (task.averageBeam) {
     assert(dynamic_cast<IdgMsGridder*>(&gridder));
     IdgMsGridder& idgGridder = static_cast<IdgMsGridder&>(gridder);
     idgGridder.SetAverageBeam(std::move(task.averageBeam));
@@ -95,18 +166,14 @@ GriddingResult GriddingTaskManager::runDirect(GriddingTask&& task,
     gridder.SetMetaDataCache(
         std::unique_ptr<MetaDataCache>(new MetaDataCache()));
   gridder.SetImageWeights(task.imageWeights.get());
-  if (task.operation == GriddingTask::Invert) {
-    gridder.SetDoImagePSF(task.imagePSF);
-    gridder.SetDoSubtractModel(task.subtractModel);
-    gridder.SetStoreImagingWeights(task.storeImagingWeights);
-    gridder.Invert();
-  } else {
-    gridder.SetWriterLockManager(this);
-    gridder.Predict(std::move(task.modelImages));
-  }
+  return msProviders;
+}
 
+GriddingResult GriddingTaskManager::makeResult(MSGridderBase& gridder,
+                                               bool hasInputAverageBeam) {
   GriddingResult result;
   result.images = gridder.ResultImages();
+  result.psfImages = gridder.ResultPSFImages();
   result.startTime = gridder.StartTime();
   result.beamSize = gridder.BeamSize();
   result.imageWeight = gridder.ImageWeight();
@@ -121,7 +188,7 @@ GriddingResult GriddingTaskManager::runDirect(GriddingTask&& task,
   // If the average beam already exists on input, IDG will not recompute it, so
   // in that case there is no need to return the unchanged average beam.
   IdgMsGridder* idgGridder = dynamic_cast<IdgMsGridder*>(&gridder);
-  if (idgGridder && !has_input_average_beam) {
+  if (idgGridder && !hasInputAverageBeam) {
     result.averageBeam = idgGridder->ReleaseAverageBeam();
   }
   return result;
@@ -61,6 +61,18 @@ class GriddingTaskManager : protected WriterLockManager {
    */
   GriddingResult RunDirect(GriddingTask&& task);
 
+  /**
+   * Run a group of Invert tasks that image the different facets of the same
+   * data with the w-gridder. The visibilities are read once for the whole
+   * group, see WGriddingMSGridder::InvertFacetGroup(). After all tasks have
+   * finished, the callback is called for each task with the index of the
+   * task in @p tasks and its result. The callback runs in the thread of the
+   * caller, and this call blocks until done.
+   */
+  void RunFacetGroup(
+      std::vector<GriddingTask>&& tasks,
+      std::function<void(size_t, GriddingResult&)> finishCallback);
+
   /**
    * Make the gridding task manager according to the settings.
    */
@@ -79,6 +91,25 @@ class GriddingTaskManager : protected WriterLockManager {
    */
   GriddingResult runDirect(GriddingTask&& task, MSGridderBase& gridder);
 
+  /**
+   * Opens a provider for each measurement set of the task. The providers
+   * should be kept alive while a gridder uses them.
+   */
+  static std::vector<std::unique_ptr<MSProvider>> makeMSProviders(
+      const GriddingTask& task);
+
+  /**
+   * Configure the gridder for the provided task. @p msProviders should be
+   * made by makeMSProviders() for this task, or for a task with the same
+   * measurement sets.
+   */
+  void initializeGridder(
+      GriddingTask& task, MSGridderBase& gridder,
+      const std::vector<std::unique_ptr<MSProvider>>& msProviders);
+
+  static GriddingResult makeResult(MSGridderBase& gridder,
+                                   bool hasInputAverageBeam);
+
  private:
   class DummyWriterLock final : public WriterLock {
    public:
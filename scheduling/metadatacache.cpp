@@ -2,6 +2,11 @@
 
 #include <aocommon/io/serialostream.h>
 #include <aocommon/io/serialistream.h>
+#include <aocommon/uvector.h>
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
 
 void MetaDataCache::Serialize(aocommon::SerialOStream& stream) const {
   stream.UInt64(msDataVector.size());
@@ -30,3 +35,36 @@ void MetaDataCache::Unserialize(aocommon::SerialIStream& stream) {
 
   stream.LDouble(h5Sum).LDouble(correctionSum);
 }
+
+void MetaDataCache::Save(const std::string& filename,
+                         const std::string& key) const {
+  aocommon::SerialOStream stream;
+  Serialize(stream);
+  const uint64_t keySize = key.size();
+  std::ofstream file(filename, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(&keySize), sizeof(keySize));
+  file.write(key.data(), key.size());
+  file.write(reinterpret_cast<const char*>(stream.data()), stream.size());
+  if (!file.good())
+    throw std::runtime_error("Error writing meta data cache file " + filename);
+}
+
+bool MetaDataCache::Load(const std::string& filename, const std::string& key) {
+  std::ifstream file(filename, std::ios::binary);
+  uint64_t keySize = 0;
+  file.read(reinterpret_cast<char*>(&keySize), sizeof(keySize));
+  if (!file.good() || keySize != key.size()) return false;
+  std::string storedKey(keySize, '\0');
+  file.read(&storedKey[0], keySize);
+  if (!file.good() || storedKey != key) return false;
+
+  const std::streampos start = file.tellg();
+  file.seekg(0, std::ios::end);
+  aocommon::UVector<unsigned char> buffer(file.tellg() - start);
+  file.seekg(start);
+  file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+  if (!file.good()) return false;
+  aocommon::SerialIStream stream(std::move(buffer));
+  Unserialize(stream);
+  return true;
+}
@@ -4,6 +4,7 @@
 #include <aocommon/io/serialstreamfwd.h>
 
 #include <memory>
+#include <string>
 #include <vector>
 
 struct MetaDataCache {
@@ -24,6 +25,21 @@ struct MetaDataCache {
    */
   void Serialize(aocommon::SerialOStream& stream) const;
   void Unserialize(aocommon::SerialIStream& stream);
+
+  /**
+   * Writes the cache to disk, such that it can be reused by a later run.
+   * @param key Identifies the data that the cache was calculated from. It is
+   * stored together with the cache, and Load() only succeeds when it is given
+   * the same key.
+   */
+  void Save(const std::string& filename, const std::string& key) const;
+
+  /**
+   * Reads a cache that was written by Save().
+   * @returns false if the file does not exist or was saved with a different
+   * key, in which case the cache is not changed.
+   */
+  bool Load(const std::string& filename, const std::string& key);
 };
 
 #endif
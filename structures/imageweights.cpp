@@ -10,10 +10,11 @@
 #include <aocommon/fits/fitswriter.h>
 #include <aocommon/banddata.h>
 #include <aocommon/logger.h>
+#include <aocommon/parallelfor.h>
 #include <aocommon/staticfor.h>
-#include <aocommon/system.h>
 #include <aocommon/units/angle.h>
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <cassert>
@@ -28,12 +29,12 @@ ImageWeights::ImageWeights()
       _totalSum(0.0),
       _isGriddingFinished(false),
       _weightsAsTaper(false),
-      _threadCount(aocommon::system::ProcessorCount()) {}
+      _threadCount(1) {}
 
 ImageWeights::ImageWeights(const WeightMode& weightMode, size_t imageWidth,
                            size_t imageHeight, double pixelScaleX,
                            double pixelScaleY, bool weightsAsTaper,
-                           double superWeight)
+                           double superWeight, size_t threadCount)
     : _weightMode(weightMode),
       _imageWidth(round(double(imageWidth) / superWeight)),
       _imageHeight(round(double(imageHeight) / superWeight)),
@@ -42,7 +43,7 @@ ImageWeights::ImageWeights(const WeightMode& weightMode, size_t imageWidth,
       _totalSum(0.0),
       _isGriddingFinished(false),
       _weightsAsTaper(weightsAsTaper),
-      _threadCount(aocommon::system::ProcessorCount()) {
+      _threadCount(threadCount) {
   if (_imageWidth % 2 != 0) ++_imageWidth;
   if (_imageHeight % 2 != 0) ++_imageHeight;
   _grid.assign(_imageWidth * _imageHeight / 2, 0.0);
@@ -73,47 +74,121 @@ void ImageWeights::Unserialize(aocommon::SerialIStream& stream) {
 }
 
 void ImageWeights::Grid(MSProvider& msProvider,
-                        const aocommon::BandData& selectedBand) {
+                        const aocommon::BandData& selectedBand,
+                        size_t threadCount) {
   assert(!_isGriddingFinished);
-  const size_t polarizationCount = msProvider.NPolarizations();
-  if (_weightMode.RequiresGridding()) {
-    aocommon::UVector<float> weightBuffer(selectedBand.ChannelCount() *
-                                          polarizationCount);
+  if (!_weightMode.RequiresGridding()) return;
 
-    std::unique_ptr<MSReader> msReader = msProvider.MakeReader();
-    while (msReader->CurrentRowAvailable()) {
-      double uInM, vInM, wInM;
-      msReader->ReadMeta(uInM, vInM, wInM);
-      msReader->ReadWeights(weightBuffer.data());
-      if (_weightsAsTaper) {
-        for (float& w : weightBuffer) {
-          if (w != 0.0) w = 1.0;
+  const size_t polarizationCount = msProvider.NPolarizations();
+  const size_t rowSize = selectedBand.ChannelCount() * polarizationCount;
+  // Read about a million weights per block, which is enough work to split
+  // over the threads while keeping the block small.
+  const size_t maxRows =
+      std::max<size_t>(1, (size_t(1) << 20) / std::max<size_t>(rowSize, 1));
+  std::unique_ptr<MSReader> msReader = msProvider.MakeReader();
+  MSReader::RowBlock block;
+  aocommon::StaticFor<size_t> loop(std::max<size_t>(threadCount, 1));
+  while (msReader->CurrentRowAvailable()) {
+    const size_t nRows = msReader->ReadBlock(maxRows, block, false);
+    loop.Run(0, nRows, [&](size_t rowStart, size_t rowEnd) {
+      std::unique_ptr<PrivateGrid> grid = acquirePrivateGrid();
+      double sum = 0.0;
+      for (size_t row = rowStart; row != rowEnd; ++row) {
+        double uInM = block.uvw[row * 3];
+        double vInM = block.uvw[row * 3 + 1];
+        if (vInM < 0.0) {
+          uInM = -uInM;
+          vInM = -vInM;
         }
-      }
-      if (vInM < 0.0) {
-        uInM = -uInM;
-        vInM = -vInM;
-      }
-
-      const float* weightIter = weightBuffer.data();
-      for (size_t ch = 0; ch != selectedBand.ChannelCount(); ++ch) {
-        const double u = uInM / selectedBand.ChannelWavelength(ch);
-        const double v = vInM / selectedBand.ChannelWavelength(ch);
-        for (size_t p = 0; p != polarizationCount; ++p) {
-          Grid(u, v, *weightIter);
-          ++weightIter;
+        const float* weightIter = block.Weights(row);
+        for (size_t ch = 0; ch != selectedBand.ChannelCount(); ++ch) {
+          const double u = uInM / selectedBand.ChannelWavelength(ch);
+          const double v = vInM / selectedBand.ChannelWavelength(ch);
+          int x, y;
+          uvToXY(u, v, x, y);
+          const bool isInside = isWithinLimits(x, y);
+          const size_t index = (size_t)x + (size_t)y * _imageWidth;
+          for (size_t p = 0; p != polarizationCount; ++p) {
+            double weight = *weightIter;
+            if (_weightsAsTaper && weight != 0.0) weight = 1.0;
+            if (isInside) {
+              grid->values[index] += weight;
+              sum += weight;
+            }
+            ++weightIter;
+          }
         }
       }
+      grid->sum += sum;
+      releasePrivateGrid(std::move(grid));
+    });
+  }
+}
 
-      msReader->NextInputRow();
-    }
+void ImageWeights::GridInParallel(
+    size_t jobCount,
+    const std::function<void(size_t jobIndex, size_t threadCount)>& gridJob) {
+  if (jobCount == 0) return;
+  const size_t jobThreadCount = std::min(jobCount, _threadCount);
+  const size_t threadsPerJob =
+      std::max<size_t>(1, _threadCount / jobThreadCount);
+  aocommon::ParallelFor<size_t> loop(jobThreadCount);
+  loop.Run(0, jobCount,
+           [&](size_t jobIndex, size_t) { gridJob(jobIndex, threadsPerJob); });
+}
+
+void ImageWeights::SetPrivateGridMemoryLimit(size_t bytes) {
+  std::lock_guard<std::mutex> lock(_privateGridMutex);
+  const size_t gridBytes = std::max<size_t>(_grid.size() * sizeof(double), 1);
+  _maxPrivateGridCount =
+      bytes == 0 ? 0 : std::max<size_t>(bytes / gridBytes, 1);
+}
+
+std::unique_ptr<ImageWeights::PrivateGrid> ImageWeights::acquirePrivateGrid() {
+  std::unique_lock<std::mutex> lock(_privateGridMutex);
+  _privateGridCondition.wait(lock, [&]() {
+    return !_privateGrids.empty() || _maxPrivateGridCount == 0 ||
+           _privateGridCount < _maxPrivateGridCount;
+  });
+  if (_privateGrids.empty()) {
+    ++_privateGridCount;
+    lock.unlock();
+    std::unique_ptr<PrivateGrid> grid(new PrivateGrid());
+    grid->values.assign(_grid.size(), 0.0);
+    return grid;
+  } else {
+    std::unique_ptr<PrivateGrid> grid = std::move(_privateGrids.back());
+    _privateGrids.pop_back();
+    return grid;
   }
 }
 
+void ImageWeights::releasePrivateGrid(std::unique_ptr<PrivateGrid> grid) {
+  std::lock_guard<std::mutex> lock(_privateGridMutex);
+  _privateGrids.emplace_back(std::move(grid));
+  _privateGridCondition.notify_one();
+}
+
+void ImageWeights::mergePrivateGrids() {
+  if (_privateGrids.empty()) return;
+  aocommon::StaticFor<size_t> loop(_threadCount);
+  loop.Run(0, _grid.size(), [&](size_t start, size_t end) {
+    for (const std::unique_ptr<PrivateGrid>& grid : _privateGrids) {
+      const double* values = grid->values.data();
+      for (size_t i = start; i != end; ++i) _grid[i] += values[i];
+    }
+  });
+  for (const std::unique_ptr<PrivateGrid>& grid : _privateGrids)
+    _totalSum += grid->sum;
+  _privateGrids.clear();
+  _privateGridCount = 0;
+}
+
 void ImageWeights::FinishGridding() {
   if (_isGriddingFinished)
     throw std::runtime_error("FinishGridding() called twice");
   _isGriddingFinished = true;
+  mergePrivateGrids();
 
   switch (_weightMode.Mode()) {
     case WeightMode::BriggsWeighted: {
@@ -305,21 +380,65 @@ void ImageWeights::Save(const string& filename) const {
 }
 
 void ImageWeights::RankFilter(double rankLimit, size_t windowSize) {
-  std::vector<double> newGrid(_grid);
+  // Summed-area tables of the weights and of the number of non-zero weights.
+  // They have an extra leading row and column, such that element (x, y) is
+  // the total over all cells with a smaller x and y. Unsigned wrap-around of
+  // the counts cancels out when combining the four corners of a window.
+  const size_t width = _imageWidth;
+  const size_t height = _imageHeight / 2;
+  const size_t tableWidth = width + 1;
+  std::vector<double> sumTable(tableWidth * (height + 1), 0.0);
+  std::vector<size_t> countTable(tableWidth * (height + 1), 0);
   aocommon::StaticFor<size_t> loop(_threadCount);
-  loop.Run(0, _imageHeight / 2, [&](size_t yStart, size_t yEnd) {
+  loop.Run(0, height, [&](size_t yStart, size_t yEnd) {
     for (size_t y = yStart; y != yEnd; ++y) {
-      for (size_t x = 0; x != _imageWidth; ++x) {
-        double w = _grid[y * _imageWidth + x];
+      const double* gridRow = &_grid[y * width];
+      double* sumRow = &sumTable[(y + 1) * tableWidth];
+      size_t* countRow = &countTable[(y + 1) * tableWidth];
+      for (size_t x = 0; x != width; ++x) {
+        const double w = gridRow[x];
+        sumRow[x + 1] = sumRow[x] + w;
+        countRow[x + 1] = countRow[x] + (w != 0.0 ? 1 : 0);
+      }
+    }
+  });
+  loop.Run(0, tableWidth, [&](size_t xStart, size_t xEnd) {
+    for (size_t y = 2; y <= height; ++y) {
+      const size_t row = y * tableWidth;
+      const size_t previousRow = (y - 1) * tableWidth;
+      for (size_t x = xStart; x != xEnd; ++x) {
+        sumTable[row + x] += sumTable[previousRow + x];
+        countTable[row + x] += countTable[previousRow + x];
+      }
+    }
+  });
+
+  // The window of a cell covers [x - d, x + d) and [y - d, y + d), clipped to
+  // the half-plane grid.
+  const size_t d = windowSize / 2;
+  loop.Run(0, height, [&](size_t yStart, size_t yEnd) {
+    for (size_t y = yStart; y != yEnd; ++y) {
+      const size_t y1 = y <= d ? 0 : y - d;
+      const size_t y2 = std::min(y + d, height);
+      for (size_t x = 0; x != width; ++x) {
+        double& w = _grid[y * width + x];
         if (w != 0.0) {
-          double mean = windowMean(x, y, windowSize);
-          if (w > mean * rankLimit)
-            newGrid[y * _imageWidth + x] = mean * rankLimit;
+          const size_t x1 = x <= d ? 0 : x - d;
+          const size_t x2 = std::min(x + d, width);
+          const size_t a = y1 * tableWidth + x1;
+          const size_t b = y1 * tableWidth + x2;
+          const size_t c = y2 * tableWidth + x1;
+          const size_t e = y2 * tableWidth + x2;
+          const double windowSum =
+              sumTable[e] - sumTable[b] - sumTable[c] + sumTable[a];
+          const size_t windowCount =
+              countTable[e] - countTable[b] - countTable[c] + countTable[a];
+          const double mean = windowSum / double(windowCount);
+          if (w > mean * rankLimit) w = mean * rankLimit;
         }
       }
     }
   });
-  _grid = newGrid;
 }
 
 void ImageWeights::SetGaussianTaper(double beamSize) {
@@ -346,40 +465,3 @@ void ImageWeights::SetGaussianTaper(double beamSize) {
     }
   });
 }
-
-double ImageWeights::windowMean(size_t x, size_t y, size_t windowSize) {
-  size_t d = windowSize / 2;
-  size_t x1, y1, x2, y2;
-  if (x <= d)
-    x1 = 0;
-  else
-    x1 = x - d;
-
-  if (y <= d)
-    y1 = 0;
-  else
-    y1 = y - d;
-
-  if (x + d >= _imageWidth)
-    x2 = _imageWidth;
-  else
-    x2 = x + d;
-
-  if (y + d >= _imageHeight / 2)
-    y2 = _imageHeight / 2;
-  else
-    y2 = y + d;
-
-  size_t windowCount = 0;
-  double windowSum = 0.0;
-  for (size_t yi = y1; yi < y2; ++yi) {
-    for (size_t xi = x1; xi < x2; ++xi) {
-      double w = _grid[yi * _imageWidth + xi];
-      if (w != 0.0) {
-        ++windowCount;
-        windowSum += w;
-      }
-    }
-  }
-  return windowSum / double(windowCount);
-}
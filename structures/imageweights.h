@@ -3,6 +3,11 @@
 
 #include <cstddef>
 #include <complex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <aocommon/io/serialstreamfwd.h>
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
@@ -23,16 +28,38 @@ class ImageWeights {
    */
   ImageWeights();
 
+  /**
+   * @param threadCount Number of threads used by the operations on the
+   * grid, normally the -j setting.
+   */
   ImageWeights(const WeightMode& weightMode, size_t imageWidth,
                size_t imageHeight, double pixelScaleX, double pixelScaleY,
-               bool weightsAsTaper, double superWeight);
+               bool weightsAsTaper, double superWeight, size_t threadCount);
 
   ImageWeights(const ImageWeights&) = delete;
   ImageWeights& operator=(const ImageWeights&) = delete;
 
   double GetWeight(double u, double v) const { return sampleGridValue(u, v); }
 
-  void Grid(MSProvider& ms, const aocommon::BandData& selectedBand);
+  /**
+   * Grids the weights of all rows of @p ms. The rows are read in blocks
+   * on the calling thread, and each block is accumulated by @p threadCount
+   * threads into thread-private grids, which are added to the final grid by
+   * FinishGridding(). Multiple threads may call this function at the same
+   * time for different providers; see also GridInParallel().
+   */
+  void Grid(MSProvider& ms, const aocommon::BandData& selectedBand,
+            size_t threadCount);
+
+  /**
+   * Calls @p gridJob(jobIndex, threadCount) for every job index below
+   * @p jobCount. The jobs run in parallel, and the threads of this object are
+   * divided over the jobs such that each job can pass its thread count on to
+   * Grid().
+   */
+  void GridInParallel(
+      size_t jobCount,
+      const std::function<void(size_t jobIndex, size_t threadCount)>& gridJob);
   void Grid(double u, double v, double weight) {
     int x, y;
     uvToXY(u, v, x, y);
@@ -56,6 +83,14 @@ class ImageWeights {
                          double edgeSizeInLambda);
   void SetThreadCount(size_t threadCount) { _threadCount = threadCount; }
 
+  /**
+   * Limits the memory used by the thread-private grids of Grid(). When the
+   * limit is reached, threads wait for a private grid to become available.
+   * At least one private grid is always allowed. Zero means no limit, which
+   * is the default.
+   */
+  void SetPrivateGridMemoryLimit(size_t bytes);
+
   void SetAllValues(double newValue) { _grid.assign(_grid.size(), newValue); }
   void GetGrid(double* image) const;
   void Save(const std::string& filename) const;
@@ -103,7 +138,20 @@ class ImageWeights {
     }
   }
 
-  double windowMean(size_t x, size_t y, size_t windowSize);
+  /**
+   * Grid that is accumulated by a single thread at a time. Once released,
+   * it can be reused by another thread, such that no more private grids
+   * are allocated than the maximum number of threads gridding at once, or
+   * than the limit of SetPrivateGridMemoryLimit().
+   */
+  struct PrivateGrid {
+    std::vector<double> values;
+    double sum = 0.0;
+  };
+
+  std::unique_ptr<PrivateGrid> acquirePrivateGrid();
+  void releasePrivateGrid(std::unique_ptr<PrivateGrid> grid);
+  void mergePrivateGrids();
 
   /**
    * Returns Tukey tapering function. This function is
@@ -126,6 +174,13 @@ class ImageWeights {
   double _totalSum;
   bool _isGriddingFinished, _weightsAsTaper;
   size_t _threadCount;
+  // Private grids that are not in use. _privateGridCount also includes the
+  // grids that are in use.
+  std::vector<std::unique_ptr<PrivateGrid>> _privateGrids;
+  size_t _privateGridCount = 0;
+  size_t _maxPrivateGridCount = 0;
+  std::mutex _privateGridMutex;
+  std::condition_variable _privateGridCondition;
 };
 
 #endif
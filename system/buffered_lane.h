@@ -5,22 +5,27 @@
 
 #include <aocommon/lane.h>
 
-template <typename Tp>
+/**
+ * Buffers elements before they are written to a lane, such that the lane
+ * is accessed once per block. LaneType can be aocommon::Lane or any type with
+ * the same interface, such as spsc_ring.
+ */
+template <typename Tp, typename LaneType = aocommon::Lane<Tp>>
 class lane_write_buffer {
  public:
-  typedef typename aocommon::Lane<Tp>::size_type size_type;
-  typedef typename aocommon::Lane<Tp>::value_type value_type;
+  typedef typename LaneType::size_type size_type;
+  typedef typename LaneType::value_type value_type;
 
   lane_write_buffer() : _buffer_size(0), _lane(nullptr) {}
 
-  lane_write_buffer(aocommon::Lane<Tp>* lane, size_type buffer_size)
+  lane_write_buffer(LaneType* lane, size_type buffer_size)
       : _buffer_size(buffer_size), _lane(lane) {
     _buffer.reserve(buffer_size);
   }
 
   ~lane_write_buffer() { flush(); }
 
-  void reset(aocommon::Lane<Tp>* lane, size_type buffer_size) {
+  void reset(LaneType* lane, size_type buffer_size) {
     _buffer.clear();
     _buffer.reserve(buffer_size);
     _buffer_size = buffer_size;
@@ -61,13 +66,17 @@ class lane_write_buffer {
  private:
   size_type _buffer_size;
   std::vector<value_type> _buffer;
-  aocommon::Lane<Tp>* _lane;
+  LaneType* _lane;
 };
 
-template <typename Tp>
+/**
+ * Reads elements from a lane in blocks. Like lane_write_buffer, LaneType can
+ * be aocommon::Lane or spsc_ring.
+ */
+template <typename Tp, typename LaneType = aocommon::Lane<Tp>>
 class lane_read_buffer {
  public:
-  lane_read_buffer(aocommon::Lane<Tp>* lane, size_t buffer_size)
+  lane_read_buffer(LaneType* lane, size_t buffer_size)
       : _buffer(new Tp[buffer_size]),
         _buffer_size(buffer_size),
         _buffer_pos(0),
@@ -93,7 +102,7 @@ class lane_read_buffer {
 
   Tp* _buffer;
   size_t _buffer_size, _buffer_pos, _buffer_fill_count;
-  aocommon::Lane<Tp>* _lane;
+  LaneType* _lane;
 };
 
 #endif
@@ -0,0 +1,74 @@
+#include "cachekey.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+#include <sys/stat.h>
+
+#include <boost/filesystem/operations.hpp>
+
+namespace wsclean {
+namespace system {
+
+namespace {
+/**
+ * Adds the sizes of the regular files in @p directory to @p totalSize, and
+ * raises @p lastWriteTime (seconds, nanoseconds) to their latest
+ * modification time. A directory that does not exist is skipped.
+ */
+void AddTableFiles(const boost::filesystem::path& directory,
+                   uintmax_t& totalSize,
+                   std::pair<std::time_t, long>& lastWriteTime) {
+  if (!boost::filesystem::is_directory(directory)) return;
+  for (boost::filesystem::directory_iterator i(directory), end; i != end;
+       ++i) {
+    struct stat info;
+    if (stat(i->path().c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+      totalSize += info.st_size;
+      const std::pair<std::time_t, long> writeTime(info.st_mtim.tv_sec,
+                                                   info.st_mtim.tv_nsec);
+      lastWriteTime = std::max(lastWriteTime, writeTime);
+    }
+  }
+}
+}  // namespace
+
+std::string MSFingerprint(const std::string& msPath) {
+  uintmax_t totalSize = 0;
+  std::pair<std::time_t, long> lastWriteTime(0, 0);
+  AddTableFiles(msPath, totalSize, lastWriteTime);
+  // Subtables that describe the frequencies and phase centres of the data
+  for (const char* subtable : {"SPECTRAL_WINDOW", "FIELD", "DATA_DESCRIPTION"})
+    AddTableFiles(boost::filesystem::path(msPath) / subtable, totalSize,
+                  lastWriteTime);
+  std::ostringstream str;
+  str << totalSize << ' ' << lastWriteTime.first << '.' << std::setfill('0')
+      << std::setw(9) << lastWriteTime.second;
+  return str.str();
+}
+
+std::string HashToString(const std::string& key) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const char c : key) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  std::ostringstream str;
+  str << std::hex << std::setfill('0') << std::setw(16) << hash;
+  return str.str();
+}
+
+std::string ReadFileContents(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  std::ostringstream contents;
+  if (file.good()) contents << file.rdbuf();
+  return contents.str();
+}
+
+}  // namespace system
+}  // namespace wsclean
@@ -0,0 +1,32 @@
+#ifndef WSCLEAN_SYSTEM_CACHEKEY_H_
+#define WSCLEAN_SYSTEM_CACHEKEY_H_
+
+#include <string>
+
+namespace wsclean {
+namespace system {
+
+/**
+ * Describes the state of a measurement set on disk by the total size and the
+ * latest modification time, with nanosecond resolution, of the files of its
+ * main table and of its SPECTRAL_WINDOW, FIELD and DATA_DESCRIPTION
+ * subtables. Any change to the visibilities or the metadata of these tables
+ * changes the result.
+ */
+std::string MSFingerprint(const std::string& msPath);
+
+/**
+ * Returns the 64-bit FNV-1a hash of @p key as a hexadecimal string. It is used
+ * to name cache files, so it should not change between versions.
+ */
+std::string HashToString(const std::string& key);
+
+/**
+ * Returns the contents of a file, or an empty string if it can not be read.
+ */
+std::string ReadFileContents(const std::string& filename);
+
+}  // namespace system
+}  // namespace wsclean
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef FORK_JOIN_POOL_H
+#define FORK_JOIN_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed group of worker threads that repeatedly execute the same kind of
+ * short parallel job. Each call to Run() costs two barrier crossings: one to
+ * release the workers and one to wait for them to finish. No memory is
+ * allocated per call, which makes it suitable for jobs that are run once per
+ * CLEAN iteration.
+ *
+ * A thread that waits for the barrier first spins and yields for a while, and
+ * parks on a condition variable afterwards, such that idle workers do not
+ * keep a core busy between jobs.
+ *
+ * Only one thread may call Run() at a time, and the job should not throw.
+ */
+class ForkJoinPool {
+ public:
+  /**
+   * @param threadCount Total number of threads that execute a job, including
+   * the thread that calls Run(). Hence, threadCount-1 workers are started.
+   */
+  explicit ForkJoinPool(size_t threadCount)
+      : _threadCount(std::max<size_t>(threadCount, 1)) {
+    _workers.reserve(_threadCount - 1);
+    for (size_t i = 0; i != _threadCount - 1; ++i)
+      _workers.emplace_back(&ForkJoinPool::workerFunc, this, i);
+  }
+
+  ~ForkJoinPool() {
+    _isStopping.store(true, std::memory_order_relaxed);
+    releaseWorkers();
+    for (std::thread& worker : _workers) worker.join();
+  }
+
+  ForkJoinPool(const ForkJoinPool&) = delete;
+  ForkJoinPool& operator=(const ForkJoinPool&) = delete;
+
+  size_t ThreadCount() const { return _threadCount; }
+
+  /**
+   * Calls @p job(threadIndex) once for every threadIndex in the range
+   * [0, ThreadCount()), in parallel. The calling thread executes the last
+   * index. Returns when all calls have finished.
+   */
+  template <typename Job>
+  void Run(Job& job) {
+    _job = &job;
+    _invoke = [](void* context, size_t threadIndex) {
+      (*static_cast<Job*>(context))(threadIndex);
+    };
+    _pendingCount.store(_threadCount - 1, std::memory_order_relaxed);
+    releaseWorkers();
+    job(_threadCount - 1);
+    waitForWorkers();
+  }
+
+ private:
+  // Number of busy iterations before a waiting thread starts yielding, and
+  // the number of yields before it parks.
+  static constexpr size_t kSpinCount = 256;
+  static constexpr size_t kYieldCount = 64;
+
+  /**
+   * Starts a new generation. Because both the generation increment and the
+   * parked counter are sequentially consistent, either a parking worker sees
+   * the new generation, or this thread sees that a worker is parked.
+   */
+  void releaseWorkers() {
+    _generation.fetch_add(1, std::memory_order_seq_cst);
+    if (_parkedWorkerCount.load(std::memory_order_seq_cst) != 0) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _workerCondition.notify_all();
+    }
+  }
+
+  void waitForWorkers() {
+    for (size_t i = 0; i != kSpinCount + kYieldCount; ++i) {
+      if (_pendingCount.load(std::memory_order_acquire) == 0) return;
+      if (i >= kSpinCount) std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _isCallerParked.store(true, std::memory_order_seq_cst);
+    _callerCondition.wait(lock, [&]() {
+      return _pendingCount.load(std::memory_order_seq_cst) == 0;
+    });
+    _isCallerParked.store(false, std::memory_order_relaxed);
+  }
+
+  uint64_t waitForGeneration(uint64_t previous) {
+    for (size_t i = 0; i != kSpinCount + kYieldCount; ++i) {
+      const uint64_t generation = _generation.load(std::memory_order_acquire);
+      if (generation != previous) return generation;
+      if (i >= kSpinCount) std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _parkedWorkerCount.fetch_add(1, std::memory_order_seq_cst);
+    uint64_t generation;
+    _workerCondition.wait(lock, [&]() {
+      generation = _generation.load(std::memory_order_seq_cst);
+      return generation != previous;
+    });
+    _parkedWorkerCount.fetch_sub(1, std::memory_order_relaxed);
+    return generation;
+  }
+
+  void workerFunc(size_t threadIndex) {
+    uint64_t generation = 0;
+    while (true) {
+      generation = waitForGeneration(generation);
+      if (_isStopping.load(std::memory_order_relaxed)) return;
+      _invoke(_job, threadIndex);
+      if (_pendingCount.fetch_sub(1, std::memory_order_seq_cst) == 1 &&
+          _isCallerParked.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _callerCondition.notify_one();
+      }
+    }
+  }
+
+  const size_t _threadCount;
+  // The current job, set by Run() before the generation is incremented.
+  void* _job = nullptr;
+  void (*_invoke)(void*, size_t) = nullptr;
+  alignas(64) std::atomic<uint64_t> _generation{0};
+  alignas(64) std::atomic<size_t> _pendingCount{0};
+  alignas(64) std::atomic<size_t> _parkedWorkerCount{0};
+  std::atomic<bool> _isCallerParked{false};
+  std::atomic<bool> _isStopping{false};
+  std::mutex _mutex;
+  std::condition_variable _workerCondition;
+  std::condition_variable _callerCondition;
+  std::vector<std::thread> _workers;
+};
+
+#endif
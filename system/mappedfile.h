@@ -3,6 +3,7 @@
 
 #include <aocommon/system.h>
 
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 
@@ -12,6 +13,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 /**
  * A memory-mapped buffer that is mapped to a file on disk using mmap().
@@ -61,6 +63,36 @@ class MappedFile {
     }
   }
 
+  /**
+   * Memory map an existing file as a whole for reading only. An empty file
+   * results in an empty map, for which Data() returns nullptr.
+   */
+  static MappedFile OpenReadOnly(const std::string& filename) {
+    MappedFile file;
+    file.file_descriptor_ = open(filename.c_str(), O_RDONLY);
+    if (file.file_descriptor_ == -1)
+      throw std::runtime_error("Error opening file '" + filename + "'");
+    struct stat file_status;
+    if (fstat(file.file_descriptor_, &file_status) != 0) {
+      const std::string msg = aocommon::system::GetErrorString(errno);
+      throw std::runtime_error("Error determining size of file '" + filename +
+                               "': " + msg);
+    }
+    file.reserved_size_ = file_status.st_size;
+    if (file.reserved_size_ != 0) {
+      void* memory_map = mmap(nullptr, file.reserved_size_, PROT_READ,
+                              MAP_SHARED, file.file_descriptor_, 0);
+      if (memory_map == MAP_FAILED) {
+        const std::string msg = aocommon::system::GetErrorString(errno);
+        throw std::runtime_error(
+            "Error creating read-only memory map for file '" + filename +
+            "': mmap() returned MAP_FAILED with error message: " + msg);
+      }
+      file.memory_map_ = reinterpret_cast<char*>(memory_map);
+    }
+    return file;
+  }
+
   ~MappedFile() {
     if (memory_map_ != nullptr) {
       if (reserved_size_ != 0) munmap(memory_map_, reserved_size_);
@@ -73,6 +105,36 @@ class MappedFile {
   char* Data() { return memory_map_; }
   const char* Data() const { return memory_map_; }
 
+  /**
+   * Size of the mapped region in bytes.
+   */
+  size_t Size() const { return reserved_size_; }
+
+  /**
+   * Tell the kernel that the map will be accessed sequentially, such that it
+   * reads ahead more aggressively and drops pages after they have been used.
+   * This is only a hint, so failure is ignored.
+   */
+  void AdviseSequential() {
+    if (memory_map_ != nullptr)
+      madvise(memory_map_, reserved_size_, MADV_SEQUENTIAL);
+  }
+
+  /**
+   * Ask the kernel to start reading the byte range [offset, offset + length)
+   * into the page cache, without waiting for it. The range is clipped to the
+   * map. Like AdviseSequential(), this is only a hint.
+   */
+  void Prefetch(size_t offset, size_t length) {
+    if (memory_map_ == nullptr || offset >= reserved_size_) return;
+    length = std::min(length, reserved_size_ - offset);
+    // madvise() requires a page-aligned start address
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t aligned_offset = offset - offset % page_size;
+    madvise(memory_map_ + aligned_offset, length + (offset - aligned_offset),
+            MADV_WILLNEED);
+  }
+
  private:
   friend void Swap(MappedFile& lhs, MappedFile& rhs) {
     std::swap(lhs.reserved_size_, rhs.reserved_size_);
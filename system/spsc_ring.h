@@ -0,0 +1,252 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * A bounded, lock-free queue for exactly one writing thread and one reading
+ * thread. It has the same interface as aocommon::Lane, such that it can be
+ * used as a drop-in replacement in producer/consumer pipelines where each lane
+ * has a single producer and a single consumer, and it can be wrapped by
+ * lane_write_buffer and lane_read_buffer from buffered_lane.h.
+ *
+ * Writing and reading are lock-free: the read and write positions are atomic
+ * counters on separate cache lines, and each side keeps a cached copy of the
+ * other side's position so that it only touches the shared cache line when
+ * the cached value is exhausted. The batch calls move_write() and read(Tp*,
+ * size_t) publish their position once per contiguous block. A side that has
+ * to wait first spins and yields for a while, after which it parks on a
+ * condition variable. A mutex is therefore only taken when one of the sides
+ * is actually starved.
+ */
+template <typename Tp>
+class spsc_ring {
+ public:
+  typedef std::size_t size_type;
+  typedef Tp value_type;
+
+  spsc_ring() : spsc_ring(0) {}
+
+  /**
+   * @param capacity Number of elements the ring can hold. It is rounded up
+   * to the next power of two.
+   */
+  explicit spsc_ring(size_type capacity) { resize(capacity); }
+
+  spsc_ring(const spsc_ring&) = delete;
+  spsc_ring& operator=(const spsc_ring&) = delete;
+
+  /**
+   * Change the capacity. This also empties the ring and resets its
+   * end-of-data state. Not thread safe.
+   */
+  void resize(size_type capacity) {
+    size_type rounded = 1;
+    while (rounded < capacity) rounded *= 2;
+    _buffer.clear();
+    _buffer.resize(rounded);
+    _mask = rounded - 1;
+    clear();
+  }
+
+  /** Remove all elements and reset the end-of-data state. Not thread safe. */
+  void clear() {
+    _head.value.store(0);
+    _tail.value.store(0);
+    _cached_head = 0;
+    _cached_tail = 0;
+    _is_write_end.store(false);
+  }
+
+  size_type capacity() const { return _buffer.size(); }
+
+  /** Number of elements available for reading. */
+  size_type size() const {
+    return _tail.value.load(std::memory_order_acquire) -
+           _head.value.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+
+  void write(const value_type& element) {
+    const size_type tail = _tail.value.load(std::memory_order_relaxed);
+    wait_for_space(tail, 1);
+    _buffer[tail & _mask] = element;
+    publish_tail(tail + 1);
+  }
+
+  void write(value_type&& element) {
+    const size_type tail = _tail.value.load(std::memory_order_relaxed);
+    wait_for_space(tail, 1);
+    _buffer[tail & _mask] = std::move(element);
+    publish_tail(tail + 1);
+  }
+
+  template <typename... Args>
+  void emplace(Args&&... args) {
+    write(value_type(std::forward<Args>(args)...));
+  }
+
+  /**
+   * Move @p count elements into the ring. The elements are published in as
+   * few blocks as the free space allows. Blocks while the ring is full.
+   */
+  void move_write(value_type* elements, size_type count) {
+    while (count != 0) {
+      const size_type tail = _tail.value.load(std::memory_order_relaxed);
+      const size_type available = wait_for_space(tail, 1);
+      const size_type n = std::min(available, count);
+      for (size_type i = 0; i != n; ++i)
+        _buffer[(tail + i) & _mask] = std::move(elements[i]);
+      publish_tail(tail + n);
+      elements += n;
+      count -= n;
+    }
+  }
+
+  /**
+   * Signal that no more elements will be written. A reader that is waiting
+   * will return once all remaining elements are read.
+   */
+  void write_end() {
+    _is_write_end.store(true, std::memory_order_seq_cst);
+    wake(_consumer_waiting);
+  }
+
+  /**
+   * Read a single element. Blocks until an element is available.
+   * @returns false if the ring is empty and write_end() was called.
+   */
+  bool read(value_type& destination) {
+    const size_type head = _head.value.load(std::memory_order_relaxed);
+    if (wait_for_data(head, 1) == 0) return false;
+    destination = std::move(_buffer[head & _mask]);
+    publish_head(head + 1);
+    return true;
+  }
+
+  /**
+   * Read up to @p count elements. Blocks until at least one element is
+   * available, and then reads as many as are available (up to @p count).
+   * @returns Number of elements read, which is only zero when the ring is
+   * empty and write_end() was called.
+   */
+  size_type read(value_type* destinations, size_type count) {
+    if (count == 0) return 0;
+    const size_type head = _head.value.load(std::memory_order_relaxed);
+    const size_type n = std::min(wait_for_data(head, count), count);
+    for (size_type i = 0; i != n; ++i)
+      destinations[i] = std::move(_buffer[(head + i) & _mask]);
+    if (n != 0) publish_head(head + n);
+    return n;
+  }
+
+ private:
+  // Number of busy iterations before a waiting thread starts yielding, and
+  // the number of yields before it parks.
+  static constexpr size_t kSpinCount = 256;
+  static constexpr size_t kYieldCount = 64;
+
+  struct alignas(64) PaddedCounter {
+    std::atomic<size_type> value{0};
+  };
+
+  /**
+   * Called by the writer. Returns the number of free slots (at least
+   * @p required) after waiting for enough free space.
+   */
+  size_type wait_for_space(size_type tail, size_type required) {
+    size_type free_space = capacity() - (tail - _cached_head);
+    if (free_space >= required) return free_space;
+    for (size_t i = 0; i != kSpinCount + kYieldCount; ++i) {
+      _cached_head = _head.value.load(std::memory_order_acquire);
+      free_space = capacity() - (tail - _cached_head);
+      if (free_space >= required) return free_space;
+      if (i >= kSpinCount) std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _producer_waiting.store(true, std::memory_order_seq_cst);
+    _condition.wait(lock, [&]() {
+      _cached_head = _head.value.load(std::memory_order_seq_cst);
+      return capacity() - (tail - _cached_head) >= required;
+    });
+    _producer_waiting.store(false, std::memory_order_relaxed);
+    return capacity() - (tail - _cached_head);
+  }
+
+  /**
+   * Called by the reader. Returns the number of elements that can be read,
+   * which is zero only when the ring is empty and the writer has finished.
+   * The shared write position is only reloaded when fewer than @p wanted
+   * elements are known to be available.
+   */
+  size_type wait_for_data(size_type head, size_type wanted) {
+    if (_cached_tail - head >= wanted) return _cached_tail - head;
+    _cached_tail = _tail.value.load(std::memory_order_acquire);
+    if (_cached_tail != head) return _cached_tail - head;
+    for (size_t i = 0; i != kSpinCount + kYieldCount; ++i) {
+      // The end flag should be read before the tail, such that no elements
+      // are missed that were written just before write_end().
+      const bool is_end = _is_write_end.load(std::memory_order_acquire);
+      _cached_tail = _tail.value.load(std::memory_order_acquire);
+      if (_cached_tail != head || is_end) return _cached_tail - head;
+      if (i >= kSpinCount) std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _consumer_waiting.store(true, std::memory_order_seq_cst);
+    _condition.wait(lock, [&]() {
+      const bool is_end = _is_write_end.load(std::memory_order_seq_cst);
+      _cached_tail = _tail.value.load(std::memory_order_seq_cst);
+      return _cached_tail != head || is_end;
+    });
+    _consumer_waiting.store(false, std::memory_order_relaxed);
+    return _cached_tail - head;
+  }
+
+  void publish_tail(size_type tail) {
+    _tail.value.store(tail, std::memory_order_seq_cst);
+    wake(_consumer_waiting);
+  }
+
+  void publish_head(size_type head) {
+    _head.value.store(head, std::memory_order_seq_cst);
+    wake(_producer_waiting);
+  }
+
+  /**
+   * Wake the other side if it is parked. Because both the position store and
+   * the waiting flag are sequentially consistent, either the waiting thread
+   * sees the new position, or this thread sees the waiting flag.
+   */
+  void wake(const std::atomic<bool>& is_waiting) {
+    if (is_waiting.load(std::memory_order_seq_cst)) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _condition.notify_all();
+    }
+  }
+
+  // Read position, only written by the reader.
+  PaddedCounter _head;
+  // Write position, only written by the writer.
+  PaddedCounter _tail;
+  // Writer's copy of _head.
+  alignas(64) size_type _cached_head = 0;
+  // Reader's copy of _tail.
+  alignas(64) size_type _cached_tail = 0;
+  alignas(64) std::atomic<bool> _is_write_end{false};
+  std::atomic<bool> _producer_waiting{false};
+  std::atomic<bool> _consumer_waiting{false};
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  size_type _mask = 0;
+  std::vector<value_type> _buffer;
+};
+
+#endif
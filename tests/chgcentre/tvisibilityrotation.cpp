@@ -0,0 +1,69 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../../chgcentre/visibilityrotation.h"
+
+#include <aocommon/banddata.h>
+
+#include <complex>
+#include <vector>
+
+namespace {
+constexpr size_t kChannelCount = 1000;
+constexpr size_t kPolarizationCount = 4;
+constexpr double kStartFrequency = 120e6;
+constexpr double kChannelWidth = 48828.125;
+// Corresponds with a w-difference of 100 km, which gives phases of about
+// 3e5 radians.
+constexpr double kShiftFactor = -2.0 * M_PI * 100e3;
+
+aocommon::BandData MakeBand(double perturbation = 0.0) {
+  std::vector<aocommon::ChannelInfo> channels;
+  for (size_t ch = 0; ch != kChannelCount; ++ch) {
+    double frequency = kStartFrequency + ch * kChannelWidth;
+    if (ch == kChannelCount / 2) frequency *= 1.0 + perturbation;
+    channels.emplace_back(frequency, kChannelWidth);
+  }
+  return aocommon::BandData(channels);
+}
+
+/**
+ * Rotates a row of ones and compares the result with a direct evaluation of
+ * the phasor of every channel.
+ */
+void CheckRotation(const aocommon::BandData& band, bool isRegular) {
+  std::vector<std::complex<float>> data(kChannelCount * kPolarizationCount,
+                                        std::complex<float>(1.0, 0.0));
+  rotateVisibilities(band, isRegular, kShiftFactor, kPolarizationCount,
+                     data.data());
+  for (size_t ch = 0; ch != kChannelCount; ++ch) {
+    const std::complex<double> expected =
+        std::polar(1.0, kShiftFactor / band.ChannelWavelength(ch));
+    for (size_t p = 0; p != kPolarizationCount; ++p) {
+      const std::complex<float> value = data[ch * kPolarizationCount + p];
+      BOOST_CHECK_SMALL(value.real() - expected.real(), 1e-6);
+      BOOST_CHECK_SMALL(value.imag() - expected.imag(), 1e-6);
+    }
+  }
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(visibility_rotation)
+
+BOOST_AUTO_TEST_CASE(regular_channels) {
+  BOOST_CHECK(hasRegularChannels(MakeBand()));
+  BOOST_CHECK(!hasRegularChannels(MakeBand(1e-12)));
+}
+
+BOOST_AUTO_TEST_CASE(recurrence) {
+  const aocommon::BandData band = MakeBand();
+  BOOST_REQUIRE(hasRegularChannels(band));
+  CheckRotation(band, true);
+}
+
+BOOST_AUTO_TEST_CASE(irregular_channels) {
+  const aocommon::BandData band = MakeBand(1e-6);
+  BOOST_REQUIRE(!hasRegularChannels(band));
+  CheckRotation(band, false);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
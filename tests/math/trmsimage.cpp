@@ -0,0 +1,80 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../../math/rmsimage.h"
+
+#include <aocommon/image.h>
+
+#include <algorithm>
+#include <random>
+
+using aocommon::Image;
+
+namespace {
+constexpr size_t kWidth = 37;
+constexpr size_t kHeight = 23;
+
+/**
+ * Straightforward implementation of the sliding minimum: each output pixel is
+ * the minimum over [x - w/2, x + w/2) x [y - w/2, y + w/2), clipped to the
+ * image.
+ */
+float BruteForceMinimum(const Image& image, size_t x, size_t y,
+                        size_t windowSize) {
+  const size_t half = windowSize / 2;
+  const size_t left = x > half ? x - half : 0;
+  const size_t right = std::min(x + half, image.Width());
+  const size_t top = y > half ? y - half : 0;
+  const size_t bottom = std::min(y + half, image.Height());
+  float minimum = image[top * image.Width() + left];
+  for (size_t yi = top; yi != bottom; ++yi) {
+    for (size_t xi = left; xi != right; ++xi)
+      minimum = std::min(minimum, image[yi * image.Width() + xi]);
+  }
+  return minimum;
+}
+
+Image MakeRandomImage() {
+  std::mt19937 rnd;
+  std::uniform_real_distribution<float> distribution(-1.0, 1.0);
+  Image image(kWidth, kHeight);
+  for (float& value : image) value = distribution(rnd);
+  return image;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(rms_image)
+
+BOOST_AUTO_TEST_CASE(sliding_minimum) {
+  const Image input = MakeRandomImage();
+  for (size_t windowSize : {2, 3, 4, 7, 10, 25, 46, 100}) {
+    for (size_t threadCount : {1, 3}) {
+      Image output;
+      RMSImage::SlidingMinimum(output, input, windowSize, threadCount);
+      BOOST_REQUIRE_EQUAL(output.Width(), kWidth);
+      BOOST_REQUIRE_EQUAL(output.Height(), kHeight);
+      for (size_t y = 0; y != kHeight; ++y) {
+        for (size_t x = 0; x != kWidth; ++x) {
+          BOOST_CHECK_EQUAL(output[y * kWidth + x],
+                            BruteForceMinimum(input, x, y, windowSize));
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(sliding_maximum) {
+  const Image input = MakeRandomImage();
+  Image negated(input);
+  negated.Negate();
+  const size_t windowSize = 9;
+  Image output;
+  RMSImage::SlidingMaximum(output, input, windowSize, 2);
+  for (size_t y = 0; y != kHeight; ++y) {
+    for (size_t x = 0; x != kWidth; ++x) {
+      BOOST_CHECK_EQUAL(output[y * kWidth + x],
+                        -BruteForceMinimum(negated, x, y, windowSize));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
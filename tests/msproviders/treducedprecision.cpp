@@ -0,0 +1,52 @@
+#include "../../msproviders/reducedprecision.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(reduced_precision)
+
+BOOST_AUTO_TEST_CASE(exact_values) {
+  for (const float value : {0.0f, -0.0f, 1.0f, -2.0f, 0.5f, 256.0f, 1.5f}) {
+    BOOST_CHECK_EQUAL(
+        reduced_precision::FromBfloat16(reduced_precision::ToBfloat16(value)),
+        value);
+  }
+  const float infinity = std::numeric_limits<float>::infinity();
+  BOOST_CHECK_EQUAL(
+      reduced_precision::FromBfloat16(reduced_precision::ToBfloat16(infinity)),
+      infinity);
+  BOOST_CHECK(std::isnan(reduced_precision::FromBfloat16(
+      reduced_precision::ToBfloat16(std::numeric_limits<float>::quiet_NaN()))));
+}
+
+BOOST_AUTO_TEST_CASE(rounding) {
+  // 1 + 2^-8 is exactly halfway between 1 and the next bfloat16 value, and
+  // rounds to the even value 1.
+  BOOST_CHECK_EQUAL(reduced_precision::FromBfloat16(
+                        reduced_precision::ToBfloat16(1.0f + 0x1p-8f)),
+                    1.0f);
+  BOOST_CHECK_EQUAL(reduced_precision::FromBfloat16(
+                        reduced_precision::ToBfloat16(1.0f + 0x1.8p-8f)),
+                    1.0f + 0x1p-7f);
+  for (float value = 1e-20f; value < 1e20f; value *= 1.37f) {
+    const float result =
+        reduced_precision::FromBfloat16(reduced_precision::ToBfloat16(value));
+    BOOST_CHECK_LE(std::fabs(result - value), value * 0x1p-8f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(encode_decode_unaligned) {
+  const std::vector<float> values = {1.0f, -3.25f, 1e-3f, 42.0f, 0.0f};
+  std::vector<char> encoded(values.size() * sizeof(uint16_t) + 1);
+  reduced_precision::Encode(values.data(), values.size(), &encoded[1]);
+  std::vector<float> decoded(values.size());
+  reduced_precision::Decode(&encoded[1], values.size(), decoded.data());
+  for (size_t i = 0; i != values.size(); ++i) {
+    BOOST_CHECK_CLOSE_FRACTION(decoded[i], values[i], 0x1p-8f);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
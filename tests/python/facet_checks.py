@@ -213,6 +213,39 @@ class TestFacets:
             f"{names[0]}-YY-image.fits", f"{names[2]}-YY-image.fits", threshold
         )
 
+    def test_wgridder_sort_by_w_with_h5(self):
+        # A small memory limit splits the data in several w-slabs, each of
+        # which passes over the solution times from the start again.
+        h5download = (
+            "wget -N -q www.astron.nl/citt/ci_data/wsclean/mock_soltab_2pol.h5"
+        )
+        validate_call(h5download.split())
+
+        names = ["facets-h5-unsorted", "facets-h5-sorted"]
+        for name, sort in zip(names, ["", "-wgridder-sort-by-w"]):
+            s = f"{tcf.WSCLEAN} -j 1 -use-wgridder {sort} -abs-mem 0.05 -name {name} -apply-facet-solutions mock_soltab_2pol.h5 ampl000,phase000 -pol xx,yy -facet-regions {tcf.FACETFILE_4FACETS} {tcf.DIMS_SMALL} -join-polarizations -interval 10 14 {tcf.MWA_MOCK_MS}"
+            validate_call(s.split())
+
+        compare_rms_fits(
+            f"{names[0]}-YY-dirty.fits", f"{names[1]}-YY-dirty.fits", 1e-6
+        )
+
+    def test_single_pass_facet_gridding(self):
+        # Gridding all facets of a facet group in a single pass over the data
+        # should give the same images as gridding each facet separately.
+        names = ["facets-separate-passes", "facets-single-pass"]
+        for name, single_pass in zip(names, ["", "-single-pass-facet-gridding"]):
+            s = f"{tcf.WSCLEAN} -j 1 -use-wgridder {single_pass} -name {name} -facet-regions {tcf.FACETFILE_4FACETS} {tcf.DIMS_SMALL} -interval 10 14 -niter 1000000 -auto-threshold 5 -mgain 0.8 {tcf.MWA_MOCK_MS}"
+            validate_call(s.split())
+
+        threshold = 1e-6
+        for image_type in ["psf", "dirty", "image"]:
+            compare_rms_fits(
+                f"{names[0]}-{image_type}.fits",
+                f"{names[1]}-{image_type}.fits",
+                threshold,
+            )
+
     @pytest.mark.parametrize("beam", [False, True])
     @pytest.mark.parametrize(
         "h5file",
@@ -2,7 +2,7 @@ import pytest
 import os, glob
 import warnings
 import sys
-from utils import validate_call
+from utils import compare_rms_fits, validate_call
 
 # Append current directory to system path in order to import testconfig
 sys.path.append(".")
@@ -340,3 +340,40 @@ class TestCommandCatalogue:
         validate_call(s.split())
         for f in glob.glob(f"{name('vla-multiband-no-mf')}*.fits"):
             os.remove(f)
+
+    def test_fused_residual_gridding(self):
+        # The fused predict-and-invert pass should give the same residual as
+        # predicting the model data and inverting it afterwards. A single major
+        # iteration without a model update makes the fused pass make the final
+        # residual.
+        names = ["residual-separate", "residual-fused"]
+        for n, fused in zip(names, ["", "-fused-residual-gridding"]):
+            s = f"{tcf.WSCLEAN} -j 1 -use-wgridder {fused} -name {name(n)} -niter 1000 -nmiter 1 -mgain 0.8 -no-update-model-required {tcf.DIMS_LARGE} {tcf.MWA_MS}"
+            validate_call(s.split())
+        compare_rms_fits(
+            f"{name(names[0])}-residual.fits", f"{name(names[1])}-residual.fits", 1e-5
+        )
+
+    def test_combined_psf_and_dirty_gridding(self):
+        # With the w-gridder, the PSF and the dirty image are made in the same
+        # visibility pass. This should give the same images as making the PSF
+        # and the dirty image in separate runs.
+        common = f"-j 1 -use-wgridder {tcf.DIMS_LARGE} {tcf.MWA_MS}"
+        runs = [
+            ("psf-dirty-combined", "-make-psf"),
+            ("psf-dirty-separate-psf", "-make-psf-only"),
+            ("psf-dirty-separate-dirty", ""),
+        ]
+        for n, option in runs:
+            s = f"{tcf.WSCLEAN} {option} -name {name(n)} {common}"
+            validate_call(s.split())
+        compare_rms_fits(
+            f"{name('psf-dirty-combined')}-psf.fits",
+            f"{name('psf-dirty-separate-psf')}-psf.fits",
+            1e-6,
+        )
+        compare_rms_fits(
+            f"{name('psf-dirty-combined')}-dirty.fits",
+            f"{name('psf-dirty-separate-dirty')}-dirty.fits",
+            1e-6,
+        )
@@ -0,0 +1,259 @@
+#include "../../structures/imageweights.h"
+
+#include "../../msproviders/msprovider.h"
+#include "../../msproviders/msreaders/msreader.h"
+
+#include <aocommon/banddata.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+constexpr size_t kWidth = 40;
+constexpr size_t kHeight = 48;
+constexpr size_t kChannelCount = 4;
+constexpr double kSpeedOfLight = 299792458.0;
+
+/**
+ * Provides rows with random uvws and weights from memory, for a single
+ * polarization. Only the functions that are needed for reading are
+ * implemented.
+ */
+class MemoryMSProvider final : public MSProvider {
+ public:
+  MemoryMSProvider(size_t nRows, unsigned seed) : _band(MakeBand()) {
+    std::mt19937 rnd(seed);
+    // With a wavelength of about one meter, the uvws fall within the grid
+    std::uniform_real_distribution<double> u(-double(kWidth) / 3.0,
+                                             double(kWidth) / 3.0);
+    std::uniform_real_distribution<double> v(-double(kHeight) / 3.0,
+                                             double(kHeight) / 3.0);
+    std::uniform_real_distribution<float> weight(0.1, 10.0);
+    for (size_t i = 0; i != nRows; ++i) {
+      _uvws.push_back(u(rnd));
+      _uvws.push_back(v(rnd));
+      _uvws.push_back(0.0);
+      for (size_t ch = 0; ch != kChannelCount; ++ch)
+        _weights.push_back(weight(rnd));
+    }
+  }
+
+  SynchronizedMS MS() override { return SynchronizedMS(); }
+  const std::string& DataColumnName() override { return _dataColumnName; }
+  void NextOutputRow() override {}
+  void ResetWritePosition() override {}
+  void WriteModel(const std::complex<float>*, bool) override {
+    throw std::runtime_error("Not implemented");
+  }
+  void ReopenRW() override {}
+  double StartTime() override { return 0.0; }
+  void MakeIdToMSRowMapping(std::vector<size_t>& idToMSRow) override {
+    for (size_t i = 0; i != NRows(); ++i) idToMSRow.push_back(i);
+  }
+  aocommon::PolarizationEnum Polarization() override {
+    return aocommon::Polarization::StokesI;
+  }
+  size_t DataDescId() override { return 0; }
+  size_t NChannels() override { return kChannelCount; }
+  size_t NAntennas() override { return 2; }
+  size_t NPolarizations() override { return 1; }
+  const aocommon::BandData& Band() override { return _band; }
+  std::unique_ptr<MSReader> MakeReader() override;
+
+  size_t NRows() const { return _uvws.size() / 3; }
+  const double* Uvw(size_t row) const { return &_uvws[row * 3]; }
+  const float* Weights(size_t row) const {
+    return &_weights[row * kChannelCount];
+  }
+
+ private:
+  static aocommon::BandData MakeBand() {
+    std::vector<aocommon::ChannelInfo> channels;
+    for (size_t ch = 0; ch != kChannelCount; ++ch)
+      channels.emplace_back(kSpeedOfLight * (1.0 + 0.05 * ch),
+                            kSpeedOfLight * 0.05);
+    return aocommon::BandData(channels);
+  }
+
+  aocommon::BandData _band;
+  std::string _dataColumnName = "DATA";
+  std::vector<double> _uvws;
+  std::vector<float> _weights;
+};
+
+class MemoryMSReader final : public MSReader {
+ public:
+  explicit MemoryMSReader(MemoryMSProvider* provider)
+      : MSReader(provider), _provider(*provider) {}
+
+  size_t RowId() const override { return _row; }
+  bool CurrentRowAvailable() override { return _row < _provider.NRows(); }
+  void NextInputRow() override { ++_row; }
+  void ReadMeta(double& u, double& v, double& w) override {
+    const double* uvw = _provider.Uvw(_row);
+    u = uvw[0];
+    v = uvw[1];
+    w = uvw[2];
+  }
+  void ReadMeta(MSProvider::MetaData& metaData) override {
+    ReadMeta(metaData.uInM, metaData.vInM, metaData.wInM);
+    metaData.fieldId = 0;
+    metaData.antenna1 = 0;
+    metaData.antenna2 = 1;
+    metaData.time = double(_row);
+  }
+  void ReadData(std::complex<float>* buffer) override {
+    std::fill_n(buffer, kChannelCount, std::complex<float>(1.0, 0.0));
+  }
+  void ReadModel(std::complex<float>* buffer) override {
+    std::fill_n(buffer, kChannelCount, std::complex<float>(0.0, 0.0));
+  }
+  void ReadWeights(float* buffer) override {
+    std::copy_n(_provider.Weights(_row), kChannelCount, buffer);
+  }
+  void WriteImagingWeights(const float*) override {
+    throw std::runtime_error("Not implemented");
+  }
+
+ private:
+  const MemoryMSProvider& _provider;
+  size_t _row = 0;
+};
+
+std::unique_ptr<MSReader> MemoryMSProvider::MakeReader() {
+  return std::unique_ptr<MSReader>(new MemoryMSReader(this));
+}
+
+std::unique_ptr<ImageWeights> MakeWeights(size_t threadCount) {
+  return std::unique_ptr<ImageWeights>(new ImageWeights(
+      WeightMode(WeightMode::UniformWeighted), kWidth, kHeight, 1.0 / kWidth,
+      1.0 / kHeight, false, 1.0, threadCount));
+}
+
+std::vector<double> GetImage(const ImageWeights& weights) {
+  std::vector<double> image(kWidth * kHeight);
+  weights.GetGrid(image.data());
+  return image;
+}
+
+/**
+ * Grids randomly placed visibilities. The pixel scales of @p weights should
+ * be such that u and v are in units of grid cells.
+ */
+void GridRandomVisibilities(ImageWeights& weights) {
+  std::mt19937 rnd;
+  std::uniform_real_distribution<double> u(-double(kWidth) / 2.0,
+                                           double(kWidth) / 2.0);
+  std::uniform_real_distribution<double> v(-double(kHeight) / 2.0,
+                                           double(kHeight) / 2.0);
+  std::uniform_real_distribution<double> weight(0.1, 10.0);
+  for (size_t i = 0; i != 300; ++i) weights.Grid(u(rnd), v(rnd), weight(rnd));
+}
+
+/**
+ * Returns the half-plane grid, with kHeight / 2 rows, of @p weights.
+ */
+std::vector<double> GetHalfGrid(const ImageWeights& weights) {
+  std::vector<double> image(kWidth * kHeight);
+  weights.GetGrid(image.data());
+  return std::vector<double>(image.begin() + kWidth * kHeight / 2,
+                             image.end());
+}
+
+/**
+ * Straightforward implementation of the rank filter: every non-zero cell is
+ * limited to rankLimit times the mean of the non-zero cells in
+ * [x - d, x + d) x [y - d, y + d), clipped to the half-plane grid.
+ */
+std::vector<double> BruteForceRankFilter(const std::vector<double>& grid,
+                                         double rankLimit, size_t windowSize) {
+  const size_t height = kHeight / 2;
+  const size_t d = windowSize / 2;
+  std::vector<double> result(grid);
+  for (size_t y = 0; y != height; ++y) {
+    for (size_t x = 0; x != kWidth; ++x) {
+      const double w = grid[y * kWidth + x];
+      if (w == 0.0) continue;
+      double sum = 0.0;
+      size_t count = 0;
+      for (size_t yi = y > d ? y - d : 0; yi < std::min(y + d, height); ++yi) {
+        for (size_t xi = x > d ? x - d : 0; xi < std::min(x + d, kWidth);
+             ++xi) {
+          const double value = grid[yi * kWidth + xi];
+          if (value != 0.0) {
+            sum += value;
+            ++count;
+          }
+        }
+      }
+      const double mean = sum / double(count);
+      if (w > mean * rankLimit) result[y * kWidth + x] = mean * rankLimit;
+    }
+  }
+  return result;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(image_weights)
+
+BOOST_AUTO_TEST_CASE(parallel_gridding) {
+  std::vector<std::unique_ptr<MemoryMSProvider>> providers;
+  for (size_t i = 0; i != 3; ++i)
+    providers.emplace_back(new MemoryMSProvider(5000 + i * 1000, i));
+
+  std::unique_ptr<ImageWeights> serial = MakeWeights(1);
+  for (std::unique_ptr<MemoryMSProvider>& provider : providers)
+    serial->Grid(*provider, provider->Band(), 1);
+  serial->FinishGridding();
+  const std::vector<double> expected = GetImage(*serial);
+
+  // The second run limits the private grids to a single one, such that the
+  // threads have to wait for each other.
+  for (size_t memoryLimit : {size_t(0), size_t(1)}) {
+    std::unique_ptr<ImageWeights> parallel = MakeWeights(4);
+    parallel->SetPrivateGridMemoryLimit(memoryLimit);
+    parallel->GridInParallel(
+        providers.size(), [&](size_t jobIndex, size_t threadCount) {
+          MemoryMSProvider& provider = *providers[jobIndex];
+          parallel->Grid(provider, provider.Band(), threadCount);
+        });
+    parallel->FinishGridding();
+    const std::vector<double> result = GetImage(*parallel);
+    BOOST_REQUIRE_EQUAL(result.size(), expected.size());
+    size_t nonZeroCount = 0;
+    for (size_t i = 0; i != result.size(); ++i) {
+      BOOST_CHECK_CLOSE(result[i], expected[i], 1e-8);
+      if (expected[i] != 0.0) ++nonZeroCount;
+    }
+    // Make sure that the test grids something
+    BOOST_CHECK_GT(nonZeroCount, kWidth * kHeight / 4);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(rank_filter) {
+  for (size_t windowSize : {1, 2, 3, 7, 16, 100}) {
+    for (double rankLimit : {1.0, 1.5, 3.0}) {
+      ImageWeights weights(WeightMode(WeightMode::UniformWeighted), kWidth,
+                           kHeight, 1.0 / kWidth, 1.0 / kHeight, false, 1.0,
+                           3);
+      GridRandomVisibilities(weights);
+      const std::vector<double> input = GetHalfGrid(weights);
+      const std::vector<double> expected =
+          BruteForceRankFilter(input, rankLimit, windowSize);
+      weights.RankFilter(rankLimit, windowSize);
+      const std::vector<double> result = GetHalfGrid(weights);
+      for (size_t i = 0; i != result.size(); ++i) {
+        BOOST_CHECK_CLOSE(result[i], expected[i], 1e-8);
+      }
+      // Make sure that the test has something to filter
+      if (windowSize == 7 && rankLimit == 1.0) BOOST_CHECK(result != input);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,70 @@
+#include "../../system/cachekey.h"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <fstream>
+
+using wsclean::system::HashToString;
+using wsclean::system::MSFingerprint;
+using wsclean::system::ReadFileContents;
+
+BOOST_AUTO_TEST_SUITE(cache_key)
+
+BOOST_AUTO_TEST_CASE(hash) {
+  // Reference values of the 64-bit FNV-1a hash
+  BOOST_CHECK_EQUAL(HashToString(""), "cbf29ce484222325");
+  BOOST_CHECK_EQUAL(HashToString("a"), "af63dc4c8601ec8c");
+  BOOST_CHECK_NE(HashToString("ab"), HashToString("ba"));
+  BOOST_CHECK_EQUAL(HashToString(std::string("a\0b", 3)).size(), 16u);
+}
+
+BOOST_AUTO_TEST_CASE(read_file_contents) {
+  constexpr const char* kFilename = "tcachekey-test.tmp";
+  const std::string contents("line 1\nline 2\0binary", 20);
+  std::ofstream(kFilename, std::ios::binary) << contents;
+  BOOST_CHECK_EQUAL(ReadFileContents(kFilename), contents);
+  boost::filesystem::remove(kFilename);
+  BOOST_CHECK_EQUAL(ReadFileContents(kFilename), "");
+}
+
+BOOST_AUTO_TEST_CASE(ms_fingerprint) {
+  const boost::filesystem::path directory("tcachekey-test.ms");
+  boost::filesystem::create_directory(directory);
+  std::ofstream((directory / "table.f0").string()) << "data";
+  const std::string fingerprint = MSFingerprint(directory.string());
+  BOOST_CHECK_EQUAL(MSFingerprint(directory.string()), fingerprint);
+
+  // Other subtables are not part of the fingerprint
+  boost::filesystem::create_directory(directory / "ANTENNA");
+  std::ofstream((directory / "ANTENNA" / "table.f0").string()) << "antenna";
+  BOOST_CHECK_EQUAL(MSFingerprint(directory.string()), fingerprint);
+
+  std::ofstream((directory / "table.f0").string(), std::ios::app) << "more";
+  const std::string mainFingerprint = MSFingerprint(directory.string());
+  BOOST_CHECK_NE(mainFingerprint, fingerprint);
+
+  // The spectral window subtable is part of the fingerprint
+  boost::filesystem::create_directory(directory / "SPECTRAL_WINDOW");
+  const std::string spwFile =
+      (directory / "SPECTRAL_WINDOW" / "table.f0").string();
+  std::ofstream(spwFile) << "spw";
+  BOOST_CHECK_NE(MSFingerprint(directory.string()), mainFingerprint);
+
+  // Modifications within the same second are detected
+  struct timespec times[2];
+  times[0].tv_sec = times[1].tv_sec = 4000000000;
+  times[0].tv_nsec = times[1].tv_nsec = 1;
+  BOOST_REQUIRE_EQUAL(utimensat(AT_FDCWD, spwFile.c_str(), times, 0), 0);
+  const std::string before = MSFingerprint(directory.string());
+  times[0].tv_nsec = times[1].tv_nsec = 2;
+  BOOST_REQUIRE_EQUAL(utimensat(AT_FDCWD, spwFile.c_str(), times, 0), 0);
+  BOOST_CHECK_NE(MSFingerprint(directory.string()), before);
+
+  boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+#include "../../system/forkjoinpool.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(fork_join_pool)
+
+BOOST_AUTO_TEST_CASE(thread_count) {
+  BOOST_CHECK_EQUAL(ForkJoinPool(4).ThreadCount(), 4u);
+  // A pool always has at least the calling thread
+  BOOST_CHECK_EQUAL(ForkJoinPool(0).ThreadCount(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(single_thread) {
+  ForkJoinPool pool(1);
+  std::vector<size_t> indices;
+  auto job = [&](size_t threadIndex) { indices.push_back(threadIndex); };
+  pool.Run(job);
+  pool.Run(job);
+  BOOST_REQUIRE_EQUAL(indices.size(), 2u);
+  BOOST_CHECK_EQUAL(indices[0], 0u);
+  BOOST_CHECK_EQUAL(indices[1], 0u);
+}
+
+BOOST_AUTO_TEST_CASE(each_index_once) {
+  constexpr size_t kThreadCount = 5;
+  ForkJoinPool pool(kThreadCount);
+  std::vector<std::atomic<size_t>> counts(kThreadCount);
+  for (std::atomic<size_t>& count : counts) count = 0;
+  std::atomic<size_t> callerIndex(kThreadCount);
+  const std::thread::id caller = std::this_thread::get_id();
+  auto job = [&](size_t threadIndex) {
+    ++counts[threadIndex];
+    if (std::this_thread::get_id() == caller) callerIndex = threadIndex;
+  };
+  pool.Run(job);
+  for (const std::atomic<size_t>& count : counts) BOOST_CHECK_EQUAL(count, 1u);
+  BOOST_CHECK_EQUAL(callerIndex, kThreadCount - 1);
+}
+
+BOOST_AUTO_TEST_CASE(repeated_runs) {
+  constexpr size_t kThreadCount = 4;
+  constexpr size_t kRunCount = 10000;
+  ForkJoinPool pool(kThreadCount);
+  std::vector<size_t> counts(kThreadCount, 0);
+  std::vector<char> isConsistent(kThreadCount, true);
+  size_t run = 0;
+  // Every run must see the results of the previous run
+  auto job = [&](size_t threadIndex) {
+    if (counts[threadIndex] != run) isConsistent[threadIndex] = false;
+    ++counts[threadIndex];
+  };
+  for (; run != kRunCount; ++run) pool.Run(job);
+  for (size_t i = 0; i != kThreadCount; ++i) {
+    BOOST_CHECK(isConsistent[i]);
+    BOOST_CHECK_EQUAL(counts[i], kRunCount);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(more_tasks_than_threads) {
+  constexpr size_t kTaskCount = 1000;
+  ForkJoinPool pool(3);
+  std::vector<std::atomic<size_t>> visits(kTaskCount);
+  for (std::atomic<size_t>& visit : visits) visit = 0;
+  std::atomic<size_t> nextTask(0);
+  auto job = [&](size_t) {
+    size_t task;
+    while ((task = nextTask.fetch_add(1)) < kTaskCount) ++visits[task];
+  };
+  pool.Run(job);
+  for (const std::atomic<size_t>& visit : visits) BOOST_CHECK_EQUAL(visit, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(parked_workers) {
+  std::atomic<size_t> calls(0);
+  auto job = [&](size_t) { ++calls; };
+  {
+    ForkJoinPool pool(4);
+    // Give the workers time to park between the runs
+    pool.Run(job);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    pool.Run(job);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  BOOST_CHECK_EQUAL(calls, 8u);
+  {
+    // Destroy a pool that never ran a job
+    ForkJoinPool pool(4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
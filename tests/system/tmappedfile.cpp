@@ -4,6 +4,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <fstream>
+#include <vector>
 
 BOOST_AUTO_TEST_SUITE(mapped_file)
 
@@ -30,4 +31,42 @@ BOOST_AUTO_TEST_CASE(map) {
   boost::filesystem::remove(kFilename);
 }
 
+BOOST_AUTO_TEST_CASE(read_only) {
+  constexpr size_t kSize = 10000;
+  constexpr const char* kFilename = "tmappedfile-readonly-test.tmp";
+
+  std::ofstream file(kFilename);
+  std::vector<char> data(kSize);
+  for (size_t i = 0; i != kSize; ++i) data[i] = i % 101;
+  file.write(data.data(), kSize);
+  file.close();
+
+  MappedFile mapped_file = MappedFile::OpenReadOnly(kFilename);
+  BOOST_CHECK_EQUAL(mapped_file.Size(), kSize);
+  mapped_file.AdviseSequential();
+  mapped_file.Prefetch(5000, 100000);
+  mapped_file.Prefetch(kSize, 10);
+  for (size_t i = 0; i != kSize; ++i) {
+    BOOST_CHECK_EQUAL(mapped_file.Data()[i], char(i % 101));
+  }
+
+  boost::filesystem::remove(kFilename);
+}
+
+BOOST_AUTO_TEST_CASE(read_only_empty) {
+  constexpr const char* kFilename = "tmappedfile-empty-test.tmp";
+  std::ofstream(kFilename).close();
+
+  const MappedFile mapped_file = MappedFile::OpenReadOnly(kFilename);
+  BOOST_CHECK_EQUAL(mapped_file.Size(), 0u);
+  BOOST_CHECK(mapped_file.Data() == nullptr);
+
+  boost::filesystem::remove(kFilename);
+}
+
+BOOST_AUTO_TEST_CASE(read_only_missing) {
+  BOOST_CHECK_THROW(MappedFile::OpenReadOnly("tmappedfile-does-not-exist.tmp"),
+                    std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+#include "../../system/spsc_ring.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(spsc_ring_test)
+
+BOOST_AUTO_TEST_CASE(capacity) {
+  spsc_ring<int> ring(5);
+  BOOST_CHECK_EQUAL(ring.capacity(), 8u);
+  BOOST_CHECK(ring.empty());
+  ring.resize(16);
+  BOOST_CHECK_EQUAL(ring.capacity(), 16u);
+}
+
+BOOST_AUTO_TEST_CASE(single_thread) {
+  spsc_ring<int> ring(4);
+  ring.write(1);
+  ring.write(2);
+  BOOST_CHECK_EQUAL(ring.size(), 2u);
+  int value = 0;
+  BOOST_CHECK(ring.read(value));
+  BOOST_CHECK_EQUAL(value, 1);
+  int values[3] = {3, 4, 5};
+  ring.move_write(values, 3);
+  ring.write_end();
+  int result[8];
+  BOOST_CHECK_EQUAL(ring.read(result, 8), 4u);
+  BOOST_CHECK_EQUAL(result[0], 2);
+  BOOST_CHECK_EQUAL(result[3], 5);
+  BOOST_CHECK(!ring.read(value));
+  BOOST_CHECK_EQUAL(ring.read(result, 8), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(move_only) {
+  spsc_ring<std::unique_ptr<int>> ring(2);
+  ring.write(std::make_unique<int>(7));
+  ring.write_end();
+  std::unique_ptr<int> value;
+  BOOST_REQUIRE(ring.read(value));
+  BOOST_CHECK_EQUAL(*value, 7);
+  BOOST_CHECK(!ring.read(value));
+}
+
+BOOST_AUTO_TEST_CASE(threaded) {
+  constexpr size_t kCount = 100000;
+  spsc_ring<size_t> ring(64);
+  std::thread producer([&]() {
+    std::vector<size_t> block;
+    for (size_t i = 0; i != kCount; ++i) {
+      if (i % 3 == 0) {
+        ring.write(i);
+      } else {
+        block.push_back(i);
+        if (block.size() == 37 || i + 1 == kCount) {
+          ring.move_write(block.data(), block.size());
+          block.clear();
+        } else if (i % 3 == 2) {
+          ring.move_write(block.data(), block.size());
+          block.clear();
+        }
+      }
+    }
+    ring.write_end();
+  });
+  size_t expected = 0;
+  bool isOrdered = true;
+  std::vector<size_t> buffer(13);
+  size_t n;
+  while ((n = ring.read(buffer.data(), buffer.size())) != 0) {
+    for (size_t i = 0; i != n; ++i) {
+      isOrdered = isOrdered && buffer[i] == expected;
+      ++expected;
+    }
+  }
+  producer.join();
+  BOOST_CHECK(isOrdered);
+  BOOST_CHECK_EQUAL(expected, kCount);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
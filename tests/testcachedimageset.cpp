@@ -11,6 +11,8 @@
 
 #include <math.h>
 #include <limits>
+#include <memory>
+#include <vector>
 
 using aocommon::PolarizationEnum;
 using schaapcommon::facets::Facet;
@@ -131,4 +133,41 @@ BOOST_AUTO_TEST_CASE(store_and_load_facet) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(store_in_memory_budget) {
+  const size_t width = 4;
+  const size_t height = 4;
+  aocommon::FitsWriter writer;
+  writer.SetImageDimensions(width, height, 0.01, 0.01);
+
+  CachedImageSet cSet;
+  cSet.Initialize(writer, 1, 2, 0, "memorytest");
+  // Room for only one image
+  cSet.SetMemoryBudget(std::make_shared<CachedImageSet::MemoryBudget>(
+      width * height * sizeof(float)));
+  BOOST_CHECK(cSet.Empty());
+
+  const std::vector<float> first(width * height, 1.0f);
+  const std::vector<float> second(width * height, 2.0f);
+  cSet.Store(first.data(), aocommon::Polarization::StokesI, 0, false);
+  BOOST_CHECK(!cSet.Empty());
+  BOOST_CHECK(cSet.GetStoredNames().empty());
+
+  // The second image does not fit and should be spilled to disk
+  cSet.Store(second.data(), aocommon::Polarization::StokesI, 1, false);
+  BOOST_CHECK_EQUAL(cSet.GetStoredNames().size(), 1u);
+
+  // Replacing an image that is in memory does not need additional memory
+  cSet.Store(second.data(), aocommon::Polarization::StokesI, 0, false);
+  BOOST_CHECK_EQUAL(cSet.GetStoredNames().size(), 1u);
+
+  std::vector<float> loaded(width * height);
+  cSet.Load(loaded.data(), aocommon::Polarization::StokesI, 0, false);
+  BOOST_CHECK_EQUAL_COLLECTIONS(loaded.begin(), loaded.end(), second.begin(),
+                                second.end());
+  std::vector<double> loadedDouble(width * height);
+  cSet.Load(loadedDouble.data(), aocommon::Polarization::StokesI, 1, false);
+  BOOST_CHECK_EQUAL_COLLECTIONS(loadedDouble.begin(), loadedDouble.end(),
+                                second.begin(), second.end());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
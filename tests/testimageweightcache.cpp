@@ -0,0 +1,68 @@
+#include "../io/imageweightcache.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace {
+constexpr size_t kSize = 16;
+
+std::unique_ptr<ImageWeightCache> MakeCache() {
+  // Without measurement sets and filters, the cache produces empty weights
+  return std::make_unique<ImageWeightCache>(
+      WeightMode(WeightMode::UniformWeighted), kSize, kSize, 0.01, 0.01, 0.0,
+      0.0, 0.0, 16, false, 1);
+}
+
+bool FileExists(const std::string& filename) {
+  return std::ifstream(filename).good();
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(imageweightcache)
+
+BOOST_AUTO_TEST_CASE(least_recently_used) {
+  const std::vector<std::unique_ptr<MSDataDescription>> msList;
+  std::unique_ptr<ImageWeightCache> cache = MakeCache();
+  cache->SetMaxCachedEntries(2);
+
+  const std::shared_ptr<ImageWeights> a = cache->Get(msList, 0, 0);
+  BOOST_CHECK(cache->Get(msList, 0, 0) == a);
+  const std::shared_ptr<ImageWeights> b = cache->Get(msList, 1, 0);
+  BOOST_CHECK(b != a);
+  BOOST_CHECK(cache->Get(msList, 0, 0) == a);
+
+  // Channel 1 is now the least recently used and is dropped
+  const std::shared_ptr<ImageWeights> c = cache->Get(msList, 0, 1);
+  BOOST_CHECK(cache->Get(msList, 0, 0) == a);
+  BOOST_CHECK(cache->Get(msList, 0, 1) == c);
+  BOOST_CHECK(cache->Get(msList, 1, 0) != b);
+}
+
+BOOST_AUTO_TEST_CASE(spill) {
+  const std::vector<std::unique_ptr<MSDataDescription>> msList;
+  const std::string spillFilename = "weightcachetest-0-0.tmp";
+  std::unique_ptr<ImageWeightCache> cache = MakeCache();
+  cache->SetSpillPrefix("weightcachetest");
+
+  const std::shared_ptr<ImageWeights> a = cache->Get(msList, 0, 0);
+  a->SetAllValues(2.5);
+  BOOST_CHECK(!FileExists(spillFilename));
+  cache->Get(msList, 1, 0);
+  BOOST_CHECK(FileExists(spillFilename));
+
+  const std::shared_ptr<ImageWeights> loaded = cache->Get(msList, 0, 0);
+  BOOST_CHECK(loaded != a);
+  BOOST_REQUIRE_EQUAL(loaded->Width(), a->Width());
+  BOOST_REQUIRE_EQUAL(loaded->Height(), a->Height());
+  std::vector<double> grid(loaded->Width() * loaded->Height());
+  loaded->GetGrid(grid.data());
+  for (double value : grid) BOOST_CHECK_EQUAL(value, 2.5);
+
+  cache.reset();
+  BOOST_CHECK(!FileExists(spillFilename));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,12 +1,15 @@
 #include <boost/test/unit_test.hpp>
 
 #include "../scheduling/griddingtask.h"
+#include "../scheduling/metadatacache.h"
 #include "../idg/averagebeam.h"
 
 #include <aocommon/image.h>
 #include <aocommon/io/serialostream.h>
 #include <aocommon/io/serialistream.h>
 
+#include <cstdio>
+
 using aocommon::SerialIStream;
 using aocommon::SerialOStream;
 
@@ -95,4 +98,38 @@ BOOST_AUTO_TEST_CASE(image) {
   BOOST_CHECK_EQUAL_COLLECTIONS(a.begin(), a.end(), b.begin(), b.end());
 }
 
+BOOST_AUTO_TEST_CASE(meta_data_cache_file) {
+  constexpr const char* kFilename = "tserialization-metadata.tmp";
+  MetaDataCache a;
+  a.msDataVector.resize(2);
+  for (size_t i = 0; i != 2; ++i) {
+    a.msDataVector[i] =
+        MetaDataCache::Entry{0.5 + i, 10.0 + i, 11.0 + i, 100.0 + i, 2.0 + i,
+                             8.0 + i};
+  }
+  a.Save(kFilename, "key");
+
+  MetaDataCache b;
+  BOOST_CHECK(!b.Load(kFilename, "other key"));
+  BOOST_CHECK(!b.Load(kFilename, "kez"));
+  BOOST_CHECK(b.msDataVector.empty());
+  BOOST_CHECK(!b.Load("tserialization-does-not-exist.tmp", "key"));
+
+  BOOST_REQUIRE(b.Load(kFilename, "key"));
+  BOOST_REQUIRE_EQUAL(b.msDataVector.size(), 2u);
+  for (size_t i = 0; i != 2; ++i) {
+    BOOST_CHECK_EQUAL(b.msDataVector[i].minW, a.msDataVector[i].minW);
+    BOOST_CHECK_EQUAL(b.msDataVector[i].maxW, a.msDataVector[i].maxW);
+    BOOST_CHECK_EQUAL(b.msDataVector[i].maxWWithFlags,
+                      a.msDataVector[i].maxWWithFlags);
+    BOOST_CHECK_EQUAL(b.msDataVector[i].maxBaselineUVW,
+                      a.msDataVector[i].maxBaselineUVW);
+    BOOST_CHECK_EQUAL(b.msDataVector[i].maxBaselineInM,
+                      a.msDataVector[i].maxBaselineInM);
+    BOOST_CHECK_EQUAL(b.msDataVector[i].integrationTime,
+                      a.msDataVector[i].integrationTime);
+  }
+  std::remove(kFilename);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -13,14 +13,34 @@
 
 #include <aocommon/image.h>
 #include <aocommon/logger.h>
+#include <aocommon/parallelfor.h>
 
 #include <schaapcommon/fft/resampler.h>
 
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 
+#include <array>
+#include <cmath>
+#include <future>
+#include <stdexcept>
+
 using aocommon::Image;
 using aocommon::Logger;
 
+namespace {
+constexpr size_t kWBinCount = 65536;
+
+/**
+ * Histogram bin of a row with w coordinate @p w in meters, used to sort rows
+ * on |w|.
+ */
+size_t WBin(double w, double maxAbsW) {
+  if (maxAbsW <= 0.0) return 0;
+  const size_t bin = std::fabs(w) / maxAbsW * kWBinCount;
+  return std::min(bin, kWBinCount - 1);
+}
+}  // namespace
+
 WGriddingMSGridder::WGriddingMSGridder(const Settings& settings)
     : MSGridderBase(settings),
       _cpuCount(_settings.threadCount),
@@ -33,9 +53,24 @@ WGriddingMSGridder::WGriddingMSGridder(const Settings& settings)
 }
 
 size_t WGriddingMSGridder::calculateMaxNRowsInMemory(
-    size_t channelCount) const {
+    size_t channelCount, bool withModel, size_t bufferCount) const {
   size_t constantMem, perVisMem;
   _gridder->memUsage(constantMem, perVisMem);
+  if (withModel) {
+    // A second gridder for the prediction, and room for the predicted model
+    // visibilities
+    size_t predictConstantMem, predictPerVisMem;
+    _gridder->memUsage(predictConstantMem, predictPerVisMem);
+    constantMem += predictConstantMem;
+    perVisMem += predictPerVisMem + sizeof(std::complex<float>);
+  }
+  return calculateMaxNRowsForMemUsage(constantMem, perVisMem, channelCount,
+                                      bufferCount);
+}
+
+size_t WGriddingMSGridder::calculateMaxNRowsForMemUsage(
+    size_t constantMem, size_t perVisMem, size_t channelCount,
+    size_t bufferCount) const {
   if (int64_t(constantMem) >= _memSize) {
     constantMem = _memSize / 2;
     Logger::Warn << "Not enough memory available for doing the gridding:\n"
@@ -43,9 +78,16 @@ size_t WGriddingMSGridder::calculateMaxNRowsInMemory(
   }
   uint64_t memForBuffers = _memSize - constantMem;
 
-  uint64_t memPerRow = (perVisMem + sizeof(std::complex<float>)) *
-                           channelCount       // vis themselves
-                       + sizeof(double) * 3;  // uvw
+  // For each buffer: the visibilities themselves, their weights, the model
+  // visibilities when the model is subtracted, and the row metadata of a
+  // MSReader::RowBlock: uvw, time, antenna1, antenna2, fieldId and rowId.
+  const size_t perVisBufferMem =
+      sizeof(std::complex<float>) * (DoSubtractModel() ? 2 : 1) +
+      sizeof(float);
+  const size_t perRowBufferMem = sizeof(double) * 4 + sizeof(size_t) * 4;
+  uint64_t memPerRow =
+      perVisMem * channelCount +
+      (perVisBufferMem * channelCount + perRowBufferMem) * bufferCount;
   size_t maxNRows = std::max(memForBuffers / memPerRow, uint64_t(100));
   if (maxNRows < 1000) {
     Logger::Warn << "Less than 1000 data rows fit in memory: this probably "
@@ -60,23 +102,77 @@ void WGriddingMSGridder::gridMeasurementSet(MSData& msData) {
   const aocommon::BandData selectedBand(msData.SelectedBand());
   StartMeasurementSet(msData, false);
 
-  aocommon::UVector<std::complex<float>> modelBuffer(
-      selectedBand.ChannelCount());
-  aocommon::UVector<float> weightBuffer(selectedBand.ChannelCount());
-  aocommon::UVector<bool> isSelected(selectedBand.ChannelCount(), true);
-
   size_t totalNRows = 0;
   aocommon::UVector<double> frequencies(selectedBand.ChannelCount());
   for (size_t i = 0; i != frequencies.size(); ++i)
     frequencies[i] = selectedBand.ChannelFrequency(i);
 
-  size_t maxNRows = calculateMaxNRowsInMemory(selectedBand.ChannelCount());
+  if (_settings.wgridderSortByW && canWeightVisibilityBlocks()) {
+    // Three chunks are in memory: the block being read, the chunk that is
+    // filled and the chunk that is being gridded.
+    const size_t maxNRows =
+        calculateMaxNRowsInMemory(selectedBand.ChannelCount(), false, 3);
+    const double maxAbsW =
+        msData.maxWWithFlags * selectedBand.SmallestWavelength();
+    const std::vector<size_t> wSlabs =
+        calculateWSlabs(msData, maxAbsW, maxNRows);
+    if (!wSlabs.empty()) {
+      gridWSortedMeasurementSet<GainEntry>(msData, wSlabs, maxAbsW, maxNRows);
+      return;
+    }
+  }
+
+  std::unique_ptr<MSReader> msReader = msData.msProvider->MakeReader();
+
+  if (canWeightVisibilityBlocks()) {
+    // Read every chunk with a single call, and grid directly from the
+    // structure-of-arrays buffers of the block. While a chunk is gridded in
+    // the background, the next chunk is read and weighted in this thread.
+    const size_t maxNRows =
+        calculateMaxNRowsInMemory(selectedBand.ChannelCount(), false, 2);
+    Logger::Debug << "Max " << maxNRows << " rows fit in memory.\n";
+    std::array<MSReader::RowBlock, 2> blocks;
+    auto readBlock = [&](MSReader::RowBlock& block) {
+      block.nRows = 0;
+      if (msReader->CurrentRowAvailable()) {
+        Logger::Info << "Loading data in memory...\n";
+        msReader->ReadBlock(maxNRows, block, !DoImagePSF(), DoSubtractModel());
+        weightVisibilityBlock<1, GainEntry>(
+            block, block.data.data(), block.weights.data(),
+            block.model.data(), msData.antennaNames, selectedBand);
+      }
+    };
+
+    readBlock(blocks[0]);
+    size_t current = 0;
+    while (blocks[current].nRows != 0) {
+      const MSReader::RowBlock& block = blocks[current];
+      Logger::Info << "Gridding " << block.nRows << " rows...\n";
+      std::future<void> gridding = std::async(std::launch::async, [&]() {
+        _gridder->AddInversionData(block.nRows, selectedBand.ChannelCount(),
+                                   block.uvw.data(), frequencies.data(),
+                                   block.data.data());
+      });
+      readBlock(blocks[1 - current]);
+      gridding.get();
+      totalNRows += block.nRows;
+      current = 1 - current;
+    }
+    msData.totalRowsProcessed += totalNRows;
+    return;
+  }
+
+  const size_t maxNRows =
+      calculateMaxNRowsInMemory(selectedBand.ChannelCount());
+  aocommon::UVector<std::complex<float>> modelBuffer(
+      selectedBand.ChannelCount());
+  aocommon::UVector<float> weightBuffer(selectedBand.ChannelCount());
+  aocommon::UVector<bool> isSelected(selectedBand.ChannelCount(), true);
 
   aocommon::UVector<std::complex<float>> visBuffer(maxNRows *
                                                    selectedBand.ChannelCount());
   aocommon::UVector<double> uvwBuffer(maxNRows * 3);
 
-  std::unique_ptr<MSReader> msReader = msData.msProvider->MakeReader();
   aocommon::UVector<std::complex<float>> newItemData(
       selectedBand.ChannelCount());
   InversionRow newRowData;
@@ -126,6 +222,106 @@ template void WGriddingMSGridder::gridMeasurementSet<DDGainMatrix::kYY>(
 template void WGriddingMSGridder::gridMeasurementSet<DDGainMatrix::kTrace>(
     MSData& msData);
 
+std::vector<size_t> WGriddingMSGridder::calculateWSlabs(
+    const MSData& msData, double maxAbsW, size_t maxNRows) const {
+  Logger::Info << "Sorting rows on w... ";
+  Logger::Info.Flush();
+  std::vector<size_t> histogram(kWBinCount, 0);
+  size_t nRows = 0;
+  std::unique_ptr<MSReader> msReader = msData.msProvider->MakeReader();
+  while (msReader->CurrentRowAvailable()) {
+    double uInMeters, vInMeters, wInMeters;
+    msReader->ReadMeta(uInMeters, vInMeters, wInMeters);
+    ++histogram[WBin(wInMeters, maxAbsW)];
+    ++nRows;
+    msReader->NextInputRow();
+  }
+  if (nRows <= maxNRows) {
+    Logger::Info << "not necessary, all rows fit in memory.\n";
+    return {};
+  }
+
+  // A bin with more than maxNRows rows forms a slab by itself, which is then
+  // gridded in several chunks.
+  std::vector<size_t> wSlabs{0};
+  size_t slabRows = 0;
+  for (size_t bin = 0; bin != kWBinCount; ++bin) {
+    if (slabRows != 0 && slabRows + histogram[bin] > maxNRows) {
+      wSlabs.push_back(bin);
+      slabRows = 0;
+    }
+    slabRows += histogram[bin];
+  }
+  wSlabs.push_back(kWBinCount);
+  Logger::Info << "DONE (" << wSlabs.size() - 1 << " w-slabs)\n";
+  return wSlabs;
+}
+
+template <DDGainMatrix GainEntry>
+void WGriddingMSGridder::gridWSortedMeasurementSet(
+    MSData& msData, const std::vector<size_t>& wSlabs, double maxAbsW,
+    size_t maxNRows) {
+  const aocommon::BandData selectedBand(msData.SelectedBand());
+  aocommon::UVector<double> frequencies(selectedBand.ChannelCount());
+  for (size_t i = 0; i != frequencies.size(); ++i)
+    frequencies[i] = selectedBand.ChannelFrequency(i);
+
+  size_t totalNRows = 0;
+  MSReader::RowBlock block;
+  std::array<MSReader::RowBlock, 2> chunks;
+  size_t current = 0;
+  std::future<void> gridding;
+  // Weights the current chunk and grids it in the background, while the next
+  // chunk is filled. Rows are weighted in the order in which they were read,
+  // so that the time-dependent direction-dependent effects are not
+  // recalculated for every row.
+  auto gridChunk = [&]() {
+    MSReader::RowBlock& chunk = chunks[current];
+    weightVisibilityBlock<1, GainEntry>(
+        chunk, chunk.data.data(), chunk.weights.data(), chunk.model.data(),
+        msData.antennaNames, selectedBand);
+    if (gridding.valid()) gridding.get();
+    Logger::Info << "Gridding " << chunk.nRows << " rows...\n";
+    gridding = std::async(std::launch::async, [&, griddedChunk = &chunk]() {
+      _gridder->AddInversionData(
+          griddedChunk->nRows, selectedBand.ChannelCount(),
+          griddedChunk->uvw.data(), frequencies.data(),
+          griddedChunk->data.data());
+    });
+    totalNRows += chunk.nRows;
+    current = 1 - current;
+    chunks[current].nRows = 0;
+  };
+
+  for (size_t slab = 0; slab + 1 < wSlabs.size(); ++slab) {
+    Logger::Info << "Loading data for w-slab " << (slab + 1) << " of "
+                 << (wSlabs.size() - 1) << "...\n";
+    // Each slab reads the measurement set from the start again
+    rewindDdEffectTimes();
+    std::unique_ptr<MSReader> msReader = msData.msProvider->MakeReader();
+    while (msReader->CurrentRowAvailable()) {
+      msReader->ReadBlock(maxNRows, block, !DoImagePSF(), DoSubtractModel());
+      if (chunks[current].rowSize != block.rowSize) {
+        // The chunk that is being gridded can not be resized
+        if (gridding.valid()) gridding.get();
+        for (MSReader::RowBlock& chunk : chunks)
+          chunk.Reserve(maxNRows, block.rowSize, DoSubtractModel());
+      }
+      for (size_t row = 0; row != block.nRows; ++row) {
+        const size_t bin = WBin(block.uvw[row * 3 + 2], maxAbsW);
+        if (bin >= wSlabs[slab] && bin < wSlabs[slab + 1]) {
+          if (chunks[current].nRows == maxNRows) gridChunk();
+          chunks[current].AppendRow(block, row, DoSubtractModel());
+        }
+      }
+    }
+    if (chunks[current].nRows != 0) gridChunk();
+  }
+  if (gridding.valid()) gridding.get();
+
+  msData.totalRowsProcessed += totalNRows;
+}
+
 template <DDGainMatrix GainEntry>
 void WGriddingMSGridder::predictMeasurementSet(MSData& msData) {
   msData.msProvider->ReopenRW();
@@ -138,40 +334,66 @@ void WGriddingMSGridder::predictMeasurementSet(MSData& msData) {
   for (size_t i = 0; i != frequencies.size(); ++i)
     frequencies[i] = selectedBand.ChannelFrequency(i);
 
-  size_t maxNRows = calculateMaxNRowsInMemory(selectedBand.ChannelCount());
+  // Two chunks are in memory: while one chunk is predicted in the background,
+  // the previous chunk is written and the next chunk is read in this thread.
+  const size_t maxNRows =
+      calculateMaxNRowsInMemory(selectedBand.ChannelCount(), false, 2);
+  struct Chunk {
+    size_t nRows = 0;
+    aocommon::UVector<double> uvw;
+    aocommon::UVector<std::complex<float>> visibilities;
+  };
+  std::array<Chunk, 2> chunks;
+  for (Chunk& chunk : chunks) {
+    chunk.uvw.resize(maxNRows * 3);
+    chunk.visibilities.resize(maxNRows * selectedBand.ChannelCount());
+  }
 
-  aocommon::UVector<double> uvwBuffer(maxNRows * 3);
-  // Iterate over chunks until all data has been gridded
   msData.msProvider->ResetWritePosition();
   std::unique_ptr<MSReader> msReader = msData.msProvider->MakeReader();
-  while (msReader->CurrentRowAvailable()) {
-    size_t nRows = 0;
-    // Read / fill the chunk
-    while (msReader->CurrentRowAvailable() && nRows < maxNRows) {
+  auto readChunk = [&](Chunk& chunk) {
+    chunk.nRows = 0;
+    while (msReader->CurrentRowAvailable() && chunk.nRows < maxNRows) {
       double uInMeters, vInMeters, wInMeters;
       msReader->ReadMeta(uInMeters, vInMeters, wInMeters);
-      uvwBuffer[nRows * 3] = uInMeters;
-      uvwBuffer[nRows * 3 + 1] = vInMeters;
-      uvwBuffer[nRows * 3 + 2] = wInMeters;
-      ++nRows;
+      chunk.uvw[chunk.nRows * 3] = uInMeters;
+      chunk.uvw[chunk.nRows * 3 + 1] = vInMeters;
+      chunk.uvw[chunk.nRows * 3 + 2] = wInMeters;
+      ++chunk.nRows;
       msReader->NextInputRow();
     }
-
-    Logger::Info << "Predicting " << nRows << " rows...\n";
-    aocommon::UVector<std::complex<float>> visBuffer(
-        maxNRows * selectedBand.ChannelCount());
-    _gridder->PredictVisibilities(nRows, selectedBand.ChannelCount(),
-                                  uvwBuffer.data(), frequencies.data(),
-                                  visBuffer.data());
-
+  };
+  auto writeChunk = [&](Chunk& chunk) {
     Logger::Info << "Writing...\n";
-    for (size_t row = 0; row != nRows; ++row) {
+    for (size_t row = 0; row != chunk.nRows; ++row) {
       writeVisibilities<1, GainEntry>(
           *msData.msProvider, msData.antennaNames, selectedBand,
-          &visBuffer[row * selectedBand.ChannelCount()]);
+          &chunk.visibilities[row * selectedBand.ChannelCount()]);
     }
-    totalNRows += nRows;
-  }  // end of chunk
+    totalNRows += chunk.nRows;
+  };
+
+  readChunk(chunks[0]);
+  size_t current = 0;
+  bool hasPrevious = false;
+  while (chunks[current].nRows != 0) {
+    Chunk& chunk = chunks[current];
+    Logger::Info << "Predicting " << chunk.nRows << " rows...\n";
+    std::future<void> prediction = std::async(std::launch::async, [&]() {
+      _gridder->PredictVisibilities(chunk.nRows, selectedBand.ChannelCount(),
+                                    chunk.uvw.data(), frequencies.data(),
+                                    chunk.visibilities.data());
+    });
+    // The other buffer holds the previous chunk, which is written before the
+    // buffer is reused for the next chunk.
+    Chunk& other = chunks[1 - current];
+    if (hasPrevious) writeChunk(other);
+    readChunk(other);
+    prediction.get();
+    hasPrevious = true;
+    current = 1 - current;
+  }
+  if (hasPrevious) writeChunk(chunks[1 - current]);
 
   msData.totalRowsProcessed += totalNRows;
 }
@@ -183,6 +405,157 @@ template void WGriddingMSGridder::predictMeasurementSet<DDGainMatrix::kYY>(
 template void WGriddingMSGridder::predictMeasurementSet<DDGainMatrix::kTrace>(
     MSData& msData);
 
+template <DDGainMatrix GainEntry>
+void WGriddingMSGridder::gridFacetGroupMeasurementSet(
+    const std::vector<WGriddingMSGridder*>& gridders,
+    std::vector<std::vector<MSData>>& msDataVectors, size_t msIndex) {
+  const size_t nFacets = gridders.size();
+  const WGriddingMSGridder& first = *gridders.front();
+  MSData& msData = msDataVectors.front()[msIndex];
+  for (size_t facet = 0; facet != nFacets; ++facet)
+    gridders[facet]->StartMeasurementSet(msDataVectors[facet][msIndex], false);
+
+  const aocommon::BandData selectedBand(msData.SelectedBand());
+  const size_t nChannels = selectedBand.ChannelCount();
+  aocommon::UVector<double> frequencies(nChannels);
+  for (size_t i = 0; i != frequencies.size(); ++i)
+    frequencies[i] = selectedBand.ChannelFrequency(i);
+
+  // All facet gridders are in memory at the same time, and each facet
+  // weights its own copy of the visibilities and weights of a chunk.
+  size_t constantMem = 0;
+  size_t perVisMem = 0;
+  for (const WGriddingMSGridder* gridder : gridders) {
+    size_t facetConstantMem, facetPerVisMem;
+    gridder->_gridder->memUsage(facetConstantMem, facetPerVisMem);
+    constantMem += facetConstantMem;
+    perVisMem += facetPerVisMem + sizeof(std::complex<float>) + sizeof(float);
+  }
+  const size_t maxNRows =
+      first.calculateMaxNRowsForMemUsage(constantMem, perVisMem, nChannels, 1);
+
+  std::vector<aocommon::UVector<std::complex<float>>> facetData(nFacets);
+  std::vector<aocommon::UVector<float>> facetWeights(nFacets);
+  for (size_t facet = 0; facet != nFacets; ++facet) {
+    facetData[facet].resize(maxNRows * nChannels);
+    facetWeights[facet].resize(maxNRows * nChannels);
+  }
+
+  aocommon::ParallelFor<size_t> loop(
+      std::min<size_t>(first._settings.threadCount, nFacets));
+  size_t totalNRows = 0;
+  std::unique_ptr<MSReader> msReader = msData.msProvider->MakeReader();
+  MSReader::RowBlock block;
+  while (msReader->CurrentRowAvailable()) {
+    Logger::Debug << "Max " << maxNRows << " rows fit in memory.\n";
+    Logger::Info << "Loading data in memory...\n";
+    const size_t nRows = msReader->ReadBlock(
+        maxNRows, block, !first.DoImagePSF(), first.DoSubtractModel());
+    const size_t blockSize = nRows * nChannels;
+
+    Logger::Info << "Gridding " << nRows << " rows for " << nFacets
+                 << " facets...\n";
+    loop.Run(0, nFacets, [&](size_t facet, size_t) {
+      WGriddingMSGridder& gridder = *gridders[facet];
+      std::complex<float>* data = facetData[facet].data();
+      float* weights = facetWeights[facet].data();
+      std::copy_n(block.data.data(), blockSize, data);
+      std::copy_n(block.weights.data(), blockSize, weights);
+      gridder.weightVisibilityBlock<1, GainEntry>(
+          block, data, weights, block.model.data(),
+          msDataVectors[facet][msIndex].antennaNames, selectedBand);
+      gridder._gridder->AddInversionData(nRows, nChannels, block.uvw.data(),
+                                         frequencies.data(), data);
+    });
+
+    totalNRows += nRows;
+  }
+  for (std::vector<MSData>& msDataVector : msDataVectors)
+    msDataVector[msIndex].totalRowsProcessed += totalNRows;
+}
+
+void WGriddingMSGridder::gridResidualMeasurementSet(
+    MSData& msData, const WGriddingGridder_Simple& predictGridder) {
+  const aocommon::BandData selectedBand(msData.SelectedBand());
+  StartMeasurementSet(msData, false);
+
+  const size_t nChannels = selectedBand.ChannelCount();
+  aocommon::UVector<double> frequencies(nChannels);
+  for (size_t i = 0; i != frequencies.size(); ++i)
+    frequencies[i] = selectedBand.ChannelFrequency(i);
+
+  // Both gridders keep an image in memory, and the predicted visibilities
+  // take the place of the model that would otherwise have been read.
+  const size_t maxNRows = calculateMaxNRowsInMemory(nChannels, true);
+  aocommon::UVector<std::complex<float>> modelBuffer(maxNRows * nChannels);
+
+  size_t totalNRows = 0;
+  std::unique_ptr<MSReader> msReader = msData.msProvider->MakeReader();
+  MSReader::RowBlock block;
+  while (msReader->CurrentRowAvailable()) {
+    Logger::Debug << "Max " << maxNRows << " rows fit in memory.\n";
+    Logger::Info << "Loading data in memory...\n";
+    const size_t nRows = msReader->ReadBlock(maxNRows, block, true, false);
+
+    Logger::Info << "Predicting " << nRows << " rows...\n";
+    predictGridder.PredictVisibilities(nRows, nChannels, block.uvw.data(),
+                                       frequencies.data(), modelBuffer.data());
+    // No direction-dependent effects are applied in this mode, so the gain
+    // entry is not used.
+    weightVisibilityBlock<1, DDGainMatrix::kTrace>(
+        block, block.data.data(), block.weights.data(), modelBuffer.data(),
+        msData.antennaNames, selectedBand);
+
+    Logger::Info << "Gridding " << nRows << " rows...\n";
+    _gridder->AddInversionData(nRows, nChannels, block.uvw.data(),
+                               frequencies.data(), block.data.data());
+
+    totalNRows += nRows;
+  }
+  msData.totalRowsProcessed += totalNRows;
+}
+
+template <DDGainMatrix GainEntry>
+void WGriddingMSGridder::gridWithPSFMeasurementSet(
+    MSData& msData, WGriddingGridder_Simple& psfGridder) {
+  const aocommon::BandData selectedBand(msData.SelectedBand());
+  StartMeasurementSet(msData, false);
+
+  const size_t nChannels = selectedBand.ChannelCount();
+  aocommon::UVector<double> frequencies(nChannels);
+  for (size_t i = 0; i != frequencies.size(); ++i)
+    frequencies[i] = selectedBand.ChannelFrequency(i);
+
+  // The PSF gridder and the PSF visibilities take the same memory as a
+  // prediction gridder with its predicted visibilities.
+  const size_t maxNRows = calculateMaxNRowsInMemory(nChannels, true);
+  aocommon::UVector<std::complex<float>> psfData(maxNRows * nChannels);
+
+  size_t totalNRows = 0;
+  std::unique_ptr<MSReader> msReader = msData.msProvider->MakeReader();
+  MSReader::RowBlock block;
+  while (msReader->CurrentRowAvailable()) {
+    Logger::Debug << "Max " << maxNRows << " rows fit in memory.\n";
+    Logger::Info << "Loading data in memory...\n";
+    const size_t nRows =
+        msReader->ReadBlock(maxNRows, block, true, DoSubtractModel());
+    weightVisibilityBlock<1, GainEntry>(
+        block, block.data.data(), block.weights.data(), block.model.data(),
+        msData.antennaNames, selectedBand);
+    psfVisibilityBlock(block, block.weights.data(), selectedBand,
+                       psfData.data());
+
+    Logger::Info << "Gridding " << nRows << " rows for PSF and image...\n";
+    psfGridder.AddInversionData(nRows, nChannels, block.uvw.data(),
+                                frequencies.data(), psfData.data());
+    _gridder->AddInversionData(nRows, nChannels, block.uvw.data(),
+                               frequencies.data(), block.data.data());
+
+    totalNRows += nRows;
+  }
+  msData.totalRowsProcessed += totalNRows;
+}
+
 void WGriddingMSGridder::getActualTrimmedSize(size_t& trimmedWidth,
                                               size_t& trimmedHeight) const {
   trimmedWidth = std::ceil(ActualInversionWidth() / ImagePadding());
@@ -202,17 +575,22 @@ void WGriddingMSGridder::getActualTrimmedSize(size_t& trimmedWidth,
   trimmedHeight = std::min(trimmedHeight, ActualInversionHeight());
 }
 
-void WGriddingMSGridder::Invert() {
-  std::vector<MSData> msDataVector;
-  initializeMSDataVector(msDataVector);
-
+std::unique_ptr<WGriddingGridder_Simple> WGriddingMSGridder::makeGridder()
+    const {
   size_t trimmedWidth, trimmedHeight;
   getActualTrimmedSize(trimmedWidth, trimmedHeight);
 
-  _gridder.reset(new WGriddingGridder_Simple(
+  return std::unique_ptr<WGriddingGridder_Simple>(new WGriddingGridder_Simple(
       ActualInversionWidth(), ActualInversionHeight(), trimmedWidth,
       trimmedHeight, ActualPixelSizeX(), ActualPixelSizeY(), PhaseCentreDL(),
       PhaseCentreDM(), _cpuCount, _accuracy));
+}
+
+void WGriddingMSGridder::Invert() {
+  std::vector<MSData> msDataVector;
+  initializeMSDataVector(msDataVector);
+
+  _gridder = makeGridder();
   _gridder->InitializeInversion();
 
   resetVisibilityCounters();
@@ -228,8 +606,96 @@ void WGriddingMSGridder::Invert() {
     }
   }
 
-  _gridder->FinalizeImage(1.0 / totalWeight());
+  finishInversion();
+}
+
+void WGriddingMSGridder::InvertWithPSF() {
+  if (!canWeightVisibilityBlocks() || DoImagePSF())
+    throw std::runtime_error(
+        "Imaging the PSF and the data in a single pass is not possible with "
+        "the current settings");
+
+  std::vector<MSData> msDataVector;
+  initializeMSDataVector(msDataVector);
+
+  std::unique_ptr<WGriddingGridder_Simple> psfGridder = makeGridder();
+  psfGridder->InitializeInversion();
+  _gridder = makeGridder();
+  _gridder->InitializeInversion();
+
+  resetVisibilityCounters();
+
+  for (MSData& msData : msDataVector) {
+    if (Polarization() == aocommon::Polarization::XX) {
+      gridWithPSFMeasurementSet<DDGainMatrix::kXX>(msData, *psfGridder);
+    } else if (Polarization() == aocommon::Polarization::YY) {
+      gridWithPSFMeasurementSet<DDGainMatrix::kYY>(msData, *psfGridder);
+    } else {
+      gridWithPSFMeasurementSet<DDGainMatrix::kTrace>(msData, *psfGridder);
+    }
+  }
+
+  // Both images are normalized with the same total weight, as the PSF and
+  // the data were weighted together.
+  _psfImage = makeResultImage(*psfGridder);
+  finishInversion();
+}
+
+void WGriddingMSGridder::InvertFacetGroup(
+    const std::vector<WGriddingMSGridder*>& gridders) {
+  if (gridders.empty()) return;
+  const size_t nFacets = gridders.size();
+  WGriddingMSGridder& first = *gridders.front();
+  // The facets are gridded in parallel, so each facet gets its share of the
+  // threads.
+  const size_t threadsPerFacet =
+      std::max<size_t>(1, first._settings.threadCount / nFacets);
+
+  std::vector<std::vector<MSData>> msDataVectors(nFacets);
+  for (size_t facet = 0; facet != nFacets; ++facet) {
+    WGriddingMSGridder& gridder = *gridders[facet];
+    if (!gridder.canWeightVisibilityBlocks() ||
+        gridder.MeasurementSetCount() != first.MeasurementSetCount() ||
+        gridder.Polarization() != first.Polarization() ||
+        gridder.DoImagePSF() != first.DoImagePSF() ||
+        gridder.DoSubtractModel() != first.DoSubtractModel())
+      throw std::runtime_error(
+          "The facets of this facet group can not be gridded together");
+
+    // The meta data (w-limits, etc.) does not depend on the facet, so it
+    // only has to be calculated for the first facet.
+    if (facet != 0 && gridder._metaDataCache->msDataVector.empty())
+      gridder._metaDataCache->msDataVector =
+          first._metaDataCache->msDataVector;
+    gridder.initializeMSDataVector(msDataVectors[facet]);
+
+    gridder._cpuCount = threadsPerFacet;
+    gridder._gridder = gridder.makeGridder();
+    gridder._gridder->InitializeInversion();
+    gridder.resetVisibilityCounters();
+  }
+
+  for (size_t msIndex = 0; msIndex != first.MeasurementSetCount();
+       ++msIndex) {
+    if (first.Polarization() == aocommon::Polarization::XX) {
+      gridFacetGroupMeasurementSet<DDGainMatrix::kXX>(gridders, msDataVectors,
+                                                      msIndex);
+    } else if (first.Polarization() == aocommon::Polarization::YY) {
+      gridFacetGroupMeasurementSet<DDGainMatrix::kYY>(gridders, msDataVectors,
+                                                      msIndex);
+    } else {
+      gridFacetGroupMeasurementSet<DDGainMatrix::kTrace>(
+          gridders, msDataVectors, msIndex);
+    }
+  }
+
+  for (WGriddingMSGridder* gridder : gridders) {
+    gridder->_cpuCount = gridder->_settings.threadCount;
+    gridder->finishInversion();
+  }
+}
 
+void WGriddingMSGridder::finishInversion() {
   Logger::Info << "Gridded visibility count: "
                << double(GriddedVisibilityCount());
   if (Weighting().IsNatural())
@@ -237,10 +703,16 @@ void WGriddingMSGridder::Invert() {
                  << EffectiveGriddedVisibilityCount();
   Logger::Info << '\n';
 
-  _image = Image(ActualInversionWidth(), ActualInversionHeight());
+  _image = makeResultImage(*_gridder);
+}
+
+Image WGriddingMSGridder::makeResultImage(WGriddingGridder_Simple& gridder) {
+  gridder.FinalizeImage(1.0 / totalWeight());
+
+  Image image(ActualInversionWidth(), ActualInversionHeight());
   {
-    std::vector<float> imageFloat = _gridder->RealImage();
-    for (size_t i = 0; i < imageFloat.size(); ++i) _image[i] = imageFloat[i];
+    std::vector<float> imageFloat = gridder.RealImage();
+    for (size_t i = 0; i < imageFloat.size(); ++i) image[i] = imageFloat[i];
   }
 
   if (ImageWidth() != ActualInversionWidth() ||
@@ -252,8 +724,8 @@ void WGriddingMSGridder::Invert() {
         ImageHeight(), _cpuCount);
 
     Image resized(ImageWidth(), ImageHeight());
-    resampler.Resample(_image.Data(), resized.Data());
-    _image = std::move(resized);
+    resampler.Resample(image.Data(), resized.Data());
+    image = std::move(resized);
   }
 
   if (TrimWidth() != ImageWidth() || TrimHeight() != ImageHeight()) {
@@ -261,31 +733,21 @@ void WGriddingMSGridder::Invert() {
                   << " -> " << TrimWidth() << " x " << TrimHeight() << '\n';
 
     Image trimmed(TrimWidth(), TrimHeight());
-    Image::Trim(trimmed.Data(), TrimWidth(), TrimHeight(), _image.Data(),
+    Image::Trim(trimmed.Data(), TrimWidth(), TrimHeight(), image.Data(),
                 ImageWidth(), ImageHeight());
-    _image = std::move(trimmed);
+    image = std::move(trimmed);
   }
+  return image;
 }
 
-void WGriddingMSGridder::Predict(std::vector<Image>&& images) {
-  std::vector<MSData> msDataVector;
-  initializeMSDataVector(msDataVector);
-
-  size_t trimmedWidth, trimmedHeight;
-  getActualTrimmedSize(trimmedWidth, trimmedHeight);
-
-  _gridder.reset(new WGriddingGridder_Simple(
-      ActualInversionWidth(), ActualInversionHeight(), trimmedWidth,
-      trimmedHeight, ActualPixelSizeX(), ActualPixelSizeY(), PhaseCentreDL(),
-      PhaseCentreDM(), _cpuCount, _accuracy));
-
+void WGriddingMSGridder::prepareModelImage(Image& image) const {
   if (TrimWidth() != ImageWidth() || TrimHeight() != ImageHeight()) {
     Image untrimmedImage(ImageWidth(), ImageHeight());
     Logger::Debug << "Untrimming " << TrimWidth() << " x " << TrimHeight()
                   << " -> " << ImageWidth() << " x " << ImageHeight() << '\n';
     Image::Untrim(untrimmedImage.Data(), ImageWidth(), ImageHeight(),
-                  images[0].Data(), TrimWidth(), TrimHeight());
-    images[0] = std::move(untrimmedImage);
+                  image.Data(), TrimWidth(), TrimHeight());
+    image = std::move(untrimmedImage);
   }
 
   if (ImageWidth() != ActualInversionWidth() ||
@@ -295,10 +757,18 @@ void WGriddingMSGridder::Predict(std::vector<Image>&& images) {
                                            ActualInversionWidth(),
                                            ActualInversionHeight(), _cpuCount);
 
-    resampler.Resample(images[0].Data(), resampledImage.Data());
-    images[0] = std::move(resampledImage);
+    resampler.Resample(image.Data(), resampledImage.Data());
+    image = std::move(resampledImage);
   }
+}
 
+void WGriddingMSGridder::Predict(std::vector<Image>&& images) {
+  std::vector<MSData> msDataVector;
+  initializeMSDataVector(msDataVector);
+
+  _gridder = makeGridder();
+
+  prepareModelImage(images[0]);
   _gridder->InitializePrediction(images[0].Data());
   images[0].Reset();
 
@@ -312,3 +782,28 @@ void WGriddingMSGridder::Predict(std::vector<Image>&& images) {
     }
   }
 }
+
+void WGriddingMSGridder::PredictAndInvert(std::vector<Image>&& images) {
+  if (!canWeightVisibilityBlocks() || !DoSubtractModel() || hasDdEffects())
+    throw std::runtime_error(
+        "Fused prediction and inversion is not possible with the current "
+        "settings");
+
+  std::vector<MSData> msDataVector;
+  initializeMSDataVector(msDataVector);
+
+  std::unique_ptr<WGriddingGridder_Simple> predictGridder = makeGridder();
+  prepareModelImage(images[0]);
+  predictGridder->InitializePrediction(images[0].Data());
+  images[0].Reset();
+
+  _gridder = makeGridder();
+  _gridder->InitializeInversion();
+
+  resetVisibilityCounters();
+
+  for (MSData& msData : msDataVector)
+    gridResidualMeasurementSet(msData, *predictGridder);
+
+  finishInversion();
+}
@@ -6,6 +6,7 @@
 #include <aocommon/image.h>
 
 #include <memory>
+#include <vector>
 
 class WGriddingMSGridder final : public MSGridderBase {
  public:
@@ -15,27 +16,127 @@ class WGriddingMSGridder final : public MSGridderBase {
 
   virtual void Predict(std::vector<aocommon::Image>&& images) override;
 
+  virtual void PredictAndInvert(std::vector<aocommon::Image>&& images) override;
+
+  virtual void InvertWithPSF() override;
+
+  /**
+   * Performs the inversion of several gridders that image different facets
+   * of the same data. The visibilities are read only once: every block of
+   * rows is copied to each facet, after which the facets are weighted
+   * (including their direction-dependent effects) and gridded in parallel.
+   * The phase rotation towards the facet centre is part of the gridding.
+   *
+   * All gridders should be set up for the same measurement sets, band and
+   * polarization, and imaging weights may not be stored. Afterwards, the
+   * result of each gridder is available as if Invert() was called on it.
+   */
+  static void InvertFacetGroup(
+      const std::vector<WGriddingMSGridder*>& gridders);
+
   virtual std::vector<aocommon::Image> ResultImages() override {
     return {std::move(_image)};
   }
 
+  virtual std::vector<aocommon::Image> ResultPSFImages() override {
+    if (_psfImage.Empty()) return {};
+    return {std::move(_psfImage)};
+  }
+
   virtual void FreeImagingData() override {}
 
   virtual size_t getSuggestedWGridSize() const override { return 1; }
 
  private:
   aocommon::Image _image;
+  aocommon::Image _psfImage;
 
   template <DDGainMatrix GainEntry>
   void gridMeasurementSet(MSData& msData);
 
+  /**
+   * Grids the data in chunks that each cover a limited range of w, such that
+   * a w-plane is only Fourier transformed for the few chunks that touch it.
+   * The data is read once for every range in @p wSlabs. Used instead of
+   * gridMeasurementSet() when the data does not fit in memory at once.
+   * @param wSlabs Histogram bins (see calculateWSlabs()) that separate the
+   * w ranges.
+   */
+  template <DDGainMatrix GainEntry>
+  void gridWSortedMeasurementSet(MSData& msData,
+                                 const std::vector<size_t>& wSlabs,
+                                 double maxAbsW, size_t maxNRows);
+
+  /**
+   * Divides the range of |w| (in meters) up to @p maxAbsW into slabs of at
+   * most @p maxNRows rows, using a histogram of |w| over all rows.
+   * @returns The first histogram bin of each slab, followed by the bin count.
+   * Empty when all rows fit in a single chunk.
+   */
+  std::vector<size_t> calculateWSlabs(const MSData& msData, double maxAbsW,
+                                      size_t maxNRows) const;
+
   template <DDGainMatrix GainEntry>
   void predictMeasurementSet(MSData& msData);
 
-  size_t calculateMaxNRowsInMemory(size_t channelCount) const;
+  template <DDGainMatrix GainEntry>
+  static void gridFacetGroupMeasurementSet(
+      const std::vector<WGriddingMSGridder*>& gridders,
+      std::vector<std::vector<MSData>>& msDataVectors, size_t msIndex);
+
+  /**
+   * Grids the data minus the visibilities that are predicted by
+   * @p predictGridder. Used by PredictAndInvert().
+   */
+  void gridResidualMeasurementSet(
+      MSData& msData, const class WGriddingGridder_Simple& predictGridder);
+
+  /**
+   * Grids the data with _gridder, and the PSF visibilities of the same rows
+   * with @p psfGridder. Used by InvertWithPSF().
+   */
+  template <DDGainMatrix GainEntry>
+  void gridWithPSFMeasurementSet(MSData& msData,
+                                 class WGriddingGridder_Simple& psfGridder);
+
+  /**
+   * @param withModel If true, the memory for a prediction gridder and the
+   * predicted model visibilities is also taken into account.
+   * @param bufferCount Number of chunks that are in memory at the same time.
+   */
+  size_t calculateMaxNRowsInMemory(size_t channelCount, bool withModel = false,
+                                   size_t bufferCount = 1) const;
+
+  /**
+   * Calculates the number of rows that fit in memory, given the memory that
+   * is used independently of the number of visibilities, and the memory used
+   * per visibility by the gridder(s).
+   */
+  size_t calculateMaxNRowsForMemUsage(size_t constantMem, size_t perVisMem,
+                                      size_t channelCount,
+                                      size_t bufferCount) const;
 
   void getActualTrimmedSize(size_t& trimmedWidth, size_t& trimmedHeight) const;
 
+  std::unique_ptr<class WGriddingGridder_Simple> makeGridder() const;
+
+  /**
+   * Untrims and resamples a model image to the size of the gridder.
+   */
+  void prepareModelImage(aocommon::Image& image) const;
+
+  /**
+   * Finalizes the image of the inversion gridder and stores the trimmed
+   * result in _image.
+   */
+  void finishInversion();
+
+  /**
+   * Finalizes the image of @p gridder, and returns it resampled and trimmed
+   * to the output size.
+   */
+  aocommon::Image makeResultImage(class WGriddingGridder_Simple& gridder);
+
   size_t _cpuCount;
   int64_t _memSize;
   double _accuracy;